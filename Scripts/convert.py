@@ -44,7 +44,24 @@ COMMAND_LINE_OPTIONS = (
      {'action': 'store_true',
       'dest': 'outputStaticMesh',
       'default': False,
-      'help': 'Forces it to output a static mesh and not a model with animation'}))
+      'help': 'Forces it to output a static mesh and not a model with animation'}),
+    (('-d', '--direct'),
+     {'action': 'store_true',
+      'dest': 'createAnimations',
+      'default': False,
+      'help': "Create the rig and animation files in the FBX importer without the standalone filter manager"}),
+    (('-z', '--compress'),
+     {'action': 'store',
+      'type': 'int',
+      'dest': 'compressionLevel',
+      'default': 0,
+      'help': "Save gzip compressed tag files with this zlib level (1-9), they are decompressed for the filter manager"}),
+    (('-j', '--jobs'),
+     {'action': 'store',
+      'type': 'int',
+      'dest': 'jobs',
+      'default': 0,
+      'help': "Maximum number of filter managers running at the same time (default is one per CPU)"}))
 
 
 def main():
@@ -77,7 +94,10 @@ def main():
             static_mesh=options.outputStaticMesh,
             vision_model=options.outputVisionModel,
             interactive=options.interactive,
-            verbose=options.verbose)
+            verbose=options.verbose,
+            create_animations=options.createAnimations,
+            compression_level=options.compressionLevel,
+            jobs=options.jobs)
 
     return success
 
@@ -17,7 +17,9 @@ of that with Havok Content Tools filter manager. Given an FBX file it will:
 
 import sys
 import os
+import threading
 import traceback
+import multiprocessing
 
 import utilities
 from hct import HCT
@@ -29,25 +31,101 @@ class HavokScene():
     a scene file that could describe an animation or mesh
     """
     def __init__(self, sceneFile, filter_set_file, asset_path,
-                 output_path, scene_length, is_root):
+                 output_path, scene_length, is_root, target_name):
         self.sceneFile = sceneFile
         self.filter_set_file = filter_set_file
         self.asset_path = asset_path
         self.output_path = output_path
         self.scene_length = scene_length
         self.is_root = is_root
+        self.target_name = target_name
 
         return
 
 
+def _run_filter_manager(havokContentTools, havokScenes, jobs, verbose):
+    """
+    Runs the standalone filter manager on each scene with up to 'jobs'
+    instances at the same time. The output of each instance is written to a
+    .log file next to its scene and printed once the instance is done, so the
+    output of scenes never interleaves. The root scene of an animation export
+    is run on its own first since the animations are filtered against its rig,
+    and they are skipped if it fails. Returns a (scene, reason) tuple for each
+    scene that failed.
+    """
+
+    failures = []
+    lock = threading.Lock()
+
+    def run_scene(havokScene):
+        (returnCode, output) = havokContentTools.run_captured(
+            havokScene.sceneFile,
+            havokScene.filter_set_file,
+            havokScene.asset_path,
+            havokScene.output_path)
+
+        logFile = os.path.splitext(havokScene.sceneFile)[0] + ".log"
+        with open(logFile, 'wt') as out:
+            out.write(output)
+
+        with lock:
+            if verbose:
+                print("Tag file: %s" % os.path.basename(havokScene.sceneFile))
+                print("Filter set: %s" % os.path.basename(havokScene.filter_set_file))
+                print("Target name: %s" % havokScene.target_name)
+                print(utilities.line(True))
+                if output.strip():
+                    print(output.rstrip())
+                    print(utilities.line(True))
+                sys.stdout.flush()
+
+            if returnCode != 0:
+                failures.append((havokScene, "exit code %d, see %s" % (returnCode, logFile)))
+
+        return returnCode == 0
+
+    pending = list(havokScenes)
+    if len(pending) > 1 and pending[0].is_root:
+        if not run_scene(pending[0]):
+            for havokScene in pending[1:]:
+                failures.append((havokScene, "skipped since the rig failed"))
+            return failures
+        pending = pending[1:]
+
+    def worker():
+        while True:
+            with lock:
+                if not pending:
+                    return
+                havokScene = pending.pop(0)
+            run_scene(havokScene)
+
+    threads = [threading.Thread(target=worker) for _ in range(min(jobs, len(pending)))]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+
+    return failures
+
+
 def convert(fbx_file,
             static_mesh=False,
             vision_model=False,
             interactive=False,
-            verbose=True):
+            verbose=True,
+            create_animations=False,
+            compression_level=0,
+            jobs=0):
     """
     Takes as input an FBX file and converts it to files that can be
-    used by either Vision or Animation Studio.
+    used by either Vision or Animation Studio. With create_animations
+    the FBX importer writes the rig and animation files itself and the
+    filter manager is only run for Vision files. With a compression level
+    the tag files are saved compressed and decompressed for the filter
+    manager, which only keeps the decompressed copies while it runs.
+    Up to 'jobs' filter managers run at the same time, 0 runs one per
+    CPU.
     """
 
     success = False
@@ -64,6 +142,9 @@ def convert(fbx_file,
         if verbose:
             print(message)
 
+    # Decompressed tag files are only needed by the filter manager
+    decompressedFiles = []
+
     try:
         inputFile = os.path.abspath(fbx_file)
         if not os.path.isfile(inputFile):
@@ -98,7 +179,18 @@ def convert(fbx_file,
         inputDirectory = os.path.dirname(inputFile)
 
         log("Converting FBX to Havok Scene Format...")
-        fbxImporterOutput = utilities.run([fbxImporter, inputFile], verbose)
+        fbxImporterArguments = [fbxImporter]
+        createAnimations = create_animations and (not static_mesh) and (not vision_model)
+        if createAnimations:
+            fbxImporterArguments.append("-createAnimations")
+        if compression_level > 0:
+            fbxImporterArguments.append("-compressTagFiles")
+            fbxImporterArguments.append(str(compression_level))
+        if static_mesh:
+            # Static meshes don't use the animation stacks, so don't let the importer load them
+            fbxImporterArguments.append("-noAnimations")
+        fbxImporterArguments.append(inputFile)
+        fbxImporterOutput = utilities.run(fbxImporterArguments, verbose)
 
         parseIndex = fbxImporterOutput.find(labelTagFile)
         if parseIndex == -1:
@@ -124,6 +216,10 @@ def convert(fbx_file,
             sceneFile = utilities.parse_text(fbxImporterOutput, labelTagFile, parseIndex)
             sceneFile = os.path.join(inputDirectory, sceneFile)
 
+            compressed = sceneFile.endswith(".gz")
+            if compressed:
+                (sceneFile, _) = os.path.splitext(sceneFile)
+
             (input_file_path, _) = os.path.splitext(sceneFile)
             target_filename = os.path.basename(input_file_path)
 
@@ -145,29 +241,37 @@ def convert(fbx_file,
                 configFile = os.path.join(configPath, "VisionStaticMesh.hko")
                 target_filename = "%s.vmesh" % (rootName)
 
-            configFile = os.path.abspath(os.path.join(
-                currentDirectory,
-                configFile))
-            outputConfigFile = os.path.abspath(input_file_path + ".hko")
-
-            with open(outputConfigFile, 'wt') as out:
-                for line in open(configFile):
-                    out.write(line.replace('$(output)', target_filename))
-
-            sceneLength = float(utilities.parse_text(
-                fbxImporterOutput,
-                labelSceneLength,
-                parseIndex))
-            
-            havokScene = HavokScene(sceneFile=sceneFile,
-                                    filter_set_file=outputConfigFile,
-                                    asset_path=inputDirectory,
-                                    output_path=inputDirectory,
-                                    scene_length=sceneLength,
-                                    is_root=isRootNode)
-
-            # We accumulate all scenes before actually exporting them
-            havokScenes.append(havokScene)
+            if createAnimations and isAnimationExport:
+                # The FBX importer already wrote the rig and animation files
+                log("Created %s" % target_filename)
+            else:
+                if compressed:
+                    decompressedFiles.append(utilities.decompress(sceneFile + ".gz"))
+
+                configFile = os.path.abspath(os.path.join(
+                    currentDirectory,
+                    configFile))
+                outputConfigFile = os.path.abspath(input_file_path + ".hko")
+
+                with open(outputConfigFile, 'wt') as out:
+                    for line in open(configFile):
+                        out.write(line.replace('$(output)', target_filename))
+
+                sceneLength = float(utilities.parse_text(
+                    fbxImporterOutput,
+                    labelSceneLength,
+                    parseIndex))
+
+                havokScene = HavokScene(sceneFile=sceneFile,
+                                        filter_set_file=outputConfigFile,
+                                        asset_path=inputDirectory,
+                                        output_path=inputDirectory,
+                                        scene_length=sceneLength,
+                                        is_root=isRootNode,
+                                        target_name=target_filename)
+
+                # We accumulate all scenes before actually exporting them
+                havokScenes.append(havokScene)
 
             # We can break out of the loop early if this is just
             # a static mesh export
@@ -180,6 +284,9 @@ def convert(fbx_file,
             parseIndex = fbxImporterOutput.find(labelTagFile,
                                                    parseIndex + 1)
 
+        if not havokScenes:
+            return True
+
         log(utilities.line())
         log("Generating Vision / Animation Studio files")
         log(utilities.line())
@@ -188,20 +295,34 @@ def convert(fbx_file,
         # using it to convert over the scene files we've just exported
         havokContentTools = HCT()
 
-        # Now go through each scene and run the standalone filter manager on each one
-        for havokScene in havokScenes:
-            log("Tag file: %s" % os.path.basename(havokScene.sceneFile))
-            log("Filter set: %s" % os.path.basename(outputConfigFile))
-            log("Target name: %s" % target_filename)
-            log(utilities.line(True))
+        if interactive:
+            # Each scene brings up the filter manager, so only show one at a time
+            for havokScene in havokScenes:
+                log("Tag file: %s" % os.path.basename(havokScene.sceneFile))
+                log("Filter set: %s" % os.path.basename(havokScene.filter_set_file))
+                log("Target name: %s" % havokScene.target_name)
+                log(utilities.line(True))
+
+                havokContentTools.run(havokScene.sceneFile,
+                                        havokScene.filter_set_file,
+                                        havokScene.asset_path,
+                                        havokScene.output_path,
+                                        interactive)
+
+            success = True
+        else:
+            if jobs <= 0:
+                jobs = multiprocessing.cpu_count()
+
+            failures = _run_filter_manager(havokContentTools, havokScenes,
+                                           jobs, verbose)
 
-            havokContentTools.run(havokScene.sceneFile,
-                                    havokScene.filter_set_file,
-                                    havokScene.asset_path,
-                                    havokScene.output_path,
-                                    interactive)
+            if failures:
+                print("Filter manager failed on %d of %d scenes:" % (len(failures), len(havokScenes)))
+                for (havokScene, reason) in failures:
+                    print("    %s: %s" % (havokScene.target_name, reason))
 
-        success = True
+            success = not failures
     except IOError as error:
         print("I/O error({0}): {1}".format(error[0], error[1]))
         traceback.print_exc(file=sys.stdout)
@@ -210,5 +331,9 @@ def convert(fbx_file,
         print("Unexpected error: %s" % sys.exc_info()[0])
         traceback.print_exc(file=sys.stdout)
         utilities.wait()
+    finally:
+        for decompressedFile in decompressedFiles:
+            if os.path.isfile(decompressedFile):
+                os.remove(decompressedFile)
 
     return success
\ No newline at end of file
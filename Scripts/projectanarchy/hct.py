@@ -77,9 +77,7 @@ class HCT():
 
         return
 
-    def run(self, filename, filter_set,
-            asset_path, output_path,
-            interactive=False, verbose=False):
+    def _command(self, filename, filter_set, asset_path, output_path, interactive):
         arguments = [
            "-p", asset_path + "\\",
            "-o", output_path + "\\",
@@ -90,7 +88,12 @@ class HCT():
 
         arguments.append(filename)
 
-        command = [self.havok_filter_manager] + arguments
+        return [self.havok_filter_manager] + arguments
+
+    def run(self, filename, filter_set,
+            asset_path, output_path,
+            interactive=False, verbose=False):
+        command = self._command(filename, filter_set, asset_path, output_path, interactive)
 
         if verbose:
             utilities.print_line()
@@ -104,6 +107,17 @@ class HCT():
 
         return
 
+    def run_captured(self, filename, filter_set, asset_path, output_path):
+        """
+        Runs the filter manager without user interaction and returns its exit
+        code and output instead of printing it. Safe to call from several
+        threads at once as long as each call writes different files.
+        """
+
+        command = self._command(filename, filter_set, asset_path, output_path, False)
+
+        return utilities.run_captured(command, output_path)
+
 class PreviewTool():
     def __init__(self):
         self.havok_tools_root = _getHavokContentToolsPath()
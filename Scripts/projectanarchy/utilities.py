@@ -11,6 +11,8 @@
 import subprocess
 import sys
 import os
+import gzip
+import shutil
 
 import msvcrt as m
 
@@ -47,6 +49,39 @@ def is_drag_drop_start():
 
     return drag_drop
 
+def decompress(filename):
+    """
+    Decompresses a gzip file next to it, e.g. a .hkt.gz tag file to the .hkt
+    file the filter manager can load, and returns the decompressed filename
+    """
+
+    (output_filename, _) = os.path.splitext(filename)
+    with gzip.open(filename, 'rb') as source:
+        with open(output_filename, 'wb') as output:
+            shutil.copyfileobj(source, output)
+
+    return output_filename
+
+def run_captured(arguments, current_directory=""):
+    """
+    Runs a process to completion without echoing anything and returns its
+    exit code along with everything it wrote to stdout and stderr, so that
+    several processes can run at the same time without mixing their output
+    """
+
+    if current_directory == "":
+        current_directory = os.path.dirname(arguments[0])
+
+    child = subprocess.Popen(arguments, shell=True, stdout=subprocess.PIPE,
+                             stderr=subprocess.STDOUT, cwd=current_directory)
+    (output, _) = child.communicate()
+
+    # handle the Python 3.0 case where it's returned as a series of bytes
+    if isinstance(output, bytes):
+        output = output.decode("utf-8", "replace")
+
+    return (child.returncode, output)
+
 def parse_text(source, label, parse_index=0):
     index = source.find(label, parse_index)
     if index == -1:
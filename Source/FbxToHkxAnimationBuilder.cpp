@@ -0,0 +1,297 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxAnimationBuilder.h"
+
+#include <Common/Base/Container/StringMap/hkStringMap.h>
+#include <Common/SceneData/Graph/hkxNode.h>
+#include <Common/SceneData/Mesh/hkxMesh.h>
+#include <Common/SceneData/Skin/hkxSkinBinding.h>
+#include <Animation/Animation/Animation/Interleaved/hkaInterleavedUncompressedAnimation.h>
+#include <Animation/Animation/Animation/SplineCompressed/hkaSplineCompressedAnimation.h>
+
+static void convertMatrixToQsTransform(const hkMatrix4& matrix, hkQsTransform& transformOut)
+{
+	hkFloat32 columnMajor[16];
+	matrix.get4x4ColumnMajor(columnMajor);
+	transformOut.set4x4ColumnMajor(columnMajor);
+}
+
+// Nodes between two bones are not part of the skeleton, their transforms are folded into the child bone
+static void addBonesRecursive(
+	const hkxNode* node,
+	int parentBoneIndex,
+	const hkMatrix4& parentBoneFromNode,
+	const hkStringMap<int>& skinNodes,
+	hkaSkeleton* skeleton)
+{
+	for (int childIndex = 0; childIndex < node->m_children.getSize(); childIndex++)
+	{
+		const hkxNode* child = node->m_children[childIndex];
+		HK_ASSERT(0x0, child->m_keyFrames.getSize() > 0);
+
+		hkMatrix4 parentBoneFromChild;
+		parentBoneFromChild.setMul(parentBoneFromNode, child->m_keyFrames[0]);
+
+		if (child->m_bone || skinNodes.getWithDefault(child->m_name, 0))
+		{
+			const int boneIndex = skeleton->m_bones.getSize();
+
+			hkaBone& bone = skeleton->m_bones.expandOne();
+			bone.m_name = child->m_name;
+			bone.m_lockTranslation = false;
+			skeleton->m_parentIndices.pushBack((hkInt16) parentBoneIndex);
+			convertMatrixToQsTransform(parentBoneFromChild, skeleton->m_referencePose.expandOne());
+
+			addBonesRecursive(child, boneIndex, hkMatrix4::getIdentity(), skinNodes, skeleton);
+		}
+		else
+		{
+			addBonesRecursive(child, parentBoneIndex, parentBoneFromChild, skinNodes, skeleton);
+		}
+	}
+}
+
+hkaSkeleton* FbxToHkxAnimationBuilder::createSkeleton(const hkxScene* rigScene)
+{
+	// Nodes that skins are bound to are bones even if they are not skeleton nodes in the FBX
+	hkStringMap<int> skinNodes;
+	for (int skinIndex = 0; skinIndex < rigScene->m_skinBindings.getSize(); skinIndex++)
+	{
+		const hkxSkinBinding* skin = rigScene->m_skinBindings[skinIndex];
+		for (int i = 0; i < skin->m_nodeNames.getSize(); i++)
+		{
+			skinNodes.insert(skin->m_nodeNames[i], 1);
+		}
+	}
+
+	hkaSkeleton* skeleton = new hkaSkeleton();
+	addBonesRecursive(rigScene->m_rootNode, -1, hkMatrix4::getIdentity(), skinNodes, skeleton);
+
+	if (skeleton->m_bones.getSize() == 0)
+	{
+		skeleton->removeReference();
+		return HK_NULL;
+	}
+
+	skeleton->m_name = skeleton->m_bones[0].m_name;
+
+	printf("Created skeleton [%s]: %d bones\n", skeleton->m_name.cString(), skeleton->m_bones.getSize());
+	return skeleton;
+}
+
+void FbxToHkxAnimationBuilder::createMeshBindings(const hkxScene* scene, hkaSkeleton* skeleton, hkArray< hkRefPtr<hkaMeshBinding> >& meshBindingsOut)
+{
+	hkStringMap<int> boneIndices;
+	for (int boneIndex = 0; boneIndex < skeleton->m_bones.getSize(); boneIndex++)
+	{
+		boneIndices.insert(skeleton->m_bones[boneIndex].m_name, boneIndex);
+	}
+
+	for (int skinIndex = 0; skinIndex < scene->m_skinBindings.getSize(); skinIndex++)
+	{
+		const hkxSkinBinding* skin = scene->m_skinBindings[skinIndex];
+
+		hkaMeshBinding* meshBinding = new hkaMeshBinding();
+		meshBinding->m_mesh = skin->m_mesh;
+		meshBinding->m_originalSkeletonName = skeleton->m_name;
+		meshBinding->m_skeleton = skeleton;
+
+		// The bone indices of the vertices refer to the nodes of the skin binding, map them to the skeleton and
+		// store the transform from the mesh to each of these bones in the bind pose
+		hkArray<hkInt16> mapping(skin->m_nodeNames.getSize());
+		meshBinding->m_boneFromSkinMeshTransforms.setSize(skin->m_nodeNames.getSize());
+
+		for (int i = 0; i < skin->m_nodeNames.getSize(); i++)
+		{
+			const int boneIndex = boneIndices.getWithDefault(skin->m_nodeNames[i], -1);
+			HK_ASSERT(0x0, boneIndex >= 0);
+			mapping[i] = (hkInt16) hkMath::max2(boneIndex, 0);
+
+			hkMatrix4 boneFromWorld = skin->m_bindPose[i];
+			boneFromWorld.invert(HK_REAL_EPSILON);
+
+			hkMatrix4 boneFromSkinMesh;
+			boneFromSkinMesh.setMul(boneFromWorld, skin->m_initSkinTransform);
+
+			hkFloat32 columnMajor[16];
+			boneFromSkinMesh.get4x4ColumnMajor(columnMajor);
+			meshBinding->m_boneFromSkinMeshTransforms[i].set4x4ColumnMajor(columnMajor);
+		}
+
+		// Every section of the mesh uses the same mapping
+		meshBinding->m_mappings.setSize(skin->m_mesh->m_sections.getSize());
+		for (int sectionIndex = 0; sectionIndex < meshBinding->m_mappings.getSize(); sectionIndex++)
+		{
+			meshBinding->m_mappings[sectionIndex].m_mapping = mapping;
+		}
+
+		meshBindingsOut.pushBack(meshBinding);
+		meshBinding->removeReference();
+	}
+}
+
+// Store the transform of each bone relative to its parent bone for every frame. Static nodes have fewer keys than
+// the scene has frames, their last key is used for the remaining frames.
+static void addTracksRecursive(
+	const hkxNode* node,
+	const hkArray<hkMatrix4>& parentBoneFromNode,
+	const hkStringMap<int>& boneIndices,
+	hkaInterleavedUncompressedAnimation* animation)
+{
+	const int numFrames = parentBoneFromNode.getSize();
+	const int numBones = animation->m_numberOfTransformTracks;
+
+	for (int childIndex = 0; childIndex < node->m_children.getSize(); childIndex++)
+	{
+		const hkxNode* child = node->m_children[childIndex];
+		const int numKeys = child->m_keyFrames.getSize();
+		HK_ASSERT(0x0, numKeys > 0);
+
+		hkArray<hkMatrix4> parentBoneFromChild(numFrames);
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			parentBoneFromChild[frame].setMul(parentBoneFromNode[frame], child->m_keyFrames[hkMath::min2(frame, numKeys - 1)]);
+		}
+
+		const int boneIndex = boneIndices.getWithDefault(child->m_name, -1);
+		if (boneIndex < 0)
+		{
+			addTracksRecursive(child, parentBoneFromChild, boneIndices, animation);
+			continue;
+		}
+
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			convertMatrixToQsTransform(parentBoneFromChild[frame], animation->m_transforms[frame * numBones + boneIndex]);
+		}
+
+		hkaAnnotationTrack& track = animation->m_annotationTracks[boneIndex];
+		for (int i = 0; i < child->m_annotations.getSize(); i++)
+		{
+			hkaAnnotationTrack::Annotation& annotation = track.m_annotations.expandOne();
+			annotation.m_time = child->m_annotations[i].m_time;
+			annotation.m_text = child->m_annotations[i].m_description;
+		}
+
+		hkArray<hkMatrix4> identity(numFrames, hkMatrix4::getIdentity());
+		addTracksRecursive(child, identity, boneIndices, animation);
+	}
+}
+
+hkaAnimationBinding* FbxToHkxAnimationBuilder::createAnimationBinding(const hkxScene* scene, const hkaSkeleton* skeleton)
+{
+	const int numBones = skeleton->m_bones.getSize();
+
+	// Animations need at least two frames, a single frame is held for the length of the scene
+	const int numFrames = hkMath::max2((int) scene->m_numFrames, 2);
+
+	hkStringMap<int> boneIndices;
+	for (int boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		boneIndices.insert(skeleton->m_bones[boneIndex].m_name, boneIndex);
+	}
+
+	hkaInterleavedUncompressedAnimation* rawAnimation = new hkaInterleavedUncompressedAnimation();
+	rawAnimation->m_duration = scene->m_sceneLength;
+	rawAnimation->m_numberOfTransformTracks = numBones;
+	rawAnimation->m_numberOfFloatTracks = 0;
+
+	// Bones that are not in the scene keep their reference pose
+	rawAnimation->m_transforms.setSize(numBones * numFrames);
+	for (int frame = 0; frame < numFrames; frame++)
+	{
+		for (int boneIndex = 0; boneIndex < numBones; boneIndex++)
+		{
+			rawAnimation->m_transforms[frame * numBones + boneIndex] = skeleton->m_referencePose[boneIndex];
+		}
+	}
+
+	// One annotation track per bone, named after it
+	rawAnimation->m_annotationTracks.setSize(numBones);
+	for (int boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		rawAnimation->m_annotationTracks[boneIndex].m_trackName = skeleton->m_bones[boneIndex].m_name;
+	}
+
+	hkArray<hkMatrix4> identity(numFrames, hkMatrix4::getIdentity());
+	addTracksRecursive(scene->m_rootNode, identity, boneIndices, rawAnimation);
+
+	// Like moveToOriginX/Y/Z of the Create Animations filter in Animation.hko, the root bones are offset so that
+	// they start at the origin
+	for (int boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		if (skeleton->m_parentIndices[boneIndex] != -1)
+		{
+			continue;
+		}
+
+		const hkVector4 startTranslation = rawAnimation->m_transforms[boneIndex].m_translation;
+		for (int frame = 0; frame < numFrames; frame++)
+		{
+			rawAnimation->m_transforms[frame * numBones + boneIndex].m_translation.sub(startTranslation);
+		}
+	}
+
+	// The settings of the Spline Compression filter in Animation.hko
+	hkaSplineCompressedAnimation::TrackCompressionParams trackParams;
+	trackParams.m_rotationTolerance = 0.0001f;
+	trackParams.m_translationTolerance = 0.001f;
+	trackParams.m_scaleTolerance = 0.001f;
+	trackParams.m_floatingTolerance = 0.001f;
+	trackParams.m_rotationDegree = 3;
+	trackParams.m_translationDegree = 3;
+	trackParams.m_scaleDegree = 3;
+	trackParams.m_floatingDegree = 3;
+	trackParams.m_rotationQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::THREECOMP40;
+	trackParams.m_translationQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::BITS16;
+	trackParams.m_scaleQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::BITS16;
+	trackParams.m_floatQuantizationType = hkaSplineCompressedAnimation::TrackCompressionParams::BITS16;
+
+	hkaSplineCompressedAnimation::AnimationCompressionParams animationParams;
+	animationParams.m_maxFramesPerBlock = 256;
+	animationParams.m_enableSampleSingleTracks = false;
+
+	hkaSplineCompressedAnimation* compressedAnimation = new hkaSplineCompressedAnimation(*rawAnimation, trackParams, animationParams);
+
+	printf("Compressed animation [%s]: %d frames, %d bytes -> %d bytes\n",
+		scene->m_rootNode->m_name.cString(),
+		numFrames,
+		rawAnimation->m_transforms.getSize() * (int) sizeof(hkQsTransform),
+		compressedAnimation->getSizeInBytes());
+
+	rawAnimation->removeReference();
+
+	hkaAnimationBinding* binding = new hkaAnimationBinding();
+	binding->m_originalSkeletonName = skeleton->m_name;
+	binding->m_animation = compressedAnimation;
+	compressedAnimation->removeReference();
+
+	binding->m_transformTrackToBoneIndices.setSize(numBones);
+	for (int boneIndex = 0; boneIndex < numBones; boneIndex++)
+	{
+		binding->m_transformTrackToBoneIndices[boneIndex] = (hkInt16) boneIndex;
+	}
+
+	return binding;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
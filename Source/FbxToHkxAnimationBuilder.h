@@ -0,0 +1,51 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_ANIMATION_BUILDER
+#define HK_FBXTOHKX_ANIMATION_BUILDER
+
+#include <Common/Base/hkBase.h>
+#include <Common/SceneData/Scene/hkxScene.h>
+#include <Animation/Animation/Rig/hkaSkeleton.h>
+#include <Animation/Animation/Animation/hkaAnimationBinding.h>
+#include <Animation/Animation/Deform/Skinning/hkaMeshBinding.h>
+
+// Creates the skeleton, skins and compressed animations from the converted scenes, like the Create Skeletons,
+// Create Skins, Create Animations and Spline Compression filters of AnimationRig.hko and Animation.hko do.
+class FbxToHkxAnimationBuilder
+{
+public:
+
+	// Create a skeleton from the bone nodes of the rig scene and the nodes its skins are bound to, named after its
+	// root bone. The reference pose is the first key of each node. Returns a new reference, or HK_NULL without bones.
+	static hkaSkeleton* createSkeleton(const hkxScene* rigScene);
+
+	// Bind each skinned mesh of the scene to the skeleton
+	static void createMeshBindings(const hkxScene* scene, hkaSkeleton* skeleton, hkArray< hkRefPtr<hkaMeshBinding> >& meshBindingsOut);
+
+	// Create a spline compressed animation with one track per bone of the skeleton from the keys of the scene, with
+	// the root bones moved to the origin at the first frame. Returns a new reference.
+	static hkaAnimationBinding* createAnimationBinding(const hkxScene* scene, const hkaSkeleton* skeleton);
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
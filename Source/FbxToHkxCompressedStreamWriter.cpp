@@ -0,0 +1,126 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxCompressedStreamWriter.h"
+
+#include <Common/Base/Math/hkMath.h>
+
+#include <zlib.h>
+
+// Size of the compressed chunks passed on to the wrapped writer
+static const int OUTPUT_BUFFER_SIZE = 64 * 1024;
+
+// Adding 16 to the window bits makes zlib write a gzip header and trailer instead of a zlib one
+static const int GZIP_WINDOW_BITS = 15 + 16;
+
+FbxToHkxCompressedStreamWriter::FbxToHkxCompressedStreamWriter(hkStreamWriter* writer, int level) :
+	m_writer(writer), m_stream(new z_stream), m_ok(false), m_finished(false), m_numBytesIn(0), m_numBytesOut(0)
+{
+	m_buffer.setSize(OUTPUT_BUFFER_SIZE);
+
+	hkString::memSet(m_stream, 0, sizeof(z_stream));
+	level = hkMath::clamp(level, 1, 9);
+	m_ok = m_writer && m_writer->isOk() &&
+		(deflateInit2(m_stream, level, Z_DEFLATED, GZIP_WINDOW_BITS, 8, Z_DEFAULT_STRATEGY) == Z_OK);
+}
+
+FbxToHkxCompressedStreamWriter::~FbxToHkxCompressedStreamWriter()
+{
+	finish();
+	delete m_stream;
+}
+
+int FbxToHkxCompressedStreamWriter::write(const void* buf, int nbytes)
+{
+	if (!m_ok || m_finished)
+	{
+		return 0;
+	}
+
+	m_stream->next_in = static_cast<Bytef*>(const_cast<void*>(buf));
+	m_stream->avail_in = nbytes;
+	m_numBytesIn += nbytes;
+
+	return deflateInput(Z_NO_FLUSH) ? nbytes : 0;
+}
+
+hkBool FbxToHkxCompressedStreamWriter::isOk() const
+{
+	return m_ok;
+}
+
+// Only flushes the wrapped writer, a deflate flush would make the output larger
+void FbxToHkxCompressedStreamWriter::flush()
+{
+	if (m_ok)
+	{
+		m_writer->flush();
+	}
+}
+
+hkResult FbxToHkxCompressedStreamWriter::finish()
+{
+	if (!m_finished)
+	{
+		m_finished = true;
+		if (m_ok)
+		{
+			m_stream->next_in = HK_NULL;
+			m_stream->avail_in = 0;
+			m_ok = deflateInput(Z_FINISH);
+			m_writer->flush();
+		}
+		deflateEnd(m_stream);
+	}
+
+	return (m_ok && m_writer->isOk()) ? HK_SUCCESS : HK_FAILURE;
+}
+
+bool FbxToHkxCompressedStreamWriter::deflateInput(int flushMode)
+{
+	int result = Z_OK;
+	do
+	{
+		m_stream->next_out = m_buffer.begin();
+		m_stream->avail_out = m_buffer.getSize();
+
+		result = deflate(m_stream, flushMode);
+		if (result == Z_STREAM_ERROR)
+		{
+			m_ok = false;
+			return false;
+		}
+
+		const int numBytes = m_buffer.getSize() - m_stream->avail_out;
+		if (numBytes > 0 && m_writer->write(m_buffer.begin(), numBytes) != numBytes)
+		{
+			m_ok = false;
+			return false;
+		}
+		m_numBytesOut += numBytes;
+	}
+	// Without finishing, deflate is done once it leaves room in the output buffer
+	while ((flushMode == Z_FINISH) ? (result != Z_STREAM_END) : (m_stream->avail_out == 0));
+
+	return true;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
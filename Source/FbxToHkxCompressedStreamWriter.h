@@ -0,0 +1,69 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_COMPRESSED_STREAM_WRITER
+#define HK_FBXTOHKX_COMPRESSED_STREAM_WRITER
+
+#include <Common/Base/hkBase.h>
+#include <Common/Base/System/Io/Writer/hkStreamWriter.h>
+
+struct z_stream_s;
+
+// Compresses everything written to it into a gzip stream (zlib deflate) on the wrapped writer, so the output can be
+// read with any gzip tool, e.g. Python's gzip module
+class FbxToHkxCompressedStreamWriter : public hkStreamWriter
+{
+public:
+
+	HK_DECLARE_CLASS_ALLOCATOR(HK_MEMORY_CLASS_STREAM);
+
+	// Level 1 is the fastest and 9 the smallest
+	FbxToHkxCompressedStreamWriter(hkStreamWriter* writer, int level);
+	~FbxToHkxCompressedStreamWriter();
+
+	virtual int write(const void* buf, int nbytes);
+	virtual hkBool isOk() const;
+	virtual void flush();
+
+	// Write the end of the gzip stream, nothing can be written afterwards
+	hkResult finish();
+
+	hkUint64 getNumBytesIn() const { return m_numBytesIn; }
+	hkUint64 getNumBytesOut() const { return m_numBytesOut; }
+
+private:
+
+	// Run deflate over the pending input and pass the output on to the wrapped writer
+	bool deflateInput(int flushMode);
+
+	hkRefPtr<hkStreamWriter> m_writer;
+	z_stream_s* m_stream;
+	hkArray<hkUint8> m_buffer;
+	bool m_ok;
+	bool m_finished;
+
+	hkUint64 m_numBytesIn;
+	hkUint64 m_numBytesOut;
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
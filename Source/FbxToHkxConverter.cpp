@@ -15,6 +15,7 @@
 #include <Common/Serialize/Util/hkSerializeUtil.h>
 #include <Common/SceneData/Scene/hkxScene.h>
 #include <Common/Serialize/Util/hkRootLevelContainer.h>
+#include <Animation/Animation/hkaAnimationContainer.h>
 #include <Common/Base/System/Io/IStream/hkIStream.h>
 #include <Common/Serialize/Resource/hkResource.h>
 #include <Common/SceneData/Environment/hkxEnvironment.h>
@@ -22,6 +23,9 @@
 #include <Common/Base/Ext/hkBaseExt.h>
 #include <Common/Base/Fwd/hkwindows.h>
 
+#include "FbxToHkxCompressedStreamWriter.h"
+#include "FbxToHkxTrace.h"
+
 // Get the matrix of the given pose
 FbxAMatrix GetPoseMatrix(FbxPose* pPose, int pNodeIndex);
 
@@ -31,24 +35,37 @@ FbxAMatrix GetGeometry(FbxNode* pNode);
 static void GetCustomVisionData(FbxNode* fbxNode, hkStringPtr& userPropertiesStr);
 static void PrintLine();
 
+static const char* s_separatorLine = "-------------------------------------------------------------------------------\n";
+
 //-------
 
 FbxToHkxConverter::Options::Options(FbxManager *fbxSdkManager) :
 	m_fbxSdkManager(fbxSdkManager),
 	m_exportMeshes(true), m_exportAttributes(true), m_exportLights(true), m_exportCameras(true),
 	m_exportSplines(true), m_visibleOnly(false), m_selectedOnly(false), 
-	m_exportMaterials(true), m_storeKeyframeSamplePoints(true), m_exportAnnotations(true)
+	m_exportMaterials(true), m_storeKeyframeSamplePoints(true), m_exportAnnotations(true),
+	m_optimizeIndexBuffers(false),
+	m_normalFormat(NORMAL_FORMAT_FLOAT32), m_texCoordFormat(TEXCOORD_FORMAT_FLOAT32), m_positionFormat(POSITION_FORMAT_FLOAT32),
+	m_maxPositionError(0.0f), m_maxNormalErrorDegrees(0.0f), m_maxTexCoordError(0.0f),
+	m_exportVertexTangents(false), m_exportVertexAnimations(false), m_numThreads(0),
+	m_quantizeBlendShapes(false), m_blendShapeTolerance(1e-5f),
+	m_textureBakePath(HK_NULL), m_clipFile(HK_NULL), m_sampleRate(0.0f), m_createAnimations(false), m_optimizeHierarchy(false),
+	m_skeletonOnlyAnimations(false), m_exportAnimations(true), m_numWriterThreads(1),
+	m_tagFileCompressionLevel(0), m_targetAxisSystem(FbxAxisSystem::Max), m_targetUnitInCentimeters(0.0f),
+	m_progressObserver(HK_NULL), m_cancellationToken(HK_NULL)
 {
 	HK_ASSERT(0x0, m_fbxSdkManager);
 }
 
 FbxToHkxConverter::FbxToHkxConverter(const Options& options) : 
-	m_options(options), m_curFbxScene(NULL), m_pose(NULL)
+	m_options(options), m_curFbxScene(NULL), m_pose(NULL), m_defaultMaterialIndex(-1), m_numReusedMaterials(0), m_rigPass(false),
+	m_sceneWriter(HK_NULL), m_numQueuedScenes(0), m_skeleton(HK_NULL), m_unitScale(1.0f), m_flipWinding(false)
 {
 }
 
 FbxToHkxConverter::~FbxToHkxConverter()
 {
+	finishSaving();
 	clear();
 }
 
@@ -60,6 +77,8 @@ void FbxToHkxConverter::clear()
 		scene->removeReference();
 	}
 	m_scenes.clear();
+	m_keyFrameStore.clear();
+	m_nodeOptimizations.clear();
 
 	for(hkPointerMap<FbxTexture*, hkRefVariant*>::Iterator it = m_convertedTextures.getIterator(); m_convertedTextures.isValid(it); it = m_convertedTextures.getNext(it))
 	{
@@ -70,65 +89,277 @@ void FbxToHkxConverter::clear()
 		}
 	}
 	m_convertedTextures.clear();
+
+	m_materialCache.clear();
+	m_materialCacheHeads.clear();
+	m_defaultMaterialIndex = -1;
+	m_numReusedMaterials = 0;
+
+	for (int i = 0; i < m_textureBakeJobs.getSize(); i++)
+	{
+		delete m_textureBakeJobs[i];
+	}
+	m_textureBakeJobs.clear();
+	m_queuedTextures.clear();
+
+	m_clips.clear();
 }
 
-void FbxToHkxConverter::saveScenes(const char *path, const char *name)
+// Saves a scene to its tag file and, with a skeleton, to its rig or animation file
+class FbxToHkxConverter::SceneSaveJob : public FbxToHkxSceneWriter::Job
 {
-	printf("Output path: %s\n", path);
+public:
 
-	for (int sceneIndex = 0; sceneIndex < m_scenes.getSize(); sceneIndex++)
+	SceneSaveJob(const char* path, const char* tagfile, int compressionLevel, const char* animationFile, hkxScene* scene, hkaSkeleton* skeleton, bool rig) :
+		m_path(path), m_tagfile(tagfile), m_compressionLevel(compressionLevel), m_animationFile(animationFile), m_scene(scene), m_skeleton(skeleton), m_rig(rig)
 	{
-		hkxScene *scene = m_scenes[sceneIndex];
+		// The converter may release the scene and the skeleton before the job has run
+		m_scene->addReference();
+		if (m_skeleton)
+		{
+			m_skeleton->addReference();
+		}
+	}
+
+	~SceneSaveJob()
+	{
+		m_scene->removeReference();
+		if (m_skeleton)
+		{
+			m_skeleton->removeReference();
+		}
+	}
+
+	virtual void run(hkStringBuf& logOut)
+	{
+		FbxToHkxTraceScope traceScope("save", m_tagfile);
+
 		hkRootLevelContainer* currentRootContainer = new hkRootLevelContainer();
 		currentRootContainer->m_namedVariants.setSize(1);
 
 		hkRootLevelContainer::NamedVariant& sceneVariant = currentRootContainer->m_namedVariants[0];
-		sceneVariant.set("Scene Data", scene, &hkxSceneClass);
+		sceneVariant.set("Scene Data", m_scene, &hkxSceneClass);
 
-		hkStringBuf filename = name;
+		logOut.append(s_separatorLine);
 
-		if (sceneIndex > 0)
+		hkStringBuf tagpath = m_path;
+		tagpath.append(m_tagfile);
+
+		hkOstream tagStream(tagpath);
+		hkStreamWriter* tagWriter = tagStream.getStreamWriter();
+
+		// The tag file is compressed as it is serialized, on the same writer thread
+		FbxToHkxCompressedStreamWriter* compressedWriter = HK_NULL;
+		if (m_compressionLevel > 0)
 		{
-			filename.append("_");
+			compressedWriter = new FbxToHkxCompressedStreamWriter(tagWriter, m_compressionLevel);
+			tagWriter = compressedWriter;
+		}
+
+		hkResult result = hkSerializeUtil::save(
+				currentRootContainer,
+				hkRootLevelContainerClass,
+				tagWriter,
+				hkSerializeUtil::SAVE_TEXT_FORMAT);
 
-			hkStringBuf name = scene->m_rootNode->m_name;
+		if (compressedWriter)
+		{
+			if (result == HK_SUCCESS)
+			{
+				result = compressedWriter->finish();
+			}
 
-			char invalid_characters[] = { ' ', '.', '/', '?', '<', '>', '\\', ':', '*', '|' };
-			for (int character_index = 0; character_index < sizeof(invalid_characters); character_index++ )
+			if (result == HK_SUCCESS)
 			{
-				name.replace(invalid_characters[character_index], '_');
+				logOut.appendPrintf("Compressed tag file: %d KB to %d KB\n",
+					int(compressedWriter->getNumBytesIn() / 1024), int(compressedWriter->getNumBytesOut() / 1024));
 			}
+			compressedWriter->removeReference();
+		}
 
-			filename.append( name );
+		if ( result == HK_SUCCESS )
+		{
+			logOut.appendPrintf("Saved tag file: %s\n", m_tagfile.cString());
+		}
+		else
+		{
+			logOut.appendPrintf("Cannot save file: %s\n", m_tagfile.cString());
 		}
 
-		PrintLine();
+		if (m_skeleton)
+		{
+			saveAnimationContainer(m_path, m_animationFile, m_scene, m_skeleton, m_rig, logOut);
+		}
+
+		logOut.appendPrintf("Number of frames: %d\n", m_scene->m_numFrames);
+		logOut.appendPrintf("Scene length: %0.2f\n", m_scene->m_sceneLength);
+		logOut.appendPrintf("Root node name: %s\n", m_scene->m_rootNode->m_name.cString());
+
+		delete currentRootContainer;
+	}
+
+private:
+
+	hkStringPtr m_path;
+	hkStringPtr m_tagfile;
+	int m_compressionLevel;
+	hkStringPtr m_animationFile;
+	hkxScene* m_scene;
+	hkaSkeleton* m_skeleton;
+	bool m_rig;
+};
+
+void FbxToHkxConverter::saveScenes(const char *path, const char *name)
+{
+	startSaving(path, name);
+	queueScenes(true);
+	finishSaving();
+}
+
+void FbxToHkxConverter::startSaving(const char *path, const char *name)
+{
+	HK_ASSERT(0x0, !m_sceneWriter);
+
+	printf("Output path: %s\n", path);
+
+	m_savePath = path;
+	m_saveName = name;
+	m_numQueuedScenes = 0;
+
+	// Allow the converter to get ahead of the writers by a couple of scenes
+	const int numThreads = hkMath::max2(m_options.m_numWriterThreads, 0);
+	m_sceneWriter = new FbxToHkxSceneWriter(numThreads, 2 * numThreads);
+}
+
+void FbxToHkxConverter::finishSaving()
+{
+	if (!m_sceneWriter)
+	{
+		return;
+	}
+
+	delete m_sceneWriter;
+	m_sceneWriter = HK_NULL;
+
+	if (m_skeleton)
+	{
+		m_skeleton->removeReference();
+		m_skeleton = HK_NULL;
+	}
+}
+
+void FbxToHkxConverter::addScene(hkxScene* scene)
+{
+	// A scene created while the conversion was cancelled can be incomplete
+	if (isCancelled())
+	{
+		scene->removeReference();
+		return;
+	}
+
+	m_scenes.pushBack(scene);
+	queueScenes(false);
+}
+
+void FbxToHkxConverter::queueScenes(bool allScenesCreated)
+{
+	// Texture baking changes the textures of the converted materials, so the scenes are only saved once it's done
+	if (!m_sceneWriter || (m_options.m_textureBakePath && !allScenesCreated))
+	{
+		return;
+	}
+
+	for (; m_numQueuedScenes < m_scenes.getSize(); m_numQueuedScenes++)
+	{
+		const int sceneIndex = m_numQueuedScenes;
+		hkxScene *scene = m_scenes[sceneIndex];
+
+		// The skeleton of the rig scene is shared by the rig and animation files
+		if (sceneIndex == 0 && m_options.m_createAnimations && m_numAnimStacks > 0 && m_numBones > 0)
+		{
+			m_skeleton = FbxToHkxAnimationBuilder::createSkeleton(scene);
+		}
+
+		hkStringBuf sceneName = scene->m_rootNode->m_name;
+
+		char invalid_characters[] = { ' ', '.', '/', '?', '<', '>', '\\', ':', '*', '|' };
+		for (int character_index = 0; character_index < sizeof(invalid_characters); character_index++ )
+		{
+			sceneName.replace(invalid_characters[character_index], '_');
+		}
+
+		hkStringBuf filename = m_saveName;
+
+		if (sceneIndex > 0)
+		{
+			filename.append("_");
+			filename.append( sceneName );
+		}
 
 		hkStringBuf tagfile = filename;
 		tagfile.append(".hkt");
+		if (m_options.m_tagFileCompressionLevel > 0)
+		{
+			tagfile.append(".gz");
+		}
 
-		hkStringBuf tagpath = path;
-		tagpath.append(tagfile);
-
-		if ( hkSerializeUtil::save(
-				currentRootContainer,
-				hkRootLevelContainerClass,
-				hkOstream(tagpath).getStreamWriter(),
-				hkSerializeUtil::SAVE_TEXT_FORMAT) == HK_SUCCESS )
+		// Same names as the files that the filter manager writes with AnimationRig.hko and Animation.hko
+		hkStringBuf animationFile = m_saveName;
+		if (sceneIndex > 0)
 		{
-			printf("Saved tag file: %s\n", tagfile.cString());
+			animationFile.append("__out_anim_");
+			animationFile.append(sceneName);
 		}
 		else
 		{
-			printf("Cannot save file: %s\n", tagfile.cString());
+			animationFile.append("__out_rig");
 		}
+		animationFile.append(".hkx");
 
-		printf("Number of frames: %d\n", scene->m_numFrames);
-		printf("Scene length: %0.2f\n", scene->m_sceneLength);
-		printf("Root node name: %s\n", scene->m_rootNode->m_name.cString());
+		m_sceneWriter->addJob(new SceneSaveJob(m_savePath, tagfile, m_options.m_tagFileCompressionLevel, animationFile, scene, m_skeleton, sceneIndex == 0));
+	}
+}
 
-		delete currentRootContainer;
+void FbxToHkxConverter::saveAnimationContainer(const char* path, const char* filename, hkxScene* scene, hkaSkeleton* skeleton, bool rig, hkStringBuf& logOut)
+{
+	hkaAnimationContainer* animationContainer = new hkaAnimationContainer();
+	animationContainer->m_skeletons.pushBack(skeleton);
+
+	hkRootLevelContainer* rootContainer = new hkRootLevelContainer();
+
+	if (rig)
+	{
+		// The rig keeps the scene data, like AnimationRig.hko does
+		rootContainer->m_namedVariants.expandOne().set("Scene Data", scene, &hkxSceneClass);
+		FbxToHkxAnimationBuilder::createMeshBindings(scene, skeleton, animationContainer->m_skins);
+	}
+	else
+	{
+		hkaAnimationBinding* binding = FbxToHkxAnimationBuilder::createAnimationBinding(scene, skeleton);
+		animationContainer->m_animations.pushBack(binding->m_animation);
+		animationContainer->m_bindings.pushBack(binding);
+		binding->removeReference();
+	}
+
+	rootContainer->m_namedVariants.expandOne().set("Merged Animation Container", animationContainer, &hkaAnimationContainerClass);
+
+	hkStringBuf filepath = path;
+	filepath.append(filename);
+
+	if ( hkSerializeUtil::save(
+			rootContainer,
+			hkRootLevelContainerClass,
+			hkOstream(filepath).getStreamWriter()) == HK_SUCCESS )
+	{
+		logOut.appendPrintf("Saved %s file: %s\n", rig ? "rig" : "animation", filename);
 	}
+	else
+	{
+		logOut.appendPrintf("Cannot save file: %s\n", filename);
+	}
+
+	delete rootContainer;
+	animationContainer->removeReference();
 }
 
 // This method is templated on the implementation of hctMayaSceneExporter/hctMaxSceneExporter::createScene()
@@ -139,6 +370,10 @@ bool FbxToHkxConverter::createScenes(FbxScene* fbxScene)
 	m_curFbxScene = fbxScene;
 	m_rootNode = m_curFbxScene->GetRootNode();
 
+	hkString::memSet(&m_progress, 0, sizeof(m_progress));
+	m_progress.m_animStackIndex = -1;
+	reportProgress(PHASE_PREPARE);
+
 	m_modeller = "FBX";
 	hkStringBuf application = fbxScene->GetSceneInfo()->Original_ApplicationName.Get();
 	if (application.getLength() > 0)
@@ -149,6 +384,8 @@ bool FbxToHkxConverter::createScenes(FbxScene* fbxScene)
 	}
 	printf("Modeller: %s\n", m_modeller.cString());
 
+	setupAxisConversion();
+
 	if (m_options.m_selectedOnly)
 	{
 		printf("Exporting Selected Only\n");
@@ -159,11 +396,6 @@ bool FbxToHkxConverter::createScenes(FbxScene* fbxScene)
 		printf("Exporting Visible Only\n");
 	}
 
-	hkArray<FbxNode*> boneNodes;
-	findChildren(m_rootNode, boneNodes, FbxNodeAttribute::eSkeleton);
-	m_numBones = boneNodes.getSize();
-	printf("Bones: %d\n", m_numBones);
-
 	const int poseCount = m_curFbxScene->GetPoseCount();
 	if (poseCount > 0)
 	{
@@ -171,7 +403,7 @@ bool FbxToHkxConverter::createScenes(FbxScene* fbxScene)
 		printf("Pose Elements: %d\n", m_pose->GetCount());		
 	}
 
-	m_numAnimStacks = m_curFbxScene->GetSrcObjectCount<FbxAnimStack>();
+	m_numAnimStacks = m_options.m_exportAnimations ? m_curFbxScene->GetSrcObjectCount<FbxAnimStack>() : 0;
 	if (m_numAnimStacks > 0)
 	{
 		const FbxAnimStack* lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(0);
@@ -180,22 +412,93 @@ bool FbxToHkxConverter::createScenes(FbxScene* fbxScene)
 		m_startTime = animTimeSpan.GetStart();
 	}
 	printf("Animation stacks: %d\n", m_numAnimStacks);
+	m_progress.m_numAnimStacks = m_numAnimStacks;
+
+	if (m_options.m_clipFile && !loadAnimationClips(m_options.m_clipFile))
+	{
+		return false;
+	}
+
+	filterNodes();
 
-	createSceneStack(-1);
+	if (m_options.m_optimizeHierarchy)
+	{
+		optimizeHierarchy();
+	}
+
+	// Only the skeleton nodes that are converted are bones
+	hkArray<FbxNode*> boneNodes;
+	findChildren(m_rootNode, boneNodes, FbxNodeAttribute::eSkeleton);
+	m_numBones = 0;
+	for (int boneIndex = 0; boneIndex < boneNodes.getSize(); boneIndex++)
+	{
+		if (!isNodeRemoved(boneNodes[boneIndex]) && m_nodeOptimizations.getWithDefault(boneNodes[boneIndex], NODE_KEEP) != NODE_COLLAPSE)
+		{
+			m_numBones++;
+		}
+	}
+	printf("Bones: %d\n", m_numBones);
+
+	if (m_options.m_skeletonOnlyAnimations && m_numAnimStacks > 0 && m_numBones > 0)
+	{
+		markRigOnlyNodes();
+	}
+
+	// The rig is posed at the start of the first animation stack
+	const FbxTimeSpan rigTimeSpan = (m_numAnimStacks > 0) ? m_curFbxScene->GetSrcObject<FbxAnimStack>(0)->GetLocalTimeSpan() : FbxTimeSpan();
+	addScene(createSceneStack(-1, rigTimeSpan, true));
 
 	for (int animStackIndex = 0;
-		 animStackIndex < m_numAnimStacks && m_numBones > 0;
+		 animStackIndex < m_numAnimStacks && m_numBones > 0 && !isCancelled();
 		 animStackIndex++)
 	{
-		createSceneStack(animStackIndex);
+		FbxAnimStack* lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex);
+		if (!isAnimStackSelected(lAnimStack->GetName()))
+		{
+			printf("Skipping animation stack [%s]\n", lAnimStack->GetName());
+			continue;
+		}
+
+		hkArray<AnimationClip> clips;
+		findAnimationClips(animStackIndex, clips);
+
+		if (clips.getSize() > 0)
+		{
+			createClipScenes(animStackIndex, clips);
+		}
+		else
+		{
+			addScene(createSceneStack(animStackIndex, lAnimStack->GetLocalTimeSpan(), true));
+		}
+	}
+
+	if (isCancelled())
+	{
+		printf("Conversion cancelled\n");
+		return false;
 	}
+
+	if (m_options.m_exportMaterials)
+	{
+		printf("Materials: %d converted, %d reused\n", m_materialCache.getSize(), m_numReusedMaterials);
+	}
+
+	if (m_options.m_textureBakePath)
+	{
+		reportProgress(PHASE_BAKE_TEXTURES);
+		bakeTextures();
+	}
+
+	queueScenes(true);
 	
 	return true;
 }
 
 // This method is templated on the implementation of hctMayaSceneExporter/hctMaxSceneExporter::createScene()
-bool FbxToHkxConverter::createSceneStack(int animStackIndex)
+hkxScene* FbxToHkxConverter::createSceneStack(int animStackIndex, const FbxTimeSpan& timeSpan, bool writeKeyFrames)
 {
+	FbxToHkxTraceScope traceScope("createSceneStack", (animStackIndex >= 0) ? m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex)->GetName() : "ROOT_NODE");
+
 	hkxScene *scene = new hkxScene;
 
 	scene->m_modeller.set(m_modeller.cString());
@@ -236,43 +539,141 @@ bool FbxToHkxConverter::createSceneStack(int animStackIndex)
 		{
 			rootNode->m_name = lAnimStack->GetName();
 
-			const FbxTimeSpan animTimeSpan = lAnimStack->GetLocalTimeSpan();
-			scene->m_sceneLength = static_cast<hkReal>( animTimeSpan.GetDuration().GetSecondDouble() );
-			scene->m_numFrames = static_cast<hkUint32>( animTimeSpan.GetDuration().GetFrameCount(m_curFbxScene->GetGlobalSettings().GetTimeMode()) );
+			// The scene covers the whole samples that fit into the time span, and at least one
+			const FbxTime timePerSample = getSampleTimeStep(lAnimStack->GetName());
+			scene->m_numFrames = static_cast<hkUint32>( timeSpan.GetDuration().Get() / timePerSample.Get() );
+			if (scene->m_numFrames == 0 && timeSpan.GetDuration() > FbxTime(0))
+			{
+				scene->m_numFrames = 1;
+			}
+			scene->m_sceneLength = static_cast<hkReal>( (timePerSample * (int) scene->m_numFrames).GetSecondDouble() );
 			
 			printf("Converting nodes for [%s]...\n", rootNode->m_name.cString());
+
+			const FbxTime::EMode timeMode = m_curFbxScene->GetGlobalSettings().GetTimeMode();
+			FbxTime timePerFrame; timePerFrame.SetTime(0, 0, 0, 1, 0, timeMode);
+			if (timePerSample != timePerFrame)
+			{
+				printf("Resampling [%s] from %g to %g fps: %d frames\n", rootNode->m_name.cString(), FbxTime::GetFrameRate(timeMode), 1.0 / timePerSample.GetSecondDouble(), scene->m_numFrames);
+			}
 		}
 
 		scene->m_rootNode = rootNode;
 		rootNode->removeReference();
 
+		m_rigPass = rigPass;
+		m_sampleTimeSpan = timeSpan;
+		m_sampleTimeStep = getSampleTimeStep(lAnimStack ? lAnimStack->GetName() : HK_NULL);
+
+		m_progress.m_animStackIndex = animStackIndex;
+		m_progress.m_nodeIndex = 0;
+		m_progress.m_numNodes = countNodesRecursive(m_rootNode);
+		m_progress.m_frameIndex = 0;
+		m_progress.m_numFrames = (int) scene->m_numFrames;
+		reportProgress(PHASE_CONVERT_NODES);
+
 		// Setup (identity) keyframes(s) for the 'static' root node
 		rootNode->m_keyFrames.setSize( scene->m_numFrames > 1 ? 2 : 1, hkMatrix4::getIdentity() );
 
 		addNodesRecursive(scene, m_rootNode, scene->m_rootNode, currentAnimStackIndex);
+
+		if (writeKeyFrames)
+		{
+			m_keyFrameStore.writeKeyFrames();
+		}
+
+		reportProgress(PHASE_PROCESS_MESHES);
+		processMeshSectionJobs();
 	}
 
-	m_scenes.pushBack(scene);
+	return scene;
+}
 
-	return true;
+// Time between two samples of the animation stack, one frame of the file unless a sample rate is given
+FbxTime FbxToHkxConverter::getSampleTimeStep(const char* animStackName) const
+{
+	hkReal sampleRate = m_options.m_sampleRate;
+	for (int i = 0; animStackName && i < m_options.m_animStackSampleRates.getSize(); i++)
+	{
+		if (hkString::strCmp(m_options.m_animStackSampleRates[i].m_animStackName, animStackName) == 0)
+		{
+			sampleRate = m_options.m_animStackSampleRates[i].m_sampleRate;
+		}
+	}
+
+	FbxTime timePerSample;
+	if (sampleRate > 0.0f)
+	{
+		timePerSample.SetSecondDouble(1.0 / sampleRate);
+	}
+	else
+	{
+		timePerSample.SetTime(0, 0, 0, 1, 0, m_curFbxScene->GetGlobalSettings().GetTimeMode());
+	}
+	return timePerSample;
 }
 
 // This method is templated on the implementation of hctMayaSceneExporter::createHkxNodes()
-void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkxNode* node, int animStackIndex)
+void FbxToHkxConverter::reportProgress(Phase phase)
+{
+	m_progress.m_phase = phase;
+	reportProgress();
+}
+
+void FbxToHkxConverter::reportProgress()
+{
+	if (m_options.m_progressObserver)
+	{
+		m_options.m_progressObserver->onProgress(m_progress);
+	}
+}
+
+// Has to skip the same nodes as addNodesRecursive
+int FbxToHkxConverter::countNodesRecursive(FbxNode* fbxNode) const
 {
+	int numNodes = 0;
 	for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); childIndex++)
+	{
+		FbxNode* fbxChildNode = fbxNode->GetChild(childIndex);
+
+		const int optimization = m_nodeOptimizations.getWithDefault(fbxChildNode, NODE_KEEP);
+		if (optimization == NODE_REMOVE || (optimization == NODE_RIG_ONLY && !m_rigPass))
+		{
+			continue;
+		}
+
+		numNodes += (optimization == NODE_COLLAPSE) ? 0 : 1;
+		numNodes += countNodesRecursive(fbxChildNode);
+	}
+	return numNodes;
+}
+
+void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkxNode* node, int animStackIndex)
+{
+	for (int childIndex = 0; childIndex < fbxNode->GetChildCount() && !isCancelled(); childIndex++)
 	{
 		FbxNode* fbxChildNode = fbxNode->GetChild(childIndex);
 		FbxNodeAttribute* fbxNodeAtttrib = fbxChildNode->GetNodeAttribute();
 		bool selected = fbxChildNode->GetSelected();
 
-		// Ignore nodes(and their descendants) if they're invisible and we ignore invisible objects
-		if ( !(!m_options.m_visibleOnly || fbxNode->GetVisibility()) )
+		// Excluded nodes are skipped with their descendants, collapsed nodes are baked into the transforms of their children
+		const int optimization = m_nodeOptimizations.getWithDefault(fbxChildNode, NODE_KEEP);
+		if (optimization == NODE_REMOVE)
+		{
 			continue;
-
-		// Ignore nodes(and their descendants) if they're not selected and we ignore deselected objects
-		if ( !(!m_options.m_selectedOnly || selected) )
+		}
+		else if (optimization == NODE_COLLAPSE)
+		{
+			addNodesRecursive(scene, fbxChildNode, node, animStackIndex);
+			continue;
+		}
+		else if (optimization == NODE_RIG_ONLY && !m_rigPass)
+		{
 			continue;
+		}
+
+		// Skeleton only animation scenes leave the meshes, cameras, lights and splines to the rig scene
+		const bool exportObjects = m_rigPass || !m_options.m_skeletonOnlyAnimations;
 
 		hkxNode* newChildNode = new hkxNode();
 		{
@@ -282,6 +683,10 @@ void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkx
 
 		newChildNode->m_selected = selected;
 
+		m_progress.m_nodeIndex++;
+		m_progress.m_frameIndex = 0;
+		reportProgress();
+
 		// Extract the following types of data from this node (taken from hkxScene.h):
 		if (fbxNodeAtttrib != NULL)
 		{
@@ -292,13 +697,21 @@ void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkx
 					// Generate hkxMesh and all its dependent data (ie: hkxSkinBinding, hkxMeshSection, hkxMaterial)
 					if (m_options.m_exportMeshes)
 					{
-						addMesh(scene, fbxChildNode, newChildNode);
+						if (exportObjects)
+						{
+							addMesh(scene, fbxChildNode, newChildNode);
+						}
+
+						if (m_options.m_exportVertexAnimations)
+						{
+							addBlendShapeWeights(scene, fbxChildNode, newChildNode, animStackIndex);
+						}
 					}
 					break;
 				}
 			case FbxNodeAttribute::eNurbsCurve:
 				{
-					if (m_options.m_exportSplines)
+					if (m_options.m_exportSplines && exportObjects)
 					{
 						addSpline(scene, fbxChildNode, newChildNode);
 					}
@@ -307,7 +720,7 @@ void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkx
 			case FbxNodeAttribute::eCamera:
 				{
 					// Generate hkxCamera
-					if (m_options.m_exportCameras)
+					if (m_options.m_exportCameras && exportObjects)
 					{
 						addCamera(scene, fbxChildNode, newChildNode);
 					}
@@ -316,7 +729,7 @@ void FbxToHkxConverter::addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkx
 			case FbxNodeAttribute::eLight:
 				{
 					// Generate hkxLight
-					if (m_options.m_exportLights)
+					if (m_options.m_exportLights && exportObjects)
 					{
 						addLight(scene, fbxChildNode, newChildNode);
 					}
@@ -395,13 +808,13 @@ void FbxToHkxConverter::extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode*
 	{
 		lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex);
 		numAnimLayers = lAnimStack->GetMemberCount<FbxAnimLayer>();
-		animTimeSpan = lAnimStack->GetLocalTimeSpan();
+		animTimeSpan = m_sampleTimeSpan;
 	}
 
 	// Find the time offset (in the "time space" of the FBX file) of the first animation frame
-	FbxTime timePerFrame; timePerFrame.SetTime(0, 0, 0, 1, 0, m_curFbxScene->GetGlobalSettings().GetTimeMode());
+	const FbxTime timePerSample = m_sampleTimeStep;
 	const FbxTime startTime = animTimeSpan.GetStart();
-	const FbxTime endTime = animTimeSpan.GetStop();
+	const FbxTime endTime = startTime + timePerSample * (int) scene->m_numFrames;
 
 	const hkReal startTimeSeconds = static_cast<hkReal>(startTime.GetSecondDouble());
 	const hkReal endTimeSeconds = static_cast<hkReal>(endTime.GetSecondDouble());
@@ -411,28 +824,36 @@ void FbxToHkxConverter::extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode*
 
 	if (scene->m_sceneLength == 0)
 	{
-		bindPoseMatrix = fbxChildNode->EvaluateLocalTransform(startTime);
+		bindPoseMatrix = convertTransform(evaluateLocalTransform(fbxChildNode, startTime));
 	}
 	else
 	{
-		hkArray<hkStringOld> annotationStrings;
-		hkArray<hkReal> annotationTimes;
-
 		HK_ASSERT(0x0, newChildNode->m_keyFrames.getSize() == 0);
+		FbxToHkxTraceScope traceScope("sampleNode", newChildNode->m_name);
+
+		// The keys are kept in the store until the scene is complete, static nodes are removed from it below
+		FbxToHkxKeyFrameStore::Track& track = m_keyFrameStore.addTrack(newChildNode, (int) scene->m_numFrames);
 
 		// Sample each animation frame
 		for (FbxTime time = startTime, priorSampleTime = endTime;
-			 time < endTime;
-			 priorSampleTime = time, time += timePerFrame, ++numFrames)
+			 time < endTime && !isCancelled();
+			 priorSampleTime = time, time += timePerSample, ++numFrames)
 		{
-			FbxAMatrix frameMatrix = fbxChildNode->EvaluateLocalTransform(time);
-			staticNode = staticNode && (frameMatrix == bindPoseMatrix);
+			m_progress.m_frameIndex = numFrames;
+			reportProgress();
 
-			hkMatrix4 mat;
+			FbxAMatrix frameMatrix = convertTransform(evaluateLocalTransform(fbxChildNode, time));
 
 			// Extract this frame's transform
-			convertFbxXMatrixToMatrix4(frameMatrix, mat);
-			newChildNode->m_keyFrames.pushBack(mat);
+			hkQsTransform key;
+			convertFbxAMatrixToQsTransform(frameMatrix, key);
+			track.addKey(key);
+
+			if (numFrames == 0)
+			{
+				bindPoseMatrix = frameMatrix;
+			}
+			staticNode = staticNode && track.isKeyEqual(numFrames, 0);
 
 			// Extract all annotation strings for this frame using the deprecated
 			// pipeline (new annotations are extracted when sampling attributes)
@@ -459,8 +880,16 @@ void FbxToHkxConverter::extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode*
 							const int currentEnumValueIndex = keyIndex < 0 ? (int) lAnimCurve->Evaluate(priorSampleTime) : (int) lAnimCurve->Evaluate(time);
 							HK_ASSERT(0x0, currentEnumValueIndex < prop.GetEnumCount());
 							const char* enumValue = prop.GetEnumValue(currentEnumValueIndex);
+
+							// Annotations keep the time of their key, which can lie between two samples
+							FbxTime annotationTime = (keyIndex >= 0) ? lAnimCurve->KeyGetTime(keyIndex) : time;
+							if (annotationTime < startTime)
+							{
+								annotationTime = startTime;
+							}
+
 							hkxNode::AnnotationData& annotation = newChildNode->m_annotations.expandOne();
-							annotation.m_time = (hkReal) (time - startTime).GetSecondDouble();
+							annotation.m_time = (hkReal) (annotationTime - startTime).GetSecondDouble();
 							annotation.m_description = (name + hkStringOld(enumValue, hkString::strLen(enumValue))).cString();
 						}
 					}
@@ -468,9 +897,14 @@ void FbxToHkxConverter::extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode*
 				}
 			}
 		}
+
+		if (staticNode)
+		{
+			m_keyFrameStore.removeLastTrack();
+		}
 	}
 
-	// Replace animation key data for static nodes with just 1 or 2 frames of bind pose data
+	// Nodes that don't move are stored with just 1 or 2 frames of their first pose
 	if (staticNode)
 	{
 		// Static nodes in animated scene data are exported with two keys
@@ -491,7 +925,7 @@ void FbxToHkxConverter::extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode*
 
 	// Extract all times of actual keyframes for the current node... this can be used by Vision
 	if ( m_options.m_storeKeyframeSamplePoints &&
-		 newChildNode->m_keyFrames.getSize() > 2 &&
+		 !staticNode && numFrames > 2 &&
 		 numAnimLayers > 0 )
 	{
 		FbxAnimLayer* lAnimLayer = lAnimStack->GetMember<FbxAnimLayer>(0);
@@ -584,6 +1018,83 @@ FbxAMatrix FbxToHkxConverter::getGlobalPosition(FbxNode* pNode, const FbxTime& p
 	return lGlobalPosition;
 }
 
+// Right, up and front vectors of an axis system. The front vector is the first (even parity) or second (odd parity) of
+// the two axes that aren't up, and right completes the frame with the handedness of the axis system.
+static void getAxisSystemBasis(const FbxAxisSystem& axisSystem, double basisOut[3][3])
+{
+	int upSign, frontSign;
+	const int upAxis = axisSystem.GetUpVector(upSign) - FbxAxisSystem::eXAxis;
+	const int frontAxis = (axisSystem.GetFrontVector(frontSign) == FbxAxisSystem::eParityEven) ? (upAxis == 0 ? 1 : 0) : (upAxis == 2 ? 1 : 2);
+	const double handedness = (axisSystem.GetCoorSystem() == FbxAxisSystem::eRightHanded) ? 1.0 : -1.0;
+
+	double* right = basisOut[0];
+	double* up = basisOut[1];
+	double* front = basisOut[2];
+	for (int i = 0; i < 3; i++)
+	{
+		up[i] = (i == upAxis) ? upSign : 0.0;
+		front[i] = (i == frontAxis) ? frontSign : 0.0;
+	}
+
+	right[0] = handedness * (up[1] * front[2] - up[2] * front[1]);
+	right[1] = handedness * (up[2] * front[0] - up[0] * front[2]);
+	right[2] = handedness * (up[0] * front[1] - up[1] * front[0]);
+}
+
+void FbxToHkxConverter::setupAxisConversion()
+{
+	FbxGlobalSettings& globalSettings = m_curFbxScene->GetGlobalSettings();
+	const FbxAxisSystem sourceAxisSystem = globalSettings.GetAxisSystem();
+
+	double sourceBasis[3][3];
+	double targetBasis[3][3];
+	getAxisSystemBasis(sourceAxisSystem, sourceBasis);
+	getAxisSystemBasis(m_options.m_targetAxisSystem, targetBasis);
+
+	const double sourceUnit = globalSettings.GetSystemUnit().GetScaleFactor();
+	const double unitScale = (m_options.m_targetUnitInCentimeters > 0.0f) ? sourceUnit / m_options.m_targetUnitInCentimeters : 1.0;
+	m_unitScale = (hkReal) unitScale;
+
+	// Row i is the target of axis i of the file, the target vectors weighted by the coordinates of the source vectors
+	m_axisRotation.SetIdentity();
+	m_axisConversion.SetIdentity();
+	m_axisConversionInverse.SetIdentity();
+	for (int i = 0; i < 3; i++)
+	{
+		for (int j = 0; j < 3; j++)
+		{
+			double value = 0.0;
+			for (int k = 0; k < 3; k++)
+			{
+				value += sourceBasis[k][i] * targetBasis[k][j];
+			}
+			m_axisRotation.mData[i][j] = value;
+			m_axisConversion.mData[i][j] = value * unitScale;
+			m_axisConversionInverse.mData[j][i] = value / unitScale;
+		}
+	}
+
+	m_flipWinding = (sourceAxisSystem.GetCoorSystem() != m_options.m_targetAxisSystem.GetCoorSystem());
+
+	printf("Axis conversion: %s, unit scale: %g\n",
+		m_flipWinding ? "reflection" : ((sourceAxisSystem == m_options.m_targetAxisSystem) ? "none" : "rotation"), unitScale);
+}
+
+FbxAMatrix FbxToHkxConverter::convertTransform(const FbxAMatrix& transform) const
+{
+	return m_axisConversion * transform * m_axisConversionInverse;
+}
+
+FbxVector4 FbxToHkxConverter::convertPosition(const FbxVector4& position) const
+{
+	return m_axisConversion.MultT(position);
+}
+
+FbxVector4 FbxToHkxConverter::convertDirection(const FbxVector4& direction) const
+{
+	return m_axisRotation.MultT(direction);
+}
+
 //-------
 
 FbxAMatrix GetPoseMatrix(FbxPose* pPose, int pNodeIndex)
@@ -626,7 +1137,7 @@ FbxAMatrix GetGeometry(FbxNode* pNode)
 
 static void PrintLine()
 {
-	printf("-------------------------------------------------------------------------------\n");
+	printf("%s", s_separatorLine);
 }
 
 /*
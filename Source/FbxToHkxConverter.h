@@ -18,13 +18,92 @@
 #include <Common/Base/hkBase.h>
 #include <Common/SceneData/Scene/hkxScene.h>
 #include <Common/SceneData/Graph/hkxNode.h>
+#include <Common/SceneData/Mesh/hkxMeshSection.h>
+#include <Common/SceneData/Material/hkxTextureFile.h>
 #include <Common/Base/Container/PointerMap/hkPointerMap.h>
 #include <Common/Base/Container/String/Deprecated/hkStringOld.h>
+#include "FbxToHkxTextureBaker.h"
+#include "FbxToHkxAnimationBuilder.h"
+#include "FbxToHkxKeyFrameStore.h"
+#include "FbxToHkxSceneWriter.h"
 
 class FbxToHkxConverter
 {
 public:
 
+	// Output formats for the vertex streams written by fillBuffers, anything but FLOAT32 is applied as a final
+	// compaction stage per mesh section
+	enum NormalFormat
+	{
+		NORMAL_FORMAT_FLOAT32,
+		NORMAL_FORMAT_OCTAHEDRAL16,		// 2 x snorm16 octahedral encoding (HKX_DT_INT16 x2)
+		NORMAL_FORMAT_PACKED_10_10_10_2	// 3 x unorm10 + 2 bit w (HKX_DT_UINT32 x1)
+	};
+
+	enum TexCoordFormat
+	{
+		TEXCOORD_FORMAT_FLOAT32,
+		TEXCOORD_FORMAT_HALF16,			// IEEE half float bits (HKX_DT_INT16 x2)
+		TEXCOORD_FORMAT_UNORM16			// unorm16 over the range of the UV set in the section (HKX_DT_INT16 x2)
+	};
+
+	enum PositionFormat
+	{
+		POSITION_FORMAT_FLOAT32,
+		POSITION_FORMAT_UNORM16			// unorm16 over the bounding box of the section (HKX_DT_INT16 x4, w unused)
+	};
+
+	// Stages of createScenes reported to the progress observer
+	enum Phase
+	{
+		PHASE_PREPARE,			// Reading the scene settings, node filters, hierarchy optimization and clips
+		PHASE_CONVERT_NODES,	// Converting and sampling the nodes of the rig scene or of an animation stack
+		PHASE_PROCESS_MESHES,	// Processing the mesh sections of the current scene on the worker threads
+		PHASE_BAKE_TEXTURES
+	};
+
+	struct Progress
+	{
+		Phase m_phase;
+
+		// Animation stack of the current scene (-1 for the rig scene) and the number of stacks in the file
+		int m_animStackIndex;
+		int m_numAnimStacks;
+
+		// Nodes of the current scene converted so far and the number of nodes it gets
+		int m_nodeIndex;
+		int m_numNodes;
+
+		// Frame of the current node that is sampled and the number of frames of the current scene
+		int m_frameIndex;
+		int m_numFrames;
+	};
+
+	// Receives the progress of createScenes on the thread that calls it, once per phase, node and sampled frame
+	class ProgressObserver
+	{
+	public:
+
+		virtual ~ProgressObserver() {}
+		virtual void onProgress(const Progress& progress) = 0;
+	};
+
+	// Cancelling the token from any thread stops createScenes at the next node, frame, polygon or mesh section and
+	// makes it return false. Scenes that were already queued for saving are still saved by finishSaving.
+	class CancellationToken
+	{
+	public:
+
+		CancellationToken() : m_cancelled(false) {}
+
+		void cancel() { m_cancelled = true; }
+		bool isCancelled() const { return m_cancelled; }
+
+	private:
+
+		volatile bool m_cancelled;
+	};
+
 	struct Options
 	{
 		FbxManager* m_fbxSdkManager;
@@ -40,6 +119,94 @@ public:
 		bool		m_visibleOnly;
 		bool		m_selectedOnly;
 		bool		m_storeKeyframeSamplePoints;
+		bool		m_optimizeIndexBuffers;
+
+		NormalFormat	m_normalFormat;
+		TexCoordFormat	m_texCoordFormat;
+		PositionFormat	m_positionFormat;
+
+		// Quantization tolerances, a warning is raised for sections that exceed them (0 disables the check)
+		hkReal		m_maxPositionError;
+		hkReal		m_maxNormalErrorDegrees;
+		hkReal		m_maxTexCoordError;
+
+		// Number of threads used for the per mesh section processing (0 uses all hardware threads)
+		int			m_numThreads;
+
+		// Triangle ratio of each generated LOD relative to the full mesh, e.g. { 0.5, 0.25 } for two LODs
+		hkArray<hkReal> m_lodTargetRatios;
+
+		// Store blend shape deltas as 16 bit values and skip vertices that move less than the tolerance
+		bool		m_quantizeBlendShapes;
+		hkReal		m_blendShapeTolerance;
+
+		// Directory that referenced images are baked into as compressed DDS files (HK_NULL keeps the source images)
+		const char*	m_textureBakePath;
+
+		// Sidecar file with the clips to split the animation stacks into (HK_NULL uses HKClip markers, if any)
+		const char*	m_clipFile;
+
+		// Names of the animation stacks to export (empty exports all of them)
+		hkArray<hkStringPtr> m_animStackNames;
+
+		// Rate the animation stacks are sampled at in frames per second (0 samples every frame of the file)
+		hkReal		m_sampleRate;
+
+		struct AnimStackSampleRate
+		{
+			hkStringPtr m_animStackName;
+			hkReal m_sampleRate;
+		};
+
+		// Sample rates of individual animation stacks that override m_sampleRate
+		hkArray<AnimStackSampleRate> m_animStackSampleRates;
+
+		// Create the skeleton, skins and compressed animations and save them next to the scenes, so the rig and
+		// animation files don't need the filter manager
+		bool		m_createAnimations;
+
+		// Collapse transform-only nodes into their children and remove unused leaf bones and helper nodes before
+		// the scenes are converted. Nodes whose names match one of the protected patterns ('*' and '?' wildcards)
+		// are always kept.
+		bool		m_optimizeHierarchy;
+		hkArray<hkStringPtr> m_protectedNodeNames;
+
+		// Patterns matched against node names, attribute type names (mesh, skeleton, camera, ...) and display layer
+		// names. Nodes that match the exclude filter are skipped with their descendants. If the include filter has
+		// any patterns, only nodes that match it, their descendants and the nodes leading to them are converted.
+		struct NodeFilter
+		{
+			hkArray<hkStringPtr> m_nodeNames;
+			hkArray<hkStringPtr> m_attributeTypes;
+			hkArray<hkStringPtr> m_layerNames;
+		};
+
+		NodeFilter	m_includeFilter;
+		NodeFilter	m_excludeFilter;
+
+		// Only convert bones, animated nodes and nodes with attributes, annotations or blend shape weights for the
+		// animation stacks, without meshes, cameras, lights and splines. Those are only in the rig scene.
+		bool		m_skeletonOnlyAnimations;
+
+		// Convert the animation stacks. Without them only the rig scene is created and the FBX importer can skip
+		// loading the animation curves altogether.
+		bool		m_exportAnimations;
+
+		// Number of threads that save the scenes while the next ones are converted (0 saves them on the main thread)
+		int			m_numWriterThreads;
+
+		// zlib level (1 to 9) the tag files are compressed with into .hkt.gz files on the writer threads, 0 saves
+		// them uncompressed
+		int			m_tagFileCompressionLevel;
+
+		// Axis system and unit (in centimeters, 0 keeps the unit of the file) the scene is converted to. The axis
+		// system and unit of the file are read from its global settings.
+		FbxAxisSystem	m_targetAxisSystem;
+		hkReal		m_targetUnitInCentimeters;
+
+		// Both are optional (HK_NULL) and must outlive the converter
+		ProgressObserver*			m_progressObserver;
+		const CancellationToken*	m_cancellationToken;
 
 		Options(FbxManager* fbxSdkManager);
 	};
@@ -50,8 +217,69 @@ public:
 	bool createScenes(FbxScene* fbxScene);
 	void saveScenes(const char *path, const char *name);
 
+	// Save each scene that createScenes creates as soon as it is complete, instead of waiting for saveScenes.
+	// finishSaving returns once all of them have been saved.
+	void startSaving(const char *path, const char *name);
+	void finishSaving();
+
 private:
 
+	// Inputs of the per mesh section processing that runs on worker threads once all FBX data has been gathered
+	struct MeshSectionJob
+	{
+		HK_DECLARE_NONVIRTUAL_CLASS_ALLOCATOR(HK_MEMORY_CLASS_SCENE_DATA, MeshSectionJob);
+
+		hkRefPtr<hkxMeshSection> m_section;
+		hkxScene* m_scene;
+		hkxNode* m_node;
+		hkxSkinBinding* m_skinBinding;
+		hkStringPtr m_meshName;
+
+		// Control point of each vertex written by fillBuffers
+		hkArray<int> m_vertexControlPoints;
+
+		// Smoothing group of each triangle, only set if normals have to be generated
+		hkArray<int> m_triangleSmoothingGroups;
+
+		// UV sets without FBX tangent and binormal layers for which tangents have to be generated
+		hkArray<int> m_tangentUvSets;
+
+		struct BlendShapeTarget
+		{
+			int m_channel;
+			hkReal m_fullWeight;
+
+			// Offset of each control point and the normal of each vertex (empty if the target has no normals)
+			hkArray<hkVector4> m_positionDeltas;
+			hkArray<hkVector4> m_normals;
+		};
+
+		hkArray<hkStringPtr> m_blendShapeChannels;
+		hkArray<BlendShapeTarget> m_blendShapeTargets;
+
+		// LOD child nodes created by the job, they are added to the scene on the main thread
+		hkArray< hkRefPtr<hkxNode> > m_lodNodes;
+
+		// The converted mesh, the geometric transform baked into it and the other nodes instancing it
+		hkxMesh* m_mesh;
+		FbxAMatrix m_geometricTransform;
+		hkArray<hkxNode*> m_instanceNodes;
+
+		// Report lines of the job, printed in job order once all jobs have finished
+		hkStringBuf m_log;
+	};
+
+	// A frame range of an animation stack that is exported as a scene of its own
+	struct AnimationClip
+	{
+		hkStringPtr m_name;
+		// HK_NULL applies the clip to every animation stack
+		hkStringPtr m_animStackName;
+		int m_startFrame;
+		// Exclusive, like the stop time of an animation stack
+		int m_endFrame;
+	};
+
 	//---- static declarations
 	
 	static FbxAMatrix convertMatrix(const FbxMatrix& mat);
@@ -72,13 +300,28 @@ private:
 		matrix.setCols(c0,c1,c2,c3);
 	}
 
-	static void fillBuffers(
+	static void convertFbxAMatrixToQsTransform(const FbxAMatrix& fbxMatrix, hkQsTransform& transform)
+	{
+		const FbxVector4 t = fbxMatrix.GetT();
+		const FbxQuaternion q = fbxMatrix.GetQ();
+		const FbxVector4 s = fbxMatrix.GetS();
+
+		transform.m_translation.set((float)t[0],(float)t[1],(float)t[2]);
+		transform.m_rotation.set((float)q[0],(float)q[1],(float)q[2],(float)q[3]);
+		transform.m_scale.set((float)s[0],(float)s[1],(float)s[2]);
+	}
+
+	// Both apply the axis conversion to the vertex data
+	void fillBuffers(
 		FbxMesh* pMesh,
 		FbxNode* originalNode,
 		hkxVertexBuffer* newVB,
 		hkxIndexBuffer* newIB,
 		const hkArray<float>& skinControlPointWeights,
-		const hkArray<int>& skinIndicesToClusters);
+		const hkArray<int>& skinIndicesToClusters,
+		bool exportTangents,
+		MeshSectionJob& job) const;
+	void gatherBlendShapes(FbxMesh* pMesh, FbxNode* originalNode, MeshSectionJob& job) const;
 	static void findChildren(FbxNode* root, hkArray<FbxNode*>& children, FbxNodeAttribute::EType type);
 
 	// Get the global position of the node for the current pose.
@@ -94,13 +337,100 @@ private:
 
 	void clear();
 
-	bool createSceneStack(int animStackIndex);
+	bool isCancelled() const { return m_options.m_cancellationToken && m_options.m_cancellationToken->isCancelled(); }
+	void reportProgress(Phase phase);
+	void reportProgress();
+
+	// Number of nodes addNodesRecursive converts below the FBX node in the current pass
+	int countNodesRecursive(FbxNode* fbxNode) const;
+
+	class SceneSaveJob;
+
+	static void saveAnimationContainer(const char* path, const char* filename, hkxScene* scene, hkaSkeleton* skeleton, bool rig, hkStringBuf& logOut);
+
+	// Add a scene created by createScenes, and queue the completed scenes for saving if startSaving was called
+	void addScene(hkxScene* scene);
+	void queueScenes(bool allScenesCreated);
+
+	// Create the scene of the animation stack sampled over the given time span. Returns a new reference. Without
+	// writeKeyFrames the keys of the animated nodes are left in m_keyFrameStore.
+	hkxScene* createSceneStack(int animStackIndex, const FbxTimeSpan& timeSpan, bool writeKeyFrames);
+	FbxTime getSampleTimeStep(const char* animStackName) const;
+
+	// Clips are read from the sidecar file or the HKClip markers of each stack. The stack is sampled once over the
+	// union of its clips and the result is sliced into one scene per clip.
+	bool isAnimStackSelected(const char* animStackName) const;
+	bool loadAnimationClips(const char* filename);
+	void findAnimationClips(int animStackIndex, hkArray<AnimationClip>& clipsOut);
+	void createClipScenes(int animStackIndex, const hkArray<AnimationClip>& clips);
+
+	// Remove the FBX nodes that the node filters, m_visibleOnly and m_selectedOnly exclude
+	void filterNodes();
+	bool filterNodeRecursive(FbxNode* fbxNode, bool included, const hkPointerMap<FbxNode*, FbxDisplayLayer*>& displayLayers, int& numExcludedOut);
+	bool matchesNodeFilter(FbxNode* fbxNode, const Options::NodeFilter& filter, FbxDisplayLayer* displayLayer) const;
+	bool isNodeRemoved(FbxNode* fbxNode) const;
+
+	// Find the FBX nodes that are collapsed into their children or removed when m_optimizeHierarchy is set
+	void optimizeHierarchy();
+	bool optimizeNodeRecursive(FbxNode* fbxNode, const hkPointerMap<FbxNode*, int>& skinLinks, int& numCollapsedOut, int& numRemovedOut);
+	bool isNodeProtected(const char* nodeName) const;
+	bool isNodeAnimated(FbxNode* fbxNode) const;
+	void findSkinLinks(hkPointerMap<FbxNode*, int>& skinLinksOut) const;
+
+	// Find the FBX nodes that are only converted for the rig when m_skeletonOnlyAnimations is set
+	void markRigOnlyNodes();
+	bool markRigOnlyNodesRecursive(FbxNode* fbxNode, const hkPointerMap<FbxNode*, int>& skinLinks, int& numRigOnlyOut);
+
+	// Local transform of a node relative to its converted parent, with the transforms of collapsed nodes in between
+	FbxAMatrix evaluateLocalTransform(FbxNode* fbxNode, FbxTime time);
+
+	// Change of basis from the axis system and unit of the file to the target ones. It is applied to the transforms,
+	// positions and directions as they are read, so the FBX scene itself is never converted.
+	void setupAxisConversion();
+	FbxAMatrix convertTransform(const FbxAMatrix& transform) const;
+	FbxVector4 convertPosition(const FbxVector4& position) const;
+	FbxVector4 convertDirection(const FbxVector4& direction) const;
+
 	void addNodesRecursive(hkxScene *scene, FbxNode* fbxNode, hkxNode* node, int animStackIndex);	
 	void addMesh(hkxScene *scene, FbxNode* meshNode, hkxNode* node);
 	void addCamera(hkxScene *scene, FbxNode* cameraNode, hkxNode* node);
 	void addLight(hkxScene *scene, FbxNode* lightNode, hkxNode* node);
 	void addSpline(hkxScene *scene, FbxNode* splineNode, hkxNode* node);
-	hkxMaterial* createMaterial(hkxScene *scene, FbxMesh* pMesh);
+	// Queue the texture for baking with the usage of the given stage, and bake all queued textures on the worker threads
+	void queueTextureBake(hkxTextureFile* texture, hkxMaterial::TextureType textureType);
+	void bakeTextures();
+	static void HK_CALL bakeTextureJob(void* converter, int jobIndex);
+
+	// Get the material of the mesh, converting it only the first time it is used. Returns a new reference.
+	hkxMaterial* getMaterial(hkxScene *scene, FbxMesh* pMesh);
+	hkxMaterial* createMaterial(hkxScene *scene, FbxSurfaceMaterial* lMaterial, const FbxStringList& lUVSetNameList);
+
+	// Run the mesh section jobs queued by addMesh on the worker threads
+	void processMeshSectionJobs();
+	void addMeshInstanceData(MeshSectionJob& job, hkxNode* instanceNode);
+
+	// Let sections of the current scene with identical geometry share their vertex and index buffers
+	void shareIdenticalMeshBuffers();
+	static void HK_CALL processMeshSectionJob(void* converter, int jobIndex);
+
+	// Generate normals from smoothing groups and tangents for the given UV set
+	static void generateNormals(hkxMeshSection* section, const hkArray<int>& vertexControlPoints, const hkArray<int>& triangleSmoothingGroups);
+	static void generateTangents(hkxMeshSection* section, int uvSet);
+
+	// Weld, remove degenerate triangles and reorder a section for the vertex cache, overdraw and vertex fetch.
+	// Vertices with different vertexKeys are never welded. outputToInputOut receives the original index of each vertex.
+	void optimizeMeshSection(hkxMeshSection* section, const char* meshName, const hkArray<int>* vertexKeys, hkArray<int>& outputToInputOut, hkStringBuf& logOut);
+
+	// Create a simplified copy of the section with about ratio times its triangles
+	static hkxMeshSection* createLodSection(hkxMeshSection* section, hkReal ratio, const char* lodName, hkReal& errorOut, hkStringBuf& logOut);
+
+	// Store the blend shape targets of the job as sparse vertex animations of the section, see the README for the layout
+	void createBlendShapeAnimations(hkxMeshSection* section, const MeshSectionJob& job, const hkArray<int>& outputToInput, hkStringBuf& logOut);
+	void addBlendShapeWeights(hkxScene *scene, FbxNode* meshNode, hkxNode* node, int animStackIndex);
+
+	// Convert the float streams of a section to the compact formats selected in the options. The dequantization
+	// ranges are stored in an attribute group on the node.
+	void compactMeshSection(hkxMeshSection* section, hkxNode* node, const char* meshName, hkStringBuf& logOut);
 
 	void extractKeyFramesAndAnnotations(hkxScene *scene, FbxNode* fbxChildNode, hkxNode* newChildNode, int animStackIndex);
 
@@ -151,8 +481,93 @@ private:
 	FbxTime m_startTime;
 	FbxNode *m_rootNode;
 
+	// Time span the nodes and attributes of the current scene are sampled over, and the time between two samples
+	FbxTimeSpan m_sampleTimeSpan;
+	FbxTime m_sampleTimeStep;
+
+	// Sampled keys of the animated nodes of the current scene
+	FbxToHkxKeyFrameStore m_keyFrameStore;
+
+	// Set while the rig scene is converted
+	bool m_rigPass;
+
+	// Last progress reported to the observer
+	Progress m_progress;
+
+	// Rotation (or reflection) between the axis systems, the same with the unit scale applied and its inverse. The
+	// triangles are flipped if the handedness changes.
+	FbxAMatrix m_axisRotation;
+	FbxAMatrix m_axisConversion;
+	FbxAMatrix m_axisConversionInverse;
+	hkReal m_unitScale;
+	bool m_flipWinding;
+
+	// Writer and output of the scenes between startSaving and finishSaving, and the number of scenes queued so far
+	FbxToHkxSceneWriter* m_sceneWriter;
+	hkStringPtr m_savePath;
+	hkStringPtr m_saveName;
+	int m_numQueuedScenes;
+
+	// Skeleton of the rig scene, shared by the rig and animation files that m_sceneWriter saves
+	hkaSkeleton* m_skeleton;
+
+	enum NodeOptimization
+	{
+		NODE_KEEP,
+		NODE_COLLAPSE,
+		NODE_REMOVE,
+		NODE_RIG_ONLY
+	};
+
+	// NodeOptimization of each FBX node that is not converted as it is, from the node filters and the hierarchy
+	// optimization. The descendants of removed nodes are removed as well.
+	hkPointerMap<FbxNode*, int> m_nodeOptimizations;
+
+	// Clips loaded from the sidecar file
+	hkArray<AnimationClip> m_clips;
+
+	// Mesh sections of the current scene that still have to be processed
+	hkArray<MeshSectionJob*> m_meshSectionJobs;
+
+	// The job of the first node that referenced each FBX mesh in the current scene
+	hkPointerMap<FbxMesh*, MeshSectionJob*> m_meshInstances;
+
 	// A cache of converted FBX -> Havok textures
 	hkPointerMap<FbxTexture*, hkRefVariant*> m_convertedTextures;
+
+	struct ConvertedMaterial
+	{
+		hkRefPtr<hkxMaterial> m_material;
+		// UV set names of the meshes the material was converted for
+		hkStringPtr m_uvSetNames;
+		// Last scene the material was added to
+		hkxScene* m_scene;
+		// Next conversion of the same FBX material for different UV sets
+		int m_next;
+	};
+
+	// A cache of converted FBX -> Havok materials, m_materialCacheHeads holds the latest conversion of each FBX material
+	hkArray<ConvertedMaterial> m_materialCache;
+	hkPointerMap<FbxSurfaceMaterial*, int> m_materialCacheHeads;
+	int m_defaultMaterialIndex;
+	int m_numReusedMaterials;
+
+	// One job per source image and usage, shared by all textures that reference it
+	struct TextureBakeJob
+	{
+		HK_DECLARE_NONVIRTUAL_CLASS_ALLOCATOR(HK_MEMORY_CLASS_SCENE_DATA, TextureBakeJob);
+
+		hkStringPtr m_sourceFilename;
+		FbxToHkxTextureBaker::Usage m_usage;
+		hkArray< hkRefPtr<hkxTextureFile> > m_textures;
+
+		FbxToHkxTextureBaker::Result m_result;
+		hkStringPtr m_bakedFilename;
+		hkStringPtr m_description;
+	};
+
+	hkArray<TextureBakeJob*> m_textureBakeJobs;
+	hkPointerMap<hkxTextureFile*, int> m_queuedTextures;
 };
 
 #endif
@@ -76,11 +76,12 @@ void FbxToHkxConverter::addSampledNodeAttributeGroups(hkxScene *scene, int animS
 		hkxMesh* mesh = HK_NULL;
 		const hkClass* classType = ((hkxNode*)hkx_attributeHolder)->m_object.getClass();
 
-		if(classType->equals(&hkxMeshClass))
+		// Nodes whose mesh isn't converted have no material
+		if(classType && classType->equals(&hkxMeshClass))
 		{
 			mesh = (hkxMesh*) ((hkxNode*)hkx_attributeHolder)->m_object.val();
 		}
-		else if(classType->equals(&hkxSkinBindingClass))
+		else if(classType && classType->equals(&hkxSkinBindingClass))
 		{
 			hkxSkinBinding* skinBinding = (hkxSkinBinding*) ((hkxNode*)hkx_attributeHolder)->m_object.val();
 			mesh = skinBinding->m_mesh;
@@ -97,6 +98,42 @@ void FbxToHkxConverter::addSampledNodeAttributeGroups(hkxScene *scene, int animS
 	}
 }
 
+// Sample the blend shape channel weights (in percent) into an attribute group with one attribute per channel
+void FbxToHkxConverter::addBlendShapeWeights(hkxScene *scene, FbxNode* meshNode, hkxNode* node, int animStackIndex)
+{
+	FbxMesh* mesh = meshNode->GetMesh();
+	const int numBlendShapes = mesh->GetDeformerCount(FbxDeformer::eBlendShape);
+	if (numBlendShapes == 0)
+	{
+		return;
+	}
+
+	hkxAttributeGroup* weightGroup = node->m_attributeGroups.expandBy(1);
+	weightGroup->m_name = "hkBlendShapes";
+
+	for (int d = 0; d < numBlendShapes; d++)
+	{
+		FbxBlendShape* blendShape = (FbxBlendShape*) mesh->GetDeformer(d, FbxDeformer::eBlendShape);
+		for (int c = 0; c < blendShape->GetBlendShapeChannelCount(); c++)
+		{
+			FbxBlendShapeChannel* channel = blendShape->GetBlendShapeChannel(c);
+			hkxAttribute& hkxAttr = weightGroup->m_attributes.expandOne();
+
+			// Without an animation stack there is nothing to sample
+			if (animStackIndex < 0 || !createAndSampleAttribute(scene, animStackIndex, channel->DeformPercent, hkxAttr))
+			{
+				hkxAnimatedFloat* weight = new hkxAnimatedFloat();
+				weight->m_hint = hkxAttribute::HINT_NONE;
+				weight->m_floats.pushBack((hkFloat32) channel->DeformPercent.Get());
+				hkxAttr.m_value = weight;
+				weight->removeReference();
+			}
+
+			hkxAttr.m_name = channel->GetName();
+		}
+	}
+}
+
 bool FbxToHkxConverter::createAndSampleAttribute(hkxScene *scene, int animStackIndex, FbxProperty& prop, hkxAttribute& hkx_attribute)
 {
 	hkx_attribute.m_name = HK_NULL;
@@ -123,12 +160,12 @@ bool FbxToHkxConverter::createAndSampleAttribute(hkxScene *scene, int animStackI
 	FbxDataType type = prop.GetPropertyDataType();
 	EFbxType dataType = type.GetType();
 
-	FbxTimeSpan animTimeSpan = lAnimStack->GetLocalTimeSpan();
-	FbxTime timePerFrame; timePerFrame.SetTime(0, 0, 0, 1, 0, m_curFbxScene->GetGlobalSettings().GetTimeMode());
+	FbxTimeSpan animTimeSpan = m_sampleTimeSpan;
+	const FbxTime timePerSample = m_sampleTimeStep;
 
-	// Since the end time is assumed to be inclusive, sample up to one frame beyond it
+	// Since the end time is assumed to be inclusive, the per frame values are sampled up to and including it
 	const FbxTime startTime = animTimeSpan.GetStart();
-	const FbxTime endTime = animTimeSpan.GetStop();
+	const FbxTime endTime = startTime + timePerSample * (int) scene->m_numFrames;
 
 	union
 	{
@@ -150,7 +187,7 @@ bool FbxToHkxConverter::createAndSampleAttribute(hkxScene *scene, int animStackI
 				int currentKeyIndex = 0;
 
 				// Sample this attribute for each frame
-				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerFrame)
+				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerSample)
 				{
 					const bool currentValue = (bool) lFirstAnimCurve->Evaluate(time, &currentKeyIndex);
 					const bool priorValue = (bool) lFirstAnimCurve->Evaluate(priorSampleTime);
@@ -205,7 +242,7 @@ handleInts:
 			{
 				int currentKeyIndex = 0;
 				// Sample this attribute for each frame
-				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerFrame)
+				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerSample)
 				{
 					const int currentValue = (int) lFirstAnimCurve->Evaluate(time, &currentKeyIndex);
 					const int priorValue = (int) lFirstAnimCurve->Evaluate(priorSampleTime);
@@ -228,7 +265,7 @@ handleInts:
 		}
 	case eFbxDistance:
 		dataTypeHint = hkxAttribute::HINT_SCALE;
-		dataStorage.m_f = (hkFloat32) prop.Get<FbxDistance>().valueAs(m_curFbxScene->GetGlobalSettings().GetSystemUnit());
+		dataStorage.m_f = (hkFloat32) (prop.Get<FbxDistance>().valueAs(m_curFbxScene->GetGlobalSettings().GetSystemUnit()) * m_unitScale);
 		goto handleFloats;
 	case eFbxHalfFloat:
 		dataStorage.m_f = (hkFloat32) prop.Get<FbxHalfFloat>().value();
@@ -250,7 +287,7 @@ handleFloats:
 				int currentKeyIndex = 0;
 				hkUint32 numFrames = 0;
 				// Sample this attribute for each frame
-				for(FbxTime time = startTime; time < endTime; time += timePerFrame, ++numFrames)
+				for(FbxTime time = startTime; time <= endTime; time += timePerSample, ++numFrames)
 				{
 					animatedData->m_floats[numFrames] = (hkFloat32) lFirstAnimCurve->Evaluate(time, &currentKeyIndex);
 				}
@@ -306,7 +343,7 @@ handleVectors:
 				hkUint32 numFrames = 0;
 				int storedFloatIndex = 0;
 				// Sample this attribute for each frame
-				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerFrame, ++numFrames)
+				for(FbxTime time = startTime, priorSampleTime = endTime; time <= endTime; priorSampleTime = time, time += timePerSample, ++numFrames)
 				{
 					for(int a = 0; a < 4; ++a, ++storedFloatIndex)
 					{
@@ -361,7 +398,7 @@ handleVectors:
 
 				hkUint32 numFrames = 0;
 				// Sample this attribute for each frame
-				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerFrame, ++numFrames)
+				for(FbxTime time = startTime, priorSampleTime = endTime; time <= endTime; priorSampleTime = time, time += timePerSample, ++numFrames)
 				{
 					FbxMatrix fbxMatrix;
 					for(int a = 0; a < numAnimCurves; ++a)
@@ -405,7 +442,7 @@ handleVectors:
 			if(numKeys > 1)
 			{
 				int currentKeyIndex;
-				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerFrame)
+				for(FbxTime time = startTime, priorSampleTime = endTime; time < endTime; priorSampleTime = time, time += timePerSample)
 				{
 					const int currentValue = (int) lFirstAnimCurve->Evaluate(time, &currentKeyIndex);
 					const int priorValue = (int) lFirstAnimCurve->Evaluate(priorSampleTime);
@@ -0,0 +1,513 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxConverter.h"
+
+#include <Common/SceneData/Graph/hkxNode.h>
+#include <Common/Base/Reflection/hkClass.h>
+#include <Common/Base/System/Io/IStream/hkIStream.h>
+
+// Frames of the sampled scene that make up a clip
+struct ClipRange
+{
+	// First frame of the clip and number of frames sampled, relative to the start of the sampled scene
+	int m_firstFrame;
+	int m_numFrames;
+	int m_numSampledFrames;
+
+	// Start and end of the clip in seconds relative to the start of the sampled scene, and half a frame
+	hkReal m_startTime;
+	hkReal m_endTime;
+	hkReal m_timeTolerance;
+};
+
+bool FbxToHkxConverter::isAnimStackSelected(const char* animStackName) const
+{
+	if (m_options.m_animStackNames.getSize() == 0)
+	{
+		return true;
+	}
+
+	for (int i = 0; i < m_options.m_animStackNames.getSize(); i++)
+	{
+		if (hkString::strCmp(m_options.m_animStackNames[i], animStackName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+// Each line of the sidecar file defines a clip as "name startFrame endFrame [animStack]", # starts a comment
+bool FbxToHkxConverter::loadAnimationClips(const char* filename)
+{
+	m_clips.clear();
+
+	hkIstream stream(filename);
+	if (!stream.isOk())
+	{
+		printf("Cannot open clip file: %s\n", filename);
+		return false;
+	}
+
+	char line[512];
+	for (int lineNumber = 1; stream.isOk(); lineNumber++)
+	{
+		if (stream.getline(line, sizeof(line)) < 0)
+		{
+			break;
+		}
+
+		// Split the line into whitespace separated tokens
+		const char* tokens[5];
+		int numTokens = 0;
+		for (char* c = line; *c && *c != '#' && numTokens < 5; )
+		{
+			if (*c == ' ' || *c == '\t' || *c == '\r' || *c == '\n')
+			{
+				*c++ = '\0';
+				continue;
+			}
+
+			tokens[numTokens++] = c;
+			while (*c && *c != ' ' && *c != '\t' && *c != '\r' && *c != '\n' && *c != '#')
+			{
+				c++;
+			}
+			if (*c == '#')
+			{
+				*c = '\0';
+				break;
+			}
+		}
+
+		if (numTokens == 0)
+		{
+			continue;
+		}
+
+		if (numTokens < 3 || numTokens > 4)
+		{
+			printf("Invalid clip definition in %s, line %d\n", filename, lineNumber);
+			return false;
+		}
+
+		AnimationClip& clip = m_clips.expandOne();
+		clip.m_name = tokens[0];
+		clip.m_startFrame = hkString::atoi(tokens[1]);
+		clip.m_endFrame = hkString::atoi(tokens[2]);
+		clip.m_animStackName = (numTokens > 3) ? tokens[3] : HK_NULL;
+
+		if (clip.m_endFrame <= clip.m_startFrame)
+		{
+			printf("Clip %s in %s, line %d ends before it starts\n", tokens[0], filename, lineNumber);
+			return false;
+		}
+	}
+
+	printf("Clips: %d loaded from %s\n", m_clips.getSize(), filename);
+	return true;
+}
+
+// Find the first enum property named HKClip in the hierarchy
+static FbxProperty findClipMarkers(FbxNode* fbxNode)
+{
+	FbxProperty prop = fbxNode->FindProperty("HKClip", false);
+	if (prop.IsValid() && prop.GetPropertyDataType().GetType() == eFbxEnum)
+	{
+		return prop;
+	}
+
+	for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); childIndex++)
+	{
+		prop = findClipMarkers(fbxNode->GetChild(childIndex));
+		if (prop.IsValid())
+		{
+			return prop;
+		}
+	}
+	return FbxProperty();
+}
+
+void FbxToHkxConverter::findAnimationClips(int animStackIndex, hkArray<AnimationClip>& clipsOut)
+{
+	FbxAnimStack* lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex);
+
+	if (m_options.m_clipFile)
+	{
+		for (int i = 0; i < m_clips.getSize(); i++)
+		{
+			const AnimationClip& clip = m_clips[i];
+			if (!clip.m_animStackName || hkString::strCmp(clip.m_animStackName, lAnimStack->GetName()) == 0)
+			{
+				clipsOut.pushBack(clip);
+			}
+		}
+	}
+	else if (lAnimStack->GetMemberCount<FbxAnimLayer>() > 0)
+	{
+		// Every key of an HKClip enum starts the clip named by its value and ends the previous one. A key with
+		// the value None only ends the previous clip.
+		FbxProperty markers = findClipMarkers(m_rootNode);
+		FbxAnimCurve* lAnimCurve = markers.IsValid() ? markers.GetCurve(lAnimStack->GetMember<FbxAnimLayer>(0)) : HK_NULL;
+		if (!lAnimCurve)
+		{
+			return;
+		}
+
+		const FbxTime::EMode timeMode = m_curFbxScene->GetGlobalSettings().GetTimeMode();
+		AnimationClip* openClip = HK_NULL;
+		for (int keyIndex = 0; keyIndex < lAnimCurve->KeyGetCount(); keyIndex++)
+		{
+			const int frame = static_cast<int>( lAnimCurve->KeyGetTime(keyIndex).GetFrameCount(timeMode) );
+			if (openClip)
+			{
+				openClip->m_endFrame = frame;
+				openClip = HK_NULL;
+			}
+
+			const int enumValueIndex = (int) lAnimCurve->KeyGetValue(keyIndex);
+			const char* clipName = (enumValueIndex >= 0 && enumValueIndex < markers.GetEnumCount()) ? markers.GetEnumValue(enumValueIndex) : HK_NULL;
+			if (clipName && clipName[0] && hkString::strCasecmp(clipName, "None") != 0)
+			{
+				openClip = clipsOut.expandBy(1);
+				openClip->m_name = clipName;
+				openClip->m_animStackName = HK_NULL;
+				openClip->m_startFrame = frame;
+			}
+		}
+
+		if (openClip)
+		{
+			openClip->m_endFrame = static_cast<int>( lAnimStack->GetLocalTimeSpan().GetStop().GetFrameCount(timeMode) );
+		}
+	}
+
+	// Clips that apply to every stack are named after their stack as well so their files don't collide
+	if (m_numAnimStacks > 1)
+	{
+		for (int i = 0; i < clipsOut.getSize(); i++)
+		{
+			if (!clipsOut[i].m_animStackName)
+			{
+				hkStringBuf name = lAnimStack->GetName();
+				name += "_";
+				name += clipsOut[i].m_name;
+				clipsOut[i].m_name = name.cString();
+			}
+		}
+	}
+}
+
+static void sliceKeyFrames(const hkxNode* node, const FbxToHkxKeyFrameStore& keyFrameStore, const ClipRange& range, hkArray<hkMatrix4>& keyFramesOut)
+{
+	// Static nodes only have one or two keys for the whole sampled range, the keys of the others are in the store
+	const FbxToHkxKeyFrameStore::Track* track = keyFrameStore.findTrack(node);
+	if (!track)
+	{
+		HK_ASSERT(0x0, node->m_keyFrames.getSize() > 0);
+		keyFramesOut.setSize(range.m_numFrames > 1 ? 2 : 1, node->m_keyFrames[0]);
+		return;
+	}
+
+	HK_ASSERT(0x0, track->getNumKeys() == range.m_numSampledFrames);
+
+	bool staticNode = true;
+	for (int i = 1; staticNode && i < range.m_numFrames; i++)
+	{
+		staticNode = track->isKeyEqual(range.m_firstFrame + i, range.m_firstFrame);
+	}
+
+	// Nodes that don't move during the clip are stored like static nodes
+	keyFramesOut.setSize(staticNode ? (range.m_numFrames > 1 ? 2 : 1) : range.m_numFrames);
+	for (int i = 0; i < keyFramesOut.getSize(); i++)
+	{
+		track->getKey(range.m_firstFrame + (staticNode ? 0 : i), keyFramesOut[i]);
+	}
+}
+
+// Slice the values of an attribute that is sampled once per frame, with stride values per frame
+template <typename T>
+static void sliceSampledValues(const hkArray<T>& values, int stride, const ClipRange& range, hkArray<T>& valuesOut)
+{
+	const int numKeys = values.getSize() / stride;
+	if (numKeys <= 1)
+	{
+		valuesOut = values;
+		return;
+	}
+
+	// Attributes are sampled up to and including the end of the range
+	const int firstKey = hkMath::min2(range.m_firstFrame, numKeys - 1);
+	const int numClipKeys = hkMath::min2(range.m_numFrames + 1, numKeys - firstKey);
+	valuesOut.append(&values[firstKey * stride], numClipKeys * stride);
+}
+
+// Slice the keys of a sparsely animated attribute, starting with the value that is active at the start of the clip
+template <typename T>
+static void sliceSparseValues(const hkArray<T>& values, const hkArray<hkReal>& times, const ClipRange& range, hkArray<T>& valuesOut, hkArray<hkReal>& timesOut)
+{
+	int firstKey = 0;
+	while (firstKey + 1 < times.getSize() && times[firstKey + 1] <= range.m_startTime + range.m_timeTolerance)
+	{
+		firstKey++;
+	}
+
+	for (int i = firstKey; i < times.getSize() && (i == firstKey || times[i] < range.m_endTime - range.m_timeTolerance); i++)
+	{
+		valuesOut.pushBack(values[i]);
+		timesOut.pushBack(hkMath::max2(times[i] - range.m_startTime, 0.0f));
+	}
+}
+
+// Create the attribute value of the clip. Returns a new reference.
+static hkReferencedObject* sliceAttribute(hkReferencedObject* value, const ClipRange& range)
+{
+	const hkClass* classType = value->getClassType();
+
+	if (classType->equals(&hkxAnimatedFloatClass))
+	{
+		const hkxAnimatedFloat* animatedData = (const hkxAnimatedFloat*) value;
+		hkxAnimatedFloat* clipData = new hkxAnimatedFloat();
+		clipData->m_hint = animatedData->m_hint;
+		sliceSampledValues(animatedData->m_floats, 1, range, clipData->m_floats);
+		return clipData;
+	}
+	else if (classType->equals(&hkxAnimatedVectorClass))
+	{
+		const hkxAnimatedVector* animatedData = (const hkxAnimatedVector*) value;
+		hkxAnimatedVector* clipData = new hkxAnimatedVector();
+		clipData->m_hint = animatedData->m_hint;
+		sliceSampledValues(animatedData->m_vectors, 4, range, clipData->m_vectors);
+		return clipData;
+	}
+	else if (classType->equals(&hkxAnimatedMatrixClass))
+	{
+		const hkxAnimatedMatrix* animatedData = (const hkxAnimatedMatrix*) value;
+		hkxAnimatedMatrix* clipData = new hkxAnimatedMatrix();
+		clipData->m_hint = animatedData->m_hint;
+		sliceSampledValues(animatedData->m_matrices, 16, range, clipData->m_matrices);
+		return clipData;
+	}
+	else if (classType->equals(&hkxSparselyAnimatedBoolClass))
+	{
+		const hkxSparselyAnimatedBool* animatedData = (const hkxSparselyAnimatedBool*) value;
+		hkxSparselyAnimatedBool* clipData = new hkxSparselyAnimatedBool();
+		sliceSparseValues(animatedData->m_bools, animatedData->m_times, range, clipData->m_bools, clipData->m_times);
+		return clipData;
+	}
+	else if (classType->equals(&hkxSparselyAnimatedEnumClass))
+	{
+		const hkxSparselyAnimatedEnum* animatedData = (const hkxSparselyAnimatedEnum*) value;
+		hkxSparselyAnimatedEnum* clipData = new hkxSparselyAnimatedEnum();
+		clipData->m_enum = animatedData->m_enum;
+		sliceSparseValues(animatedData->m_ints, animatedData->m_times, range, clipData->m_ints, clipData->m_times);
+		return clipData;
+	}
+	else if (classType->equals(&hkxSparselyAnimatedIntClass))
+	{
+		const hkxSparselyAnimatedInt* animatedData = (const hkxSparselyAnimatedInt*) value;
+		hkxSparselyAnimatedInt* clipData = new hkxSparselyAnimatedInt();
+		sliceSparseValues(animatedData->m_ints, animatedData->m_times, range, clipData->m_ints, clipData->m_times);
+		return clipData;
+	}
+	else if (classType->equals(&hkxSparselyAnimatedStringClass))
+	{
+		const hkxSparselyAnimatedString* animatedData = (const hkxSparselyAnimatedString*) value;
+		hkxSparselyAnimatedString* clipData = new hkxSparselyAnimatedString();
+		sliceSparseValues(animatedData->m_strings, animatedData->m_times, range, clipData->m_strings, clipData->m_times);
+		return clipData;
+	}
+
+	// Everything else isn't animated
+	value->addReference();
+	return value;
+}
+
+// Create a copy of the node and its descendants with the keys, annotations and attributes of the clip. The objects
+// attached to the nodes are shared with the sampled scene. Returns a new reference.
+static hkxNode* createClipNode(const hkxNode* node, const FbxToHkxKeyFrameStore& keyFrameStore, const ClipRange& range)
+{
+	hkxNode* clipNode = new hkxNode();
+	clipNode->m_name = node->m_name;
+	clipNode->m_object = node->m_object;
+	clipNode->m_selected = node->m_selected;
+	clipNode->m_bone = node->m_bone;
+	clipNode->m_userProperties = node->m_userProperties;
+
+	sliceKeyFrames(node, keyFrameStore, range, clipNode->m_keyFrames);
+
+	for (int i = 0; i < node->m_annotations.getSize(); i++)
+	{
+		const hkxNode::AnnotationData& annotation = node->m_annotations[i];
+		if (annotation.m_time >= range.m_startTime - range.m_timeTolerance && annotation.m_time < range.m_endTime - range.m_timeTolerance)
+		{
+			hkxNode::AnnotationData& clipAnnotation = clipNode->m_annotations.expandOne();
+			clipAnnotation.m_time = hkMath::max2(annotation.m_time - range.m_startTime, 0.0f);
+			clipAnnotation.m_description = annotation.m_description;
+		}
+	}
+
+	// Key times outside of the clip affect its start and end, as in extractKeyTimes
+	if (clipNode->m_keyFrames.getSize() > 2)
+	{
+		const hkReal clipLength = range.m_endTime - range.m_startTime;
+		for (int i = 0; i < node->m_linearKeyFrameHints.getSize(); i++)
+		{
+			const hkReal keyTime = hkMath::clamp(node->m_linearKeyFrameHints[i] - range.m_startTime, 0.0f, clipLength);
+			if (clipNode->m_linearKeyFrameHints.indexOf(keyTime) < 0)
+			{
+				clipNode->m_linearKeyFrameHints.pushBack(keyTime);
+			}
+		}
+	}
+
+	for (int g = 0; g < node->m_attributeGroups.getSize(); g++)
+	{
+		const hkxAttributeGroup& group = node->m_attributeGroups[g];
+		hkxAttributeGroup& clipGroup = clipNode->m_attributeGroups.expandOne();
+		clipGroup.m_name = group.m_name;
+		clipGroup.m_attributes.setSize(group.m_attributes.getSize());
+
+		for (int a = 0; a < group.m_attributes.getSize(); a++)
+		{
+			hkReferencedObject* clipValue = sliceAttribute(group.m_attributes[a].m_value, range);
+			clipGroup.m_attributes[a].m_name = group.m_attributes[a].m_name;
+			clipGroup.m_attributes[a].m_value = clipValue;
+			clipValue->removeReference();
+		}
+	}
+
+	for (int c = 0; c < node->m_children.getSize(); c++)
+	{
+		hkxNode* clipChild = createClipNode(node->m_children[c], keyFrameStore, range);
+		clipNode->m_children.pushBack(clipChild);
+		clipChild->removeReference();
+	}
+
+	return clipNode;
+}
+
+void FbxToHkxConverter::createClipScenes(int animStackIndex, const hkArray<AnimationClip>& clips)
+{
+	FbxAnimStack* lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex);
+	const FbxTime::EMode timeMode = m_curFbxScene->GetGlobalSettings().GetTimeMode();
+	const FbxTime timePerSample = getSampleTimeStep(lAnimStack->GetName());
+	const hkReal secondsPerSample = static_cast<hkReal>( timePerSample.GetSecondDouble() );
+
+	const FbxTimeSpan stackTimeSpan = lAnimStack->GetLocalTimeSpan();
+	const int stackStartFrame = static_cast<int>( stackTimeSpan.GetStart().GetFrameCount(timeMode) );
+	const int stackEndFrame = static_cast<int>( stackTimeSpan.GetStop().GetFrameCount(timeMode) );
+
+	// Clamp the clips to the stack and find the range that covers all of them
+	hkArray<AnimationClip> validClips;
+	int firstFrame = stackEndFrame;
+	int endFrame = stackStartFrame;
+	for (int i = 0; i < clips.getSize(); i++)
+	{
+		AnimationClip clip = clips[i];
+		clip.m_startFrame = hkMath::max2(clip.m_startFrame, stackStartFrame);
+		clip.m_endFrame = hkMath::min2(clip.m_endFrame, stackEndFrame);
+
+		if (clip.m_endFrame <= clip.m_startFrame)
+		{
+			HK_WARN(0x0, "Clip " << clips[i].m_name << " is outside of animation stack " << lAnimStack->GetName() << " and is skipped.");
+			continue;
+		}
+
+		validClips.pushBack(clip);
+		firstFrame = hkMath::min2(firstFrame, clip.m_startFrame);
+		endFrame = hkMath::max2(endFrame, clip.m_endFrame);
+	}
+
+	if (validClips.getSize() == 0)
+	{
+		addScene(createSceneStack(animStackIndex, stackTimeSpan, true));
+		return;
+	}
+
+	FbxTime startTime; startTime.SetFrame(firstFrame, timeMode);
+	FbxTime stopTime; stopTime.SetFrame(endFrame, timeMode);
+	// The keys of the animated nodes stay in the store and are sliced from there
+	hkxScene* sampledScene = createSceneStack(animStackIndex, FbxTimeSpan(startTime, stopTime), false);
+	if (isCancelled())
+	{
+		// The tracks can be shorter than the sampled scene
+		m_keyFrameStore.clear();
+		sampledScene->removeReference();
+		return;
+	}
+
+	const int numSampledFrames = static_cast<int>( sampledScene->m_numFrames );
+	int numClipFrames = 0;
+
+	for (int i = 0; i < validClips.getSize(); i++)
+	{
+		const AnimationClip& clip = validClips[i];
+
+		// Clips start at the nearest sample and cover the whole samples that fit into them
+		FbxTime clipStartTime; clipStartTime.SetFrame(clip.m_startFrame, timeMode);
+		FbxTime clipStopTime; clipStopTime.SetFrame(clip.m_endFrame, timeMode);
+
+		ClipRange range;
+		range.m_numSampledFrames = numSampledFrames;
+		range.m_firstFrame = static_cast<int>( ((clipStartTime - startTime).Get() + timePerSample.Get() / 2) / timePerSample.Get() );
+		range.m_firstFrame = hkMath::min2(range.m_firstFrame, numSampledFrames - 1);
+		range.m_numFrames = static_cast<int>( (clipStopTime - clipStartTime).Get() / timePerSample.Get() );
+		range.m_numFrames = hkMath::clamp(range.m_numFrames, 1, numSampledFrames - range.m_firstFrame);
+		range.m_startTime = range.m_firstFrame * secondsPerSample;
+		range.m_endTime = (range.m_firstFrame + range.m_numFrames) * secondsPerSample;
+		range.m_timeTolerance = 0.5f * secondsPerSample;
+		numClipFrames += range.m_numFrames;
+
+		hkxScene* clipScene = new hkxScene;
+		clipScene->m_modeller = sampledScene->m_modeller;
+		clipScene->m_asset = sampledScene->m_asset;
+		clipScene->m_numFrames = range.m_numFrames;
+		clipScene->m_sceneLength = range.m_numFrames * secondsPerSample;
+
+		// The clips share the objects of the sampled scene
+		clipScene->m_cameras = sampledScene->m_cameras;
+		clipScene->m_lights = sampledScene->m_lights;
+		clipScene->m_meshes = sampledScene->m_meshes;
+		clipScene->m_materials = sampledScene->m_materials;
+		clipScene->m_inplaceTextures = sampledScene->m_inplaceTextures;
+		clipScene->m_externalTextures = sampledScene->m_externalTextures;
+		clipScene->m_skinBindings = sampledScene->m_skinBindings;
+		clipScene->m_splines = sampledScene->m_splines;
+
+		hkxNode* rootNode = createClipNode(sampledScene->m_rootNode, m_keyFrameStore, range);
+		rootNode->m_name = clip.m_name;
+		clipScene->m_rootNode = rootNode;
+		rootNode->removeReference();
+
+		printf("Clip [%s]: frames %d to %d of [%s]\n", clip.m_name.cString(), clip.m_startFrame, clip.m_endFrame, lAnimStack->GetName());
+
+		addScene(clipScene);
+	}
+
+	printf("Sampled %d frames of [%s] once for %d clips with %d frames\n", numSampledFrames, lAnimStack->GetName(), validClips.getSize(), numClipFrames);
+
+	m_keyFrameStore.clear();
+	sampledScene->removeReference();
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,412 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxConverter.h"
+
+// Matches '*' against any number of characters and '?' against any single character
+static bool matchesPattern(const char* name, const char* pattern)
+{
+	for (; *pattern; pattern++, name++)
+	{
+		if (*pattern == '*')
+		{
+			for (const char* rest = name; ; rest++)
+			{
+				if (matchesPattern(rest, pattern + 1))
+				{
+					return true;
+				}
+				if (!*rest)
+				{
+					return false;
+				}
+			}
+		}
+
+		if (!*name || (*pattern != '?' && *pattern != *name))
+		{
+			return false;
+		}
+	}
+
+	return *name == 0;
+}
+
+// Properties that end up in the scene: attribute groups, annotations and clip markers ('hk' prefix) and Vision data
+static bool hasExportedProperties(FbxNode* fbxNode)
+{
+	for (FbxProperty prop = fbxNode->GetFirstProperty(); prop.IsValid(); prop = fbxNode->GetNextProperty(prop))
+	{
+		if (!hkString::strNcasecmp(prop.GetNameAsCStr(), "hk", 2))
+		{
+			return true;
+		}
+
+		if (prop.GetPropertyDataType().GetType() == eFbxString)
+		{
+			FbxString propertyData = prop.Get<FbxString>();
+			if (!hkString::strNcasecmp(propertyData.Buffer(), "vision", 6))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static const char* getAttributeTypeName(FbxNode* fbxNode)
+{
+	FbxNodeAttribute* fbxNodeAttrib = fbxNode->GetNodeAttribute();
+	if (!fbxNodeAttrib)
+	{
+		return "null";
+	}
+
+	switch (fbxNodeAttrib->GetAttributeType())
+	{
+	case FbxNodeAttribute::eNull:			return "null";
+	case FbxNodeAttribute::eMarker:			return "marker";
+	case FbxNodeAttribute::eSkeleton:		return "skeleton";
+	case FbxNodeAttribute::eMesh:			return "mesh";
+	case FbxNodeAttribute::eNurbs:			return "nurbs";
+	case FbxNodeAttribute::ePatch:			return "patch";
+	case FbxNodeAttribute::eCamera:			return "camera";
+	case FbxNodeAttribute::eLight:			return "light";
+	case FbxNodeAttribute::eNurbsCurve:		return "nurbscurve";
+	case FbxNodeAttribute::eNurbsSurface:	return "nurbssurface";
+	case FbxNodeAttribute::eLODGroup:		return "lodgroup";
+	case FbxNodeAttribute::eLine:			return "line";
+	default:								return "unknown";
+	}
+}
+
+static bool matchesAnyPattern(const char* name, const hkArray<hkStringPtr>& patterns)
+{
+	for (int i = 0; i < patterns.getSize(); i++)
+	{
+		if (matchesPattern(name, patterns[i]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool FbxToHkxConverter::matchesNodeFilter(FbxNode* fbxNode, const Options::NodeFilter& filter, FbxDisplayLayer* displayLayer) const
+{
+	return
+		matchesAnyPattern(fbxNode->GetName(), filter.m_nodeNames) ||
+		matchesAnyPattern(getAttributeTypeName(fbxNode), filter.m_attributeTypes) ||
+		(displayLayer && matchesAnyPattern(displayLayer->GetName(), filter.m_layerNames));
+}
+
+bool FbxToHkxConverter::isNodeRemoved(FbxNode* fbxNode) const
+{
+	for (; fbxNode; fbxNode = fbxNode->GetParent())
+	{
+		if (m_nodeOptimizations.getWithDefault(fbxNode, NODE_KEEP) == NODE_REMOVE)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+// Returns true if any descendant of fbxNode is converted
+bool FbxToHkxConverter::filterNodeRecursive(FbxNode* fbxNode, bool included, const hkPointerMap<FbxNode*, FbxDisplayLayer*>& displayLayers, int& numExcludedOut)
+{
+	bool anyChildConverted = false;
+
+	for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); childIndex++)
+	{
+		FbxNode* fbxChildNode = fbxNode->GetChild(childIndex);
+		FbxDisplayLayer* displayLayer = displayLayers.getWithDefault(fbxChildNode, HK_NULL);
+
+		// Hidden nodes, nodes on hidden layers and unselected nodes are skipped with their descendants
+		bool excluded =
+			(m_options.m_visibleOnly && (!fbxChildNode->GetVisibility() || (displayLayer && !displayLayer->Show.Get()))) ||
+			(m_options.m_selectedOnly && !fbxChildNode->GetSelected()) ||
+			matchesNodeFilter(fbxChildNode, m_options.m_excludeFilter, displayLayer);
+
+		if (!excluded)
+		{
+			const int numExcluded = numExcludedOut;
+			const bool childIncluded = included || matchesNodeFilter(fbxChildNode, m_options.m_includeFilter, displayLayer);
+
+			// Nodes outside of the included subtrees are only kept if they lead to one
+			excluded = !filterNodeRecursive(fbxChildNode, childIncluded, displayLayers, numExcludedOut) && !childIncluded;
+			if (excluded)
+			{
+				numExcludedOut = numExcluded;
+			}
+		}
+
+		if (excluded)
+		{
+			m_nodeOptimizations.insert(fbxChildNode, NODE_REMOVE);
+			numExcludedOut++;
+		}
+		else
+		{
+			anyChildConverted = true;
+		}
+	}
+
+	return anyChildConverted;
+}
+
+void FbxToHkxConverter::filterNodes()
+{
+	const Options::NodeFilter& includeFilter = m_options.m_includeFilter;
+	const bool includeAll =
+		includeFilter.m_nodeNames.isEmpty() &&
+		includeFilter.m_attributeTypes.isEmpty() &&
+		includeFilter.m_layerNames.isEmpty();
+
+	const Options::NodeFilter& excludeFilter = m_options.m_excludeFilter;
+	const bool excludeNone =
+		excludeFilter.m_nodeNames.isEmpty() &&
+		excludeFilter.m_attributeTypes.isEmpty() &&
+		excludeFilter.m_layerNames.isEmpty();
+
+	if (includeAll && excludeNone && !m_options.m_visibleOnly && !m_options.m_selectedOnly)
+	{
+		return;
+	}
+
+	// Display layer of each node
+	hkPointerMap<FbxNode*, FbxDisplayLayer*> displayLayers;
+	for (int layerIndex = 0; layerIndex < m_curFbxScene->GetSrcObjectCount<FbxDisplayLayer>(); layerIndex++)
+	{
+		FbxDisplayLayer* displayLayer = m_curFbxScene->GetSrcObject<FbxDisplayLayer>(layerIndex);
+		for (int memberIndex = 0; memberIndex < displayLayer->GetMemberCount<FbxNode>(); memberIndex++)
+		{
+			displayLayers.insert(displayLayer->GetMember<FbxNode>(memberIndex), displayLayer);
+		}
+	}
+
+	int numExcluded = 0;
+	filterNodeRecursive(m_rootNode, includeAll, displayLayers, numExcluded);
+
+	printf("Node filters: %d subtrees excluded\n", numExcluded);
+}
+
+bool FbxToHkxConverter::isNodeProtected(const char* nodeName) const
+{
+	for (int i = 0; i < m_options.m_protectedNodeNames.getSize(); i++)
+	{
+		if (matchesPattern(nodeName, m_options.m_protectedNodeNames[i]))
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool FbxToHkxConverter::isNodeAnimated(FbxNode* fbxNode) const
+{
+	for (int animStackIndex = 0; animStackIndex < m_numAnimStacks; animStackIndex++)
+	{
+		FbxAnimStack* lAnimStack = m_curFbxScene->GetSrcObject<FbxAnimStack>(animStackIndex);
+		for (int layerIndex = 0; layerIndex < lAnimStack->GetMemberCount<FbxAnimLayer>(); layerIndex++)
+		{
+			FbxAnimLayer* lAnimLayer = lAnimStack->GetMember<FbxAnimLayer>(layerIndex);
+			if (fbxNode->LclTranslation.GetCurveNode(lAnimLayer) ||
+				fbxNode->LclRotation.GetCurveNode(lAnimLayer) ||
+				fbxNode->LclScaling.GetCurveNode(lAnimLayer))
+			{
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+// Decide what happens to the descendants of fbxNode, children first. Returns true if all of its children are removed.
+bool FbxToHkxConverter::optimizeNodeRecursive(FbxNode* fbxNode, const hkPointerMap<FbxNode*, int>& skinLinks, int& numCollapsedOut, int& numRemovedOut)
+{
+	bool allChildrenRemoved = true;
+
+	for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); childIndex++)
+	{
+		FbxNode* fbxChildNode = fbxNode->GetChild(childIndex);
+		if (m_nodeOptimizations.getWithDefault(fbxChildNode, NODE_KEEP) == NODE_REMOVE)
+		{
+			continue;
+		}
+
+		const bool isLeaf = optimizeNodeRecursive(fbxChildNode, skinLinks, numCollapsedOut, numRemovedOut);
+
+		FbxNodeAttribute* fbxNodeAttrib = fbxChildNode->GetNodeAttribute();
+		const FbxNodeAttribute::EType attributeType = fbxNodeAttrib ? fbxNodeAttrib->GetAttributeType() : FbxNodeAttribute::eNull;
+
+		// Only group nulls, locators and bones are candidates, and only if nothing refers to them
+		const bool transformOnly = (attributeType == FbxNodeAttribute::eNull);
+		const bool bone = (attributeType == FbxNodeAttribute::eSkeleton);
+
+		if ((!transformOnly && !bone) ||
+			skinLinks.getWithDefault(fbxChildNode, 0) ||
+			isNodeProtected(fbxChildNode->GetName()) ||
+			hasExportedProperties(fbxChildNode))
+		{
+			allChildrenRemoved = false;
+		}
+		else if (isLeaf && !isNodeAnimated(fbxChildNode))
+		{
+			// Leaf bones without skin influence and helpers with nothing below them don't affect the scene
+			m_nodeOptimizations.insert(fbxChildNode, NODE_REMOVE);
+			numRemovedOut++;
+		}
+		else if (transformOnly && !isLeaf)
+		{
+			// Intermediate groups are baked into their children
+			m_nodeOptimizations.insert(fbxChildNode, NODE_COLLAPSE);
+			numCollapsedOut++;
+			allChildrenRemoved = false;
+		}
+		else
+		{
+			allChildrenRemoved = false;
+		}
+	}
+
+	return allChildrenRemoved;
+}
+
+void FbxToHkxConverter::findSkinLinks(hkPointerMap<FbxNode*, int>& skinLinksOut) const
+{
+	hkArray<FbxNode*> meshNodes;
+	findChildren(m_rootNode, meshNodes, FbxNodeAttribute::eMesh);
+	for (int meshIndex = 0; meshIndex < meshNodes.getSize(); meshIndex++)
+	{
+		if (isNodeRemoved(meshNodes[meshIndex]))
+		{
+			continue;
+		}
+
+		FbxMesh* fbxMesh = meshNodes[meshIndex]->GetMesh();
+		for (int skinIndex = 0; skinIndex < fbxMesh->GetDeformerCount(FbxDeformer::eSkin); skinIndex++)
+		{
+			FbxSkin* skin = (FbxSkin*) fbxMesh->GetDeformer(skinIndex, FbxDeformer::eSkin);
+			for (int clusterIndex = 0; clusterIndex < skin->GetClusterCount(); clusterIndex++)
+			{
+				FbxNode* link = skin->GetCluster(clusterIndex)->GetLink();
+				if (link)
+				{
+					skinLinksOut.insert(link, 1);
+				}
+			}
+		}
+	}
+}
+
+void FbxToHkxConverter::optimizeHierarchy()
+{
+	// Nodes that skins are bound to are needed for their bind pose
+	hkPointerMap<FbxNode*, int> skinLinks;
+	findSkinLinks(skinLinks);
+
+	int numCollapsed = 0;
+	int numRemoved = 0;
+	optimizeNodeRecursive(m_rootNode, skinLinks, numCollapsed, numRemoved);
+
+	printf("Hierarchy: %d nodes collapsed, %d nodes removed\n", numCollapsed, numRemoved);
+}
+
+// Returns true if any descendant of fbxNode is needed in the animation scenes
+bool FbxToHkxConverter::markRigOnlyNodesRecursive(FbxNode* fbxNode, const hkPointerMap<FbxNode*, int>& skinLinks, int& numRigOnlyOut)
+{
+	bool anyChildNeeded = false;
+
+	for (int childIndex = 0; childIndex < fbxNode->GetChildCount(); childIndex++)
+	{
+		FbxNode* fbxChildNode = fbxNode->GetChild(childIndex);
+		const int optimization = m_nodeOptimizations.getWithDefault(fbxChildNode, NODE_KEEP);
+		if (optimization == NODE_REMOVE)
+		{
+			continue;
+		}
+
+		const int numRigOnly = numRigOnlyOut;
+		bool needed = markRigOnlyNodesRecursive(fbxChildNode, skinLinks, numRigOnlyOut);
+
+		// Bones, the nodes that skins are bound to, and nodes with animation, attributes or blend shape weights
+		if (!needed)
+		{
+			FbxNodeAttribute* fbxNodeAttrib = fbxChildNode->GetNodeAttribute();
+			const FbxNodeAttribute::EType attributeType = fbxNodeAttrib ? fbxNodeAttrib->GetAttributeType() : FbxNodeAttribute::eNull;
+
+			needed =
+				attributeType == FbxNodeAttribute::eSkeleton ||
+				skinLinks.getWithDefault(fbxChildNode, 0) ||
+				isNodeAnimated(fbxChildNode) ||
+				hasExportedProperties(fbxChildNode) ||
+				(attributeType == FbxNodeAttribute::eMesh && m_options.m_exportVertexAnimations &&
+				 fbxChildNode->GetMesh()->GetDeformerCount(FbxDeformer::eBlendShape) > 0);
+		}
+
+		if (needed)
+		{
+			anyChildNeeded = true;
+		}
+		else if (optimization == NODE_KEEP)
+		{
+			// The whole subtree is skipped, which covers the nodes marked below
+			numRigOnlyOut = numRigOnly;
+			m_nodeOptimizations.insert(fbxChildNode, NODE_RIG_ONLY);
+			numRigOnlyOut++;
+		}
+	}
+
+	return anyChildNeeded;
+}
+
+void FbxToHkxConverter::markRigOnlyNodes()
+{
+	hkPointerMap<FbxNode*, int> skinLinks;
+	findSkinLinks(skinLinks);
+
+	int numRigOnly = 0;
+	markRigOnlyNodesRecursive(m_rootNode, skinLinks, numRigOnly);
+
+	printf("Animation scenes: %d subtrees only converted for the rig\n", numRigOnly);
+}
+
+FbxAMatrix FbxToHkxConverter::evaluateLocalTransform(FbxNode* fbxNode, FbxTime time)
+{
+	FbxAMatrix transform = fbxNode->EvaluateLocalTransform(time);
+
+	for (FbxNode* fbxParentNode = fbxNode->GetParent();
+		 fbxParentNode && m_nodeOptimizations.getWithDefault(fbxParentNode, NODE_KEEP) == NODE_COLLAPSE;
+		 fbxParentNode = fbxParentNode->GetParent())
+	{
+		transform = fbxParentNode->EvaluateLocalTransform(time) * transform;
+	}
+
+	return transform;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
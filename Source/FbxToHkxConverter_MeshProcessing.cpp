@@ -0,0 +1,1713 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxConverter.h"
+#include "FbxToHkxIndexOptimizer.h"
+#include "FbxToHkxThreadPool.h"
+#include "FbxToHkxMeshSimplifier.h"
+#include "FbxToHkxTrace.h"
+
+// This file contains the post-processing stages that run on a mesh section once fillBuffers has written it. They
+// only touch Havok data and run on worker threads, see processMeshSectionJobs.
+
+#include <Common/SceneData/Mesh/hkxMeshSection.h>
+#include <Common/Base/Container/PointerMap/hkPointerMap.h>
+#include <Common/SceneData/Attributes/hkxAttributeGroup.h>
+#include <Common/SceneData/Mesh/hkxVertexAnimation.h>
+#include <Common/SceneData/Mesh/hkxMesh.h>
+#include <Common/SceneData/Skin/hkxSkinBinding.h>
+#include <Common/SceneData/Attributes/hkxAttribute.h>
+
+// Clusters may only be split while their ACMR is within this factor of the ACMR of the whole section
+static const hkReal OVERDRAW_ACMR_THRESHOLD = 1.05f;
+
+// Triangles with an area below this fraction of the squared bounding box diagonal are removed
+static const hkReal DEGENERATE_AREA_TOLERANCE = 1e-12f;
+
+// LOD levels that keep more than this factor of their target triangle count are reported
+static const hkReal LOD_TARGET_TOLERANCE = 1.1f;
+
+static int getElementByteSize(const hkxVertexDescription::ElementDecl& decl)
+{
+	switch (decl.m_type)
+	{
+	case hkxVertexDescription::HKX_DT_UINT8:
+		return decl.m_numElements;
+	case hkxVertexDescription::HKX_DT_INT16:
+		return decl.m_numElements * 2;
+	case hkxVertexDescription::HKX_DT_UINT32:
+	case hkxVertexDescription::HKX_DT_FLOAT:
+		return decl.m_numElements * 4;
+	default:
+		return 0;
+	}
+}
+
+static const hkUint8* getVertexElement(hkxVertexBuffer* vb, const hkxVertexDescription::ElementDecl& decl, int vertexIndex)
+{
+	return static_cast<const hkUint8*>(vb->getVertexDataPtr(decl)) + vertexIndex * decl.m_byteStride;
+}
+
+// FNV-1a hash over all elements of a vertex
+static hkUint32 hashVertex(hkxVertexBuffer* vb, int vertexIndex)
+{
+	const hkxVertexDescription& desc = vb->getVertexDesc();
+	hkUint32 hash = 2166136261u;
+	for (int d = 0; d < desc.m_decls.getSize(); d++)
+	{
+		const hkxVertexDescription::ElementDecl& decl = desc.m_decls[d];
+		const hkUint8* data = getVertexElement(vb, decl, vertexIndex);
+		for (int b = 0, byteSize = getElementByteSize(decl); b < byteSize; b++)
+		{
+			hash = (hash ^ data[b]) * 16777619u;
+		}
+	}
+	return hash;
+}
+
+static bool verticesEqual(hkxVertexBuffer* vb, int vertexIndexA, int vertexIndexB)
+{
+	const hkxVertexDescription& desc = vb->getVertexDesc();
+	for (int d = 0; d < desc.m_decls.getSize(); d++)
+	{
+		const hkxVertexDescription::ElementDecl& decl = desc.m_decls[d];
+		if (hkString::memCmp(getVertexElement(vb, decl, vertexIndexA), getVertexElement(vb, decl, vertexIndexB), getElementByteSize(decl)) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+static void getTriangleListIndices(const hkxIndexBuffer* ib, hkArray<hkUint32>& indicesOut)
+{
+	HK_ASSERT(0x0, ib->m_indexType == hkxIndexBuffer::INDEX_TYPE_TRI_LIST);
+
+	indicesOut.setSize(ib->m_length);
+	for (int i = 0; i < (int) ib->m_length; i++)
+	{
+		indicesOut[i] = ib->m_vertexBaseOffset + (ib->m_indices16.getSize() > 0 ? ib->m_indices16[i] : ib->m_indices32[i]);
+	}
+}
+
+static void setTriangleListIndices(hkxIndexBuffer* ib, const hkArray<hkUint32>& indices, int numVertices)
+{
+	ib->m_indexType = hkxIndexBuffer::INDEX_TYPE_TRI_LIST;
+	ib->m_vertexBaseOffset = 0;
+	ib->m_length = indices.getSize();
+
+	// Only fall back to 32 bit indices if the section can't be addressed with 16 bits
+	if (numVertices <= 0xffff)
+	{
+		ib->m_indices32.clearAndDeallocate();
+		ib->m_indices16.setSize(indices.getSize());
+		for (int i = 0; i < indices.getSize(); i++)
+		{
+			ib->m_indices16[i] = (hkUint16) indices[i];
+		}
+	}
+	else
+	{
+		ib->m_indices16.clearAndDeallocate();
+		ib->m_indices32 = indices;
+	}
+}
+
+static void getVertexPositions(hkxVertexBuffer* vb, hkArray<hkVector4>& positionsOut)
+{
+	const hkxVertexDescription::ElementDecl* posDecl = vb->getVertexDesc().getElementDecl(hkxVertexDescription::HKX_DU_POSITION, 0);
+	HK_ASSERT(0x0, posDecl && posDecl->m_type == hkxVertexDescription::HKX_DT_FLOAT);
+
+	positionsOut.setSize(vb->getNumVertices());
+	for (int v = 0; v < positionsOut.getSize(); v++)
+	{
+		const float* pos = reinterpret_cast<const float*>(getVertexElement(vb, *posDecl, v));
+		positionsOut[v].set(pos[0], pos[1], pos[2], 0.0f);
+	}
+}
+
+// Merge bitwise identical vertices with equal keys. Returns the number of unique vertices; remapOut maps each input vertex
+// to its unique vertex and representativesOut holds the first input vertex of each unique vertex.
+static int weldVertices(hkxVertexBuffer* vb, const hkArray<int>* vertexKeys, hkArray<int>& remapOut, hkArray<int>& representativesOut)
+{
+	const int numVertices = vb->getNumVertices();
+	remapOut.setSize(numVertices);
+	representativesOut.clear();
+
+	// Buckets are chained through nextInBucket, the map holds the most recently added unique vertex of each bucket
+	hkPointerMap<hkUlong, int> bucketHeads;
+	hkArray<int>::Temp nextInBucket;
+
+	for (int v = 0; v < numVertices; v++)
+	{
+		const hkUint32 hash = vertexKeys ? (hashVertex(vb, v) ^ (hkUint32) (*vertexKeys)[v]) * 16777619u : hashVertex(vb, v);
+		const hkUlong key = hash & 0x7fffffff;
+
+		int match = -1;
+		for (int u = bucketHeads.getWithDefault(key, -1); u >= 0; u = nextInBucket[u])
+		{
+			const int representative = representativesOut[u];
+			if ((!vertexKeys || (*vertexKeys)[representative] == (*vertexKeys)[v]) && verticesEqual(vb, representative, v))
+			{
+				match = u;
+				break;
+			}
+		}
+
+		if (match < 0)
+		{
+			match = representativesOut.getSize();
+			representativesOut.pushBack(v);
+			nextInBucket.pushBack(bucketHeads.getWithDefault(key, -1));
+			bucketHeads.insert(key, match);
+		}
+
+		remapOut[v] = match;
+	}
+
+	return representativesOut.getSize();
+}
+
+static hkxVertexBuffer* createRemappedVertexBuffer(hkxVertexBuffer* vb, const hkArray<int>& newToOld)
+{
+	hkxVertexBuffer* newVB = new hkxVertexBuffer();
+	newVB->setNumVertices(newToOld.getSize(), vb->getVertexDesc());
+	for (int v = 0; v < newToOld.getSize(); v++)
+	{
+		newVB->copyVertex(*vb, newToOld[v], v);
+	}
+	return newVB;
+}
+
+void FbxToHkxConverter::optimizeMeshSection(hkxMeshSection* section, const char* meshName, const hkArray<int>* vertexKeys, hkArray<int>& outputToInputOut, hkStringBuf& logOut)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	hkxIndexBuffer* ib = section->m_indexBuffers[0];
+	if (ib->m_indexType != hkxIndexBuffer::INDEX_TYPE_TRI_LIST)
+	{
+		outputToInputOut.setSize(vb->getNumVertices());
+		for (int v = 0; v < outputToInputOut.getSize(); v++)
+		{
+			outputToInputOut[v] = v;
+		}
+		return;
+	}
+
+	hkArray<hkUint32> indices;
+	getTriangleListIndices(ib, indices);
+
+	const int numInputVertices = vb->getNumVertices();
+	const int numInputTriangles = indices.getSize() / 3;
+
+	// fillBuffers writes one vertex per polygon corner, so identical vertices have to be merged first
+	hkArray<int> weldRemap;
+	hkArray<int> weldedToInput;
+	const int numWeldedVertices = weldVertices(vb, vertexKeys, weldRemap, weldedToInput);
+	for (int i = 0; i < indices.getSize(); i++)
+	{
+		indices[i] = (hkUint32) weldRemap[indices[i]];
+	}
+
+	hkArray<hkVector4> positions;
+	{
+		hkArray<hkVector4> inputPositions;
+		getVertexPositions(vb, inputPositions);
+		positions.setSize(numWeldedVertices);
+		for (int v = 0; v < numWeldedVertices; v++)
+		{
+			positions[v] = inputPositions[weldedToInput[v]];
+		}
+	}
+
+	// Statistics of the welded section in its original triangle order
+	FbxToHkxIndexOptimizer::CacheStatistics statisticsBefore;
+	FbxToHkxIndexOptimizer::computeCacheStatistics(indices, numWeldedVertices, FbxToHkxIndexOptimizer::DEFAULT_CACHE_SIZE, statisticsBefore);
+
+	hkReal minArea = 0.0f;
+	if (numWeldedVertices > 0)
+	{
+		hkVector4 aabbMin = positions[0];
+		hkVector4 aabbMax = positions[0];
+		for (int v = 1; v < numWeldedVertices; v++)
+		{
+			aabbMin.setMin(aabbMin, positions[v]);
+			aabbMax.setMax(aabbMax, positions[v]);
+		}
+		hkVector4 diagonal; diagonal.setSub(aabbMax, aabbMin);
+		minArea = diagonal.lengthSquared<3>().getReal() * DEGENERATE_AREA_TOLERANCE;
+	}
+
+	FbxToHkxIndexOptimizer::removeDegenerateTriangles(indices, positions, minArea);
+	FbxToHkxIndexOptimizer::optimizeVertexCache(indices, numWeldedVertices);
+	FbxToHkxIndexOptimizer::optimizeOverdraw(indices, positions, FbxToHkxIndexOptimizer::DEFAULT_CACHE_SIZE, OVERDRAW_ACMR_THRESHOLD);
+
+	hkArray<int> fetchRemap;
+	const int numOutputVertices = FbxToHkxIndexOptimizer::optimizeVertexFetch(indices, numWeldedVertices, fetchRemap);
+
+	hkArray<int>& outputToInput = outputToInputOut;
+	outputToInput.setSize(numOutputVertices);
+	for (int v = 0; v < numWeldedVertices; v++)
+	{
+		if (fetchRemap[v] >= 0)
+		{
+			outputToInput[fetchRemap[v]] = weldedToInput[v];
+		}
+	}
+
+	hkxVertexBuffer* newVB = createRemappedVertexBuffer(vb, outputToInput);
+	section->m_vertexBuffer = newVB;
+	newVB->removeReference();
+
+	setTriangleListIndices(ib, indices, numOutputVertices);
+
+	FbxToHkxIndexOptimizer::CacheStatistics statisticsAfter;
+	FbxToHkxIndexOptimizer::computeCacheStatistics(indices, numOutputVertices, FbxToHkxIndexOptimizer::DEFAULT_CACHE_SIZE, statisticsAfter);
+
+	logOut.appendPrintf("Optimized mesh section [%s]: triangles %d -> %d, vertices %d -> %d, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n",
+		meshName,
+		numInputTriangles, indices.getSize() / 3,
+		numInputVertices, numOutputVertices,
+		statisticsBefore.m_acmr, statisticsAfter.m_acmr,
+		statisticsBefore.m_atvr, statisticsAfter.m_atvr);
+}
+
+//
+// Compact vertex formats
+//
+
+struct QuantizationError
+{
+	hkReal m_max;
+	hkReal m_sumSquared;
+	int m_count;
+
+	QuantizationError() : m_max(0.0f), m_sumSquared(0.0f), m_count(0) {}
+
+	void add(hkReal error)
+	{
+		m_max = hkMath::max2(m_max, error);
+		m_sumSquared += error * error;
+		m_count++;
+	}
+
+	hkReal getRms() const
+	{
+		return m_count > 0 ? hkMath::sqrt(m_sumSquared / m_count) : 0.0f;
+	}
+};
+
+static inline hkReal signNotZero(hkReal value)
+{
+	return value < 0.0f ? -1.0f : 1.0f;
+}
+
+static inline hkInt16 floatToSnorm16(hkReal value)
+{
+	const hkReal clamped = hkMath::clamp(value, hkReal(-1.0f), hkReal(1.0f));
+	return (hkInt16) hkMath::hkFloatToInt(clamped * 32767.0f + (clamped < 0.0f ? -0.5f : 0.5f));
+}
+
+static inline hkUint32 floatToUnorm(hkReal value, hkUint32 maxValue)
+{
+	const hkReal clamped = hkMath::clamp(value, hkReal(0.0f), hkReal(1.0f));
+	return (hkUint32) hkMath::hkFloatToInt(clamped * maxValue + 0.5f);
+}
+
+static void encodeOctahedral(const float* normal, hkInt16* encodedOut)
+{
+	const hkReal l1 = hkMath::fabs(normal[0]) + hkMath::fabs(normal[1]) + hkMath::fabs(normal[2]);
+	if (l1 <= 0.0f)
+	{
+		encodedOut[0] = encodedOut[1] = 0;
+		return;
+	}
+
+	hkReal x = normal[0] / l1;
+	hkReal y = normal[1] / l1;
+
+	// Fold the lower hemisphere over the diagonals
+	if (normal[2] < 0.0f)
+	{
+		const hkReal foldedX = (1.0f - hkMath::fabs(y)) * signNotZero(x);
+		const hkReal foldedY = (1.0f - hkMath::fabs(x)) * signNotZero(y);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	encodedOut[0] = floatToSnorm16(x);
+	encodedOut[1] = floatToSnorm16(y);
+}
+
+static void decodeOctahedral(const hkInt16* encoded, hkVector4& normalOut)
+{
+	hkReal x = hkMath::max2(encoded[0] / 32767.0f, -1.0f);
+	hkReal y = hkMath::max2(encoded[1] / 32767.0f, -1.0f);
+	const hkReal z = 1.0f - hkMath::fabs(x) - hkMath::fabs(y);
+
+	if (z < 0.0f)
+	{
+		const hkReal unfoldedX = (1.0f - hkMath::fabs(y)) * signNotZero(x);
+		const hkReal unfoldedY = (1.0f - hkMath::fabs(x)) * signNotZero(y);
+		x = unfoldedX;
+		y = unfoldedY;
+	}
+
+	normalOut.set(x, y, z, 0.0f);
+	normalOut.normalizeIfNotZero<3>();
+}
+
+// x, y and z as unorm10 in the low 30 bits, w as unorm2 in the top two bits
+static hkUint32 encodePacked1010102(const float* vec, int numElements)
+{
+	const hkReal w = numElements > 3 ? vec[3] : 1.0f;
+	return floatToUnorm(vec[0] * 0.5f + 0.5f, 1023) |
+		(floatToUnorm(vec[1] * 0.5f + 0.5f, 1023) << 10) |
+		(floatToUnorm(vec[2] * 0.5f + 0.5f, 1023) << 20) |
+		(floatToUnorm(w * 0.5f + 0.5f, 3) << 30);
+}
+
+static void decodePacked1010102(hkUint32 packed, hkVector4& vecOut)
+{
+	vecOut.set(
+		((packed & 0x3ff) / 1023.0f) * 2.0f - 1.0f,
+		(((packed >> 10) & 0x3ff) / 1023.0f) * 2.0f - 1.0f,
+		(((packed >> 20) & 0x3ff) / 1023.0f) * 2.0f - 1.0f,
+		((packed >> 30) / 3.0f) * 2.0f - 1.0f);
+}
+
+static hkUint16 floatToHalf(float value)
+{
+	union { float f; hkUint32 u; } bits;
+	bits.f = value;
+
+	const hkUint32 sign = (bits.u >> 16) & 0x8000;
+	const hkUint32 biasedExponent = (bits.u >> 23) & 0xff;
+	hkUint32 mantissa = bits.u & 0x7fffff;
+
+	// Infinity and NaN
+	if (biasedExponent == 0xff)
+	{
+		return (hkUint16) (sign | 0x7c00 | (mantissa ? 0x200 : 0));
+	}
+
+	const int exponent = (int) biasedExponent - 127 + 15;
+
+	// Overflow to infinity
+	if (exponent >= 0x1f)
+	{
+		return (hkUint16) (sign | 0x7c00);
+	}
+
+	// Subnormal half or underflow to zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+		{
+			return (hkUint16) sign;
+		}
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		hkUint32 half = mantissa >> shift;
+		if ((mantissa >> (shift - 1)) & 1)
+		{
+			half++;
+		}
+		return (hkUint16) (sign | half);
+	}
+
+	// Round to nearest, a carry out of the mantissa correctly increments the exponent
+	hkUint32 half = sign | (exponent << 10) | (mantissa >> 13);
+	if (mantissa & 0x1000)
+	{
+		half++;
+	}
+	return (hkUint16) half;
+}
+
+static float halfToFloat(hkUint16 half)
+{
+	const hkUint32 sign = (hkUint32) (half & 0x8000) << 16;
+	const hkUint32 exponent = (half >> 10) & 0x1f;
+	const hkUint32 mantissa = half & 0x3ff;
+
+	union { float f; hkUint32 u; } bits;
+	if (exponent == 0)
+	{
+		bits.f = mantissa * (1.0f / 16777216.0f);
+		bits.u |= sign;
+	}
+	else if (exponent == 0x1f)
+	{
+		bits.u = sign | 0x7f800000 | (mantissa << 13);
+	}
+	else
+	{
+		bits.u = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+	}
+	return bits.f;
+}
+
+static hkxAttribute& addQuantizationVector(hkxAttributeGroup& group, const char* name, const hkVector4& value)
+{
+	hkxAttribute& attribute = group.m_attributes.expandOne();
+	attribute.m_name = name;
+
+	hkxAnimatedVector* vectorData = new hkxAnimatedVector();
+	vectorData->m_hint = hkxAttribute::HINT_NONE;
+	vectorData->m_vectors.setSize(4);
+	for (int i = 0; i < 4; i++)
+	{
+		vectorData->m_vectors[i] = value(i);
+	}
+	attribute.m_value = vectorData;
+	vectorData->removeReference();
+
+	return attribute;
+}
+
+void FbxToHkxConverter::compactMeshSection(hkxMeshSection* section, hkxNode* node, const char* meshName, hkStringBuf& logOut)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const hkxVertexDescription& srcDesc = vb->getVertexDesc();
+	const int numVertices = vb->getNumVertices();
+
+	// Build the compact description, keeping the order of the elements
+	hkxVertexDescription dstDesc;
+	int srcBytesPerVertex = 0;
+	int dstBytesPerVertex = 0;
+	for (int d = 0; d < srcDesc.m_decls.getSize(); d++)
+	{
+		const hkxVertexDescription::ElementDecl& srcDecl = srcDesc.m_decls[d];
+		hkxVertexDescription::ElementDecl dstDecl(srcDecl.m_usage, srcDecl.m_type, srcDecl.m_numElements);
+
+		if (srcDecl.m_type == hkxVertexDescription::HKX_DT_FLOAT)
+		{
+			switch (srcDecl.m_usage)
+			{
+			case hkxVertexDescription::HKX_DU_POSITION:
+				if (m_options.m_positionFormat == POSITION_FORMAT_UNORM16)
+				{
+					dstDecl = hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_POSITION, hkxVertexDescription::HKX_DT_INT16, 4);
+				}
+				break;
+			case hkxVertexDescription::HKX_DU_NORMAL:
+			case hkxVertexDescription::HKX_DU_TANGENT:
+			case hkxVertexDescription::HKX_DU_BINORMAL:
+				if (m_options.m_normalFormat == NORMAL_FORMAT_OCTAHEDRAL16 && srcDecl.m_numElements == 3)
+				{
+					dstDecl = hkxVertexDescription::ElementDecl(srcDecl.m_usage, hkxVertexDescription::HKX_DT_INT16, 2);
+				}
+				else if (m_options.m_normalFormat == NORMAL_FORMAT_PACKED_10_10_10_2)
+				{
+					dstDecl = hkxVertexDescription::ElementDecl(srcDecl.m_usage, hkxVertexDescription::HKX_DT_UINT32, 1);
+				}
+				break;
+			case hkxVertexDescription::HKX_DU_TEXCOORD:
+				if (m_options.m_texCoordFormat != TEXCOORD_FORMAT_FLOAT32 && srcDecl.m_numElements == 2)
+				{
+					dstDecl = hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_TEXCOORD, hkxVertexDescription::HKX_DT_INT16, 2);
+				}
+				break;
+			default:
+				break;
+			}
+		}
+
+		dstDesc.m_decls.pushBack(dstDecl);
+		srcBytesPerVertex += getElementByteSize(srcDecl);
+		dstBytesPerVertex += getElementByteSize(dstDecl);
+	}
+
+	hkxVertexBuffer* newVB = new hkxVertexBuffer();
+	newVB->setNumVertices(numVertices, dstDesc);
+
+	hkxAttributeGroup* quantizationGroup = HK_NULL;
+	QuantizationError positionError;
+	QuantizationError normalError;
+	QuantizationError texCoordError;
+
+	for (int d = 0; d < srcDesc.m_decls.getSize(); d++)
+	{
+		const hkxVertexDescription::ElementDecl& srcDecl = srcDesc.m_decls[d];
+
+		int usageIndex = 0;
+		for (int e = 0; e < d; e++)
+		{
+			if (srcDesc.m_decls[e].m_usage == srcDecl.m_usage)
+			{
+				usageIndex++;
+			}
+		}
+
+		const hkxVertexDescription::ElementDecl* dstDecl = newVB->getVertexDesc().getElementDecl(srcDecl.m_usage, usageIndex);
+		HK_ASSERT(0x0, dstDecl);
+		hkUint8* dstData = static_cast<hkUint8*>(newVB->getVertexDataPtr(*dstDecl));
+
+		if (dstDecl->m_type == srcDecl.m_type)
+		{
+			const int byteSize = getElementByteSize(srcDecl);
+			for (int v = 0; v < numVertices; v++)
+			{
+				hkString::memCpy(dstData + v * dstDecl->m_byteStride, getVertexElement(vb, srcDecl, v), byteSize);
+			}
+			continue;
+		}
+
+		if (srcDecl.m_usage == hkxVertexDescription::HKX_DU_POSITION)
+		{
+			hkArray<hkVector4> positions;
+			getVertexPositions(vb, positions);
+
+			hkVector4 aabbMin; aabbMin.setZero();
+			hkVector4 aabbMax; aabbMax.setZero();
+			if (numVertices > 0)
+			{
+				aabbMin = positions[0];
+				aabbMax = positions[0];
+				for (int v = 1; v < numVertices; v++)
+				{
+					aabbMin.setMin(aabbMin, positions[v]);
+					aabbMax.setMax(aabbMax, positions[v]);
+				}
+			}
+
+			hkVector4 scale; scale.setSub(aabbMax, aabbMin);
+			scale.mul(hkSimdReal::fromFloat(1.0f / 65535.0f));
+			scale.zeroComponent<3>();
+			aabbMin.zeroComponent<3>();
+
+			for (int v = 0; v < numVertices; v++)
+			{
+				hkInt16* encoded = reinterpret_cast<hkInt16*>(dstData + v * dstDecl->m_byteStride);
+				hkVector4 decoded;
+				for (int i = 0; i < 3; i++)
+				{
+					const hkReal extent = scale(i) * 65535.0f;
+					const hkUint32 q = extent > 0.0f ? floatToUnorm((positions[v](i) - aabbMin(i)) / extent, 0xffff) : 0;
+					encoded[i] = (hkInt16) (hkUint16) q;
+					decoded(i) = aabbMin(i) + q * scale(i);
+				}
+				encoded[3] = 0;
+				decoded(3) = 0.0f;
+
+				hkVector4 delta; delta.setSub(decoded, positions[v]);
+				positionError.add(delta.length<3>().getReal());
+			}
+
+			if (!quantizationGroup)
+			{
+				quantizationGroup = node->m_attributeGroups.expandBy(1);
+				quantizationGroup->m_name = "hkVertexQuantization";
+			}
+			addQuantizationVector(*quantizationGroup, "positionOffset", aabbMin);
+			addQuantizationVector(*quantizationGroup, "positionScale", scale);
+		}
+		else if (srcDecl.m_usage == hkxVertexDescription::HKX_DU_TEXCOORD)
+		{
+			hkReal uvMin[2] = { 0.0f, 0.0f };
+			hkReal uvMax[2] = { 0.0f, 0.0f };
+			for (int v = 0; v < numVertices; v++)
+			{
+				const float* uv = reinterpret_cast<const float*>(getVertexElement(vb, srcDecl, v));
+				for (int i = 0; i < 2; i++)
+				{
+					uvMin[i] = v > 0 ? hkMath::min2(uvMin[i], uv[i]) : uv[i];
+					uvMax[i] = v > 0 ? hkMath::max2(uvMax[i], uv[i]) : uv[i];
+				}
+			}
+
+			for (int v = 0; v < numVertices; v++)
+			{
+				const float* uv = reinterpret_cast<const float*>(getVertexElement(vb, srcDecl, v));
+				hkInt16* encoded = reinterpret_cast<hkInt16*>(dstData + v * dstDecl->m_byteStride);
+				for (int i = 0; i < 2; i++)
+				{
+					hkReal decoded;
+					if (m_options.m_texCoordFormat == TEXCOORD_FORMAT_HALF16)
+					{
+						const hkUint16 half = floatToHalf(uv[i]);
+						encoded[i] = (hkInt16) half;
+						decoded = halfToFloat(half);
+					}
+					else
+					{
+						const hkReal extent = uvMax[i] - uvMin[i];
+						const hkUint32 q = extent > 0.0f ? floatToUnorm((uv[i] - uvMin[i]) / extent, 0xffff) : 0;
+						encoded[i] = (hkInt16) (hkUint16) q;
+						decoded = uvMin[i] + q * (extent / 65535.0f);
+					}
+					texCoordError.add(hkMath::fabs(decoded - uv[i]));
+				}
+			}
+
+			if (m_options.m_texCoordFormat == TEXCOORD_FORMAT_UNORM16)
+			{
+				if (!quantizationGroup)
+				{
+					quantizationGroup = node->m_attributeGroups.expandBy(1);
+					quantizationGroup->m_name = "hkVertexQuantization";
+				}
+
+				hkStringBuf offsetName; offsetName.printf("texCoordOffset%d", usageIndex);
+				hkStringBuf scaleName; scaleName.printf("texCoordScale%d", usageIndex);
+
+				hkVector4 offset; offset.set(uvMin[0], uvMin[1], 0.0f, 0.0f);
+				hkVector4 scale; scale.set((uvMax[0] - uvMin[0]) / 65535.0f, (uvMax[1] - uvMin[1]) / 65535.0f, 0.0f, 0.0f);
+				addQuantizationVector(*quantizationGroup, offsetName.cString(), offset);
+				addQuantizationVector(*quantizationGroup, scaleName.cString(), scale);
+			}
+		}
+		else
+		{
+			// Normals, tangents and binormals
+			for (int v = 0; v < numVertices; v++)
+			{
+				const float* vec = reinterpret_cast<const float*>(getVertexElement(vb, srcDecl, v));
+				hkUint8* dstVertex = dstData + v * dstDecl->m_byteStride;
+
+				hkVector4 decoded;
+				if (dstDecl->m_type == hkxVertexDescription::HKX_DT_INT16)
+				{
+					hkInt16* encoded = reinterpret_cast<hkInt16*>(dstVertex);
+					encodeOctahedral(vec, encoded);
+					decodeOctahedral(encoded, decoded);
+				}
+				else
+				{
+					const hkUint32 packed = encodePacked1010102(vec, srcDecl.m_numElements);
+					*reinterpret_cast<hkUint32*>(dstVertex) = packed;
+					decodePacked1010102(packed, decoded);
+					decoded.normalizeIfNotZero<3>();
+				}
+
+				hkVector4 original; original.set(vec[0], vec[1], vec[2], 0.0f);
+				original.normalizeIfNotZero<3>();
+				const hkReal cosAngle = hkMath::clamp(original.dot<3>(decoded).getReal(), hkReal(-1.0f), hkReal(1.0f));
+				normalError.add(hkMath::acos(cosAngle) * (180.0f / HK_REAL_PI));
+			}
+		}
+	}
+
+	section->m_vertexBuffer = newVB;
+	newVB->removeReference();
+
+	logOut.appendPrintf("Compacted mesh section [%s]: %d -> %d bytes per vertex", meshName, srcBytesPerVertex, dstBytesPerVertex);
+	if (positionError.m_count > 0)
+	{
+		logOut.appendPrintf(", position error max %g rms %g", positionError.m_max, positionError.getRms());
+	}
+	if (normalError.m_count > 0)
+	{
+		logOut.appendPrintf(", normal error max %.3f rms %.3f degrees", normalError.m_max, normalError.getRms());
+	}
+	if (texCoordError.m_count > 0)
+	{
+		logOut.appendPrintf(", texcoord error max %g rms %g", texCoordError.m_max, texCoordError.getRms());
+	}
+	logOut.append("\n");
+
+	if (m_options.m_maxPositionError > 0.0f && positionError.m_max > m_options.m_maxPositionError)
+	{
+		HK_WARN(0x0, "Mesh section " << meshName << " exceeds the position tolerance: " << positionError.m_max << " > " << m_options.m_maxPositionError);
+	}
+	if (m_options.m_maxNormalErrorDegrees > 0.0f && normalError.m_max > m_options.m_maxNormalErrorDegrees)
+	{
+		HK_WARN(0x0, "Mesh section " << meshName << " exceeds the normal tolerance: " << normalError.m_max << " > " << m_options.m_maxNormalErrorDegrees << " degrees");
+	}
+	if (m_options.m_maxTexCoordError > 0.0f && texCoordError.m_max > m_options.m_maxTexCoordError)
+	{
+		HK_WARN(0x0, "Mesh section " << meshName << " exceeds the texcoord tolerance: " << texCoordError.m_max << " > " << m_options.m_maxTexCoordError);
+	}
+}
+
+//
+// Normal and tangent generation
+//
+
+// Angle at corner 0 of the triangle (p0, p1, p2)
+static hkReal getCornerAngle(const hkVector4& p0, const hkVector4& p1, const hkVector4& p2)
+{
+	hkVector4 e1; e1.setSub(p1, p0);
+	hkVector4 e2; e2.setSub(p2, p0);
+	if (e1.normalizeIfNotZero<3>() && e2.normalizeIfNotZero<3>())
+	{
+		return hkMath::acos(hkMath::clamp(e1.dot<3>(e2).getReal(), hkReal(-1.0f), hkReal(1.0f)));
+	}
+	return 0.0f;
+}
+
+static void getVertexVectors(hkxVertexBuffer* vb, const hkxVertexDescription::ElementDecl& decl, hkArray<hkVector4>& vectorsOut)
+{
+	HK_ASSERT(0x0, decl.m_type == hkxVertexDescription::HKX_DT_FLOAT);
+
+	vectorsOut.setSize(vb->getNumVertices());
+	for (int v = 0; v < vectorsOut.getSize(); v++)
+	{
+		const float* data = reinterpret_cast<const float*>(getVertexElement(vb, decl, v));
+		vectorsOut[v].set(data[0], data[1], decl.m_numElements > 2 ? data[2] : 0.0f, 0.0f);
+	}
+}
+
+static void setVertexVector(hkxVertexBuffer* vb, const hkxVertexDescription::ElementDecl& decl, int vertexIndex, const hkVector4& value)
+{
+	float* data = reinterpret_cast<float*>(const_cast<hkUint8*>(getVertexElement(vb, decl, vertexIndex)));
+	data[0] = value(0);
+	data[1] = value(1);
+	data[2] = value(2);
+}
+
+// Any unit vector perpendicular to the given unit vector
+static void getPerpendicular(const hkVector4& normal, hkVector4& perpendicularOut)
+{
+	hkVector4 axis;
+	if (hkMath::fabs(normal(0)) < 0.9f)
+	{
+		axis.set(1.0f, 0.0f, 0.0f, 0.0f);
+	}
+	else
+	{
+		axis.set(0.0f, 1.0f, 0.0f, 0.0f);
+	}
+	perpendicularOut.setCross(normal, axis);
+	perpendicularOut.normalizeIfNotZero<3>();
+}
+
+void FbxToHkxConverter::generateNormals(hkxMeshSection* section, const hkArray<int>& vertexControlPoints, const hkArray<int>& triangleSmoothingGroups)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const hkxVertexDescription::ElementDecl* normDecl = vb->getVertexDesc().getElementDecl(hkxVertexDescription::HKX_DU_NORMAL, 0);
+	HK_ASSERT(0x0, normDecl && normDecl->m_type == hkxVertexDescription::HKX_DT_FLOAT);
+
+	hkArray<hkUint32> indices;
+	getTriangleListIndices(section->m_indexBuffers[0], indices);
+	const int numTriangles = indices.getSize() / 3;
+
+	hkArray<hkVector4> positions;
+	getVertexPositions(vb, positions);
+
+	// Unit face normals and corner angles for the angle weighted average
+	hkArray<hkVector4> faceNormals(numTriangles);
+	hkArray<hkReal> cornerAngles(indices.getSize());
+	int numControlPoints = 0;
+	for (int f = 0; f < numTriangles; f++)
+	{
+		const hkVector4& p0 = positions[indices[f * 3 + 0]];
+		const hkVector4& p1 = positions[indices[f * 3 + 1]];
+		const hkVector4& p2 = positions[indices[f * 3 + 2]];
+
+		hkVector4 e1; e1.setSub(p1, p0);
+		hkVector4 e2; e2.setSub(p2, p0);
+		faceNormals[f].setCross(e1, e2);
+		faceNormals[f].normalizeIfNotZero<3>();
+
+		cornerAngles[f * 3 + 0] = getCornerAngle(p0, p1, p2);
+		cornerAngles[f * 3 + 1] = getCornerAngle(p1, p2, p0);
+		cornerAngles[f * 3 + 2] = getCornerAngle(p2, p0, p1);
+
+		for (int c = 0; c < 3; c++)
+		{
+			numControlPoints = hkMath::max2(numControlPoints, vertexControlPoints[indices[f * 3 + c]] + 1);
+		}
+	}
+
+	// Corners around each control point
+	hkArray<int> cornerOffsets(numControlPoints + 1, 0);
+	for (int k = 0; k < indices.getSize(); k++)
+	{
+		cornerOffsets[vertexControlPoints[indices[k]] + 1]++;
+	}
+	for (int cp = 0; cp < numControlPoints; cp++)
+	{
+		cornerOffsets[cp + 1] += cornerOffsets[cp];
+	}
+	hkArray<int> corners(indices.getSize());
+	{
+		hkArray<int> fill(numControlPoints);
+		for (int cp = 0; cp < numControlPoints; cp++)
+		{
+			fill[cp] = cornerOffsets[cp];
+		}
+		for (int k = 0; k < indices.getSize(); k++)
+		{
+			corners[fill[vertexControlPoints[indices[k]]]++] = k;
+		}
+	}
+
+	// Average the faces around each corner that share a smoothing group with the corner's face
+	for (int k = 0; k < indices.getSize(); k++)
+	{
+		const int f = k / 3;
+		const int group = triangleSmoothingGroups[f];
+		const int cp = vertexControlPoints[indices[k]];
+
+		hkVector4 normal; normal.setZero();
+		for (int n = cornerOffsets[cp]; n < cornerOffsets[cp + 1]; n++)
+		{
+			const int otherCorner = corners[n];
+			const int otherFace = otherCorner / 3;
+			if (otherFace == f || (group & triangleSmoothingGroups[otherFace]) != 0)
+			{
+				normal.addMul(hkSimdReal::fromFloat(cornerAngles[otherCorner]), faceNormals[otherFace]);
+			}
+		}
+
+		if (!normal.normalizeIfNotZero<3>())
+		{
+			normal = faceNormals[f];
+		}
+		setVertexVector(vb, *normDecl, indices[k], normal);
+	}
+}
+
+// MikkTSpace style tangent frames: per corner tangents are projected onto the vertex normal and averaged, angle
+// weighted, over all corners with the same position, normal, UV and handedness.
+void FbxToHkxConverter::generateTangents(hkxMeshSection* section, int uvSet)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const hkxVertexDescription& desc = vb->getVertexDesc();
+	const hkxVertexDescription::ElementDecl* posDecl = desc.getElementDecl(hkxVertexDescription::HKX_DU_POSITION, 0);
+	const hkxVertexDescription::ElementDecl* normDecl = desc.getElementDecl(hkxVertexDescription::HKX_DU_NORMAL, 0);
+	const hkxVertexDescription::ElementDecl* uvDecl = desc.getElementDecl(hkxVertexDescription::HKX_DU_TEXCOORD, uvSet);
+	const hkxVertexDescription::ElementDecl* tangentDecl = desc.getElementDecl(hkxVertexDescription::HKX_DU_TANGENT, uvSet);
+	const hkxVertexDescription::ElementDecl* binormalDecl = desc.getElementDecl(hkxVertexDescription::HKX_DU_BINORMAL, uvSet);
+	if (!posDecl || !normDecl || !uvDecl || !tangentDecl || !binormalDecl)
+	{
+		return;
+	}
+
+	hkArray<hkUint32> indices;
+	getTriangleListIndices(section->m_indexBuffers[0], indices);
+	const int numTriangles = indices.getSize() / 3;
+
+	hkArray<hkVector4> positions; getVertexVectors(vb, *posDecl, positions);
+	hkArray<hkVector4> normals; getVertexVectors(vb, *normDecl, normals);
+	hkArray<hkVector4> uvs; getVertexVectors(vb, *uvDecl, uvs);
+	for (int v = 0; v < normals.getSize(); v++)
+	{
+		normals[v].normalizeIfNotZero<3>();
+	}
+
+	hkArray<hkVector4> cornerTangents(indices.getSize());
+	hkArray<hkReal> cornerSigns(indices.getSize());
+	hkArray<int> cornerGroups(indices.getSize());
+
+	// Corners are grouped like welded vertices, chained through nextInBucket
+	hkPointerMap<hkUlong, int> bucketHeads;
+	hkArray<int> nextInBucket;
+	hkArray<int> groupRepresentatives;
+	hkArray<hkVector4> groupTangents;
+
+	for (int f = 0; f < numTriangles; f++)
+	{
+		const int i0 = indices[f * 3 + 0];
+		const int i1 = indices[f * 3 + 1];
+		const int i2 = indices[f * 3 + 2];
+
+		hkVector4 e1; e1.setSub(positions[i1], positions[i0]);
+		hkVector4 e2; e2.setSub(positions[i2], positions[i0]);
+		const hkReal du1 = uvs[i1](0) - uvs[i0](0);
+		const hkReal dv1 = uvs[i1](1) - uvs[i0](1);
+		const hkReal du2 = uvs[i2](0) - uvs[i0](0);
+		const hkReal dv2 = uvs[i2](1) - uvs[i0](1);
+
+		// Triangle tangent and bitangent from the UV derivatives, zero for degenerate UVs
+		hkVector4 faceTangent; faceTangent.setZero();
+		hkVector4 faceBitangent; faceBitangent.setZero();
+		const hkReal det = du1 * dv2 - du2 * dv1;
+		if (hkMath::fabs(det) > HK_REAL_EPSILON)
+		{
+			const hkReal invDet = 1.0f / det;
+			faceTangent.setMul(e1, hkSimdReal::fromFloat(dv2 * invDet));
+			faceTangent.addMul(hkSimdReal::fromFloat(-dv1 * invDet), e2);
+			faceBitangent.setMul(e2, hkSimdReal::fromFloat(du1 * invDet));
+			faceBitangent.addMul(hkSimdReal::fromFloat(-du2 * invDet), e1);
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			const int k = f * 3 + c;
+			const int v = indices[k];
+			const hkVector4& n = normals[v];
+
+			// Project onto the tangent plane of the vertex
+			hkVector4 t = faceTangent;
+			t.subMul(n, n.dot<3>(faceTangent));
+			t.normalizeIfNotZero<3>();
+
+			hkVector4 nxt; nxt.setCross(n, t);
+			const hkReal sign = nxt.dot<3>(faceBitangent).getReal() < 0.0f ? -1.0f : 1.0f;
+
+			const hkReal angle = getCornerAngle(positions[v], positions[indices[f * 3 + (c + 1) % 3]], positions[indices[f * 3 + (c + 2) % 3]]);
+			cornerTangents[k].setMul(t, hkSimdReal::fromFloat(angle));
+			cornerSigns[k] = sign;
+
+			// FNV-1a over position, normal, uv and sign
+			hkUint32 hash = 2166136261u;
+			const float key[9] = { positions[v](0), positions[v](1), positions[v](2), n(0), n(1), n(2), uvs[v](0), uvs[v](1), sign };
+			const hkUint8* keyBytes = reinterpret_cast<const hkUint8*>(key);
+			for (int b = 0; b < (int) sizeof(key); b++)
+			{
+				hash = (hash ^ keyBytes[b]) * 16777619u;
+			}
+			const hkUlong bucket = hash & 0x7fffffff;
+
+			int group = -1;
+			for (int g = bucketHeads.getWithDefault(bucket, -1); g >= 0; g = nextInBucket[g])
+			{
+				const int r = groupRepresentatives[g];
+				const int rv = indices[r];
+				if (cornerSigns[r] == sign &&
+					positions[rv].allExactlyEqual<3>(positions[v]) &&
+					normals[rv].allExactlyEqual<3>(n) &&
+					uvs[rv].allExactlyEqual<2>(uvs[v]))
+				{
+					group = g;
+					break;
+				}
+			}
+
+			if (group < 0)
+			{
+				group = groupRepresentatives.getSize();
+				groupRepresentatives.pushBack(k);
+				groupTangents.expandOne().setZero();
+				nextInBucket.pushBack(bucketHeads.getWithDefault(bucket, -1));
+				bucketHeads.insert(bucket, group);
+			}
+
+			groupTangents[group].add(cornerTangents[k]);
+			cornerGroups[k] = group;
+		}
+	}
+
+	for (int k = 0; k < indices.getSize(); k++)
+	{
+		const int v = indices[k];
+		const hkVector4& n = normals[v];
+
+		hkVector4 t = groupTangents[cornerGroups[k]];
+		t.subMul(n, n.dot<3>(t));
+		if (!t.normalizeIfNotZero<3>())
+		{
+			getPerpendicular(n, t);
+		}
+
+		hkVector4 b; b.setCross(n, t);
+		b.mul(hkSimdReal::fromFloat(cornerSigns[k]));
+
+		setVertexVector(vb, *tangentDecl, v, t);
+		setVertexVector(vb, *binormalDecl, v, b);
+	}
+}
+
+//
+// Blend shapes
+//
+
+void FbxToHkxConverter::createBlendShapeAnimations(hkxMeshSection* section, const MeshSectionJob& job, const hkArray<int>& outputToInput, hkStringBuf& logOut)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const int numVertices = vb->getNumVertices();
+	const hkReal toleranceSquared = m_options.m_blendShapeTolerance * m_options.m_blendShapeTolerance;
+
+	hkArray<hkVector4> baseNormals;
+	const hkxVertexDescription::ElementDecl* normDecl = vb->getVertexDesc().getElementDecl(hkxVertexDescription::HKX_DU_NORMAL, 0);
+	if (normDecl)
+	{
+		getVertexVectors(vb, *normDecl, baseNormals);
+	}
+
+	// Describes the vertex animations: (vertex animation index, full weight, position scale, normal scale) per target
+	hkxAttributeGroup& targetGroup = job.m_node->m_attributeGroups.expandOne();
+	targetGroup.m_name = "hkBlendShapeTargets";
+	hkArray<hkxAnimatedVector*> channelTargets;
+	for (int c = 0; c < job.m_blendShapeChannels.getSize(); c++)
+	{
+		hkxAttribute& attribute = targetGroup.m_attributes.expandOne();
+		attribute.m_name = job.m_blendShapeChannels[c];
+
+		hkxAnimatedVector* targets = new hkxAnimatedVector();
+		targets->m_hint = hkxAttribute::HINT_IGNORE;
+		attribute.m_value = targets;
+		targets->removeReference();
+		channelTargets.pushBack(targets);
+	}
+
+	int numStoredVertices = 0;
+	for (int t = 0; t < job.m_blendShapeTargets.getSize(); t++)
+	{
+		const MeshSectionJob::BlendShapeTarget& target = job.m_blendShapeTargets[t];
+		const bool hasNormals = normDecl && target.m_normals.getSize() > 0;
+
+		// Gather the deltas of the vertices that move
+		hkArray<int> movedVertices;
+		hkArray<hkVector4> positionDeltas;
+		hkArray<hkVector4> normalDeltas;
+		hkReal maxPositionDelta = 0.0f;
+		hkReal maxNormalDelta = 0.0f;
+		for (int v = 0; v < numVertices; v++)
+		{
+			const int inputVertex = outputToInput[v];
+			const hkVector4& positionDelta = target.m_positionDeltas[job.m_vertexControlPoints[inputVertex]];
+
+			hkVector4 normalDelta; normalDelta.setZero();
+			if (hasNormals)
+			{
+				normalDelta.setSub(target.m_normals[inputVertex], baseNormals[v]);
+			}
+
+			if (positionDelta.lengthSquared<3>().getReal() <= toleranceSquared &&
+				normalDelta.lengthSquared<3>().getReal() <= toleranceSquared)
+			{
+				continue;
+			}
+
+			movedVertices.pushBack(v);
+			positionDeltas.pushBack(positionDelta);
+			normalDeltas.pushBack(normalDelta);
+			for (int i = 0; i < 3; i++)
+			{
+				maxPositionDelta = hkMath::max2(maxPositionDelta, hkMath::fabs(positionDelta(i)));
+				maxNormalDelta = hkMath::max2(maxNormalDelta, hkMath::fabs(normalDelta(i)));
+			}
+		}
+
+		const hkxVertexDescription::DataType dataType = m_options.m_quantizeBlendShapes ? hkxVertexDescription::HKX_DT_INT16 : hkxVertexDescription::HKX_DT_FLOAT;
+		const int numElements = m_options.m_quantizeBlendShapes ? 4 : 3;
+		hkxVertexDescription deltaDesc;
+		deltaDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_POSITION, dataType, numElements));
+		if (hasNormals)
+		{
+			deltaDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_NORMAL, dataType, numElements));
+		}
+
+		hkxVertexAnimation* animation = new hkxVertexAnimation();
+		animation->m_time = target.m_fullWeight;
+		animation->m_vertexIndexMap.setSize(movedVertices.getSize());
+		animation->m_vertData.setNumVertices(movedVertices.getSize(), deltaDesc);
+
+		const hkReal positionScale = maxPositionDelta / 32767.0f;
+		const hkReal normalScale = maxNormalDelta / 32767.0f;
+
+		for (int d = 0; d < deltaDesc.m_decls.getSize(); d++)
+		{
+			const hkxVertexDescription::ElementDecl* decl = animation->m_vertData.getVertexDesc().getElementDecl(deltaDesc.m_decls[d].m_usage, 0);
+			const bool isPosition = (d == 0);
+			const hkArray<hkVector4>& deltas = isPosition ? positionDeltas : normalDeltas;
+			const hkReal scale = isPosition ? positionScale : normalScale;
+
+			hkxVertexAnimation::UsageMap& usage = animation->m_componentMap.expandOne();
+			usage.m_use = deltaDesc.m_decls[d].m_usage;
+			usage.m_useIndexOrig = 0;
+			usage.m_useIndexLocal = 0;
+
+			hkUint8* data = static_cast<hkUint8*>(animation->m_vertData.getVertexDataPtr(*decl));
+			for (int i = 0; i < deltas.getSize(); i++)
+			{
+				if (m_options.m_quantizeBlendShapes)
+				{
+					hkInt16* quantized = reinterpret_cast<hkInt16*>(data + i * decl->m_byteStride);
+					for (int e = 0; e < 3; e++)
+					{
+						quantized[e] = scale > 0.0f ? floatToSnorm16(deltas[i](e) / (scale * 32767.0f)) : 0;
+					}
+					quantized[3] = 0;
+				}
+				else
+				{
+					float* delta = reinterpret_cast<float*>(data + i * decl->m_byteStride);
+					delta[0] = deltas[i](0);
+					delta[1] = deltas[i](1);
+					delta[2] = deltas[i](2);
+				}
+			}
+		}
+
+		for (int i = 0; i < movedVertices.getSize(); i++)
+		{
+			animation->m_vertexIndexMap[i] = movedVertices[i];
+		}
+		numStoredVertices += movedVertices.getSize();
+
+		hkxAnimatedVector* targets = channelTargets[target.m_channel];
+		hkFloat32* targetInfo = targets->m_vectors.expandBy(4);
+		targetInfo[0] = (hkFloat32) section->m_vertexAnimations.getSize();
+		targetInfo[1] = target.m_fullWeight;
+		targetInfo[2] = m_options.m_quantizeBlendShapes ? positionScale : 1.0f;
+		targetInfo[3] = m_options.m_quantizeBlendShapes ? normalScale : 1.0f;
+
+		section->m_vertexAnimations.pushBack(animation);
+		animation->removeReference();
+	}
+
+	logOut.appendPrintf("Blend shapes [%s]: %d targets, %d of %d vertex deltas stored\n",
+		job.m_meshName.cString(),
+		job.m_blendShapeTargets.getSize(),
+		numStoredVertices, numVertices * job.m_blendShapeTargets.getSize());
+}
+
+//
+// LOD generation
+//
+
+hkxMeshSection* FbxToHkxConverter::createLodSection(hkxMeshSection* section, hkReal ratio, const char* lodName, hkReal& errorOut, hkStringBuf& logOut)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+
+	hkArray<hkUint32> indices;
+	getTriangleListIndices(section->m_indexBuffers[0], indices);
+	const int numInputTriangles = indices.getSize() / 3;
+
+	// The simplifier detects seams from welded vertices that share a position
+	hkArray<int> weldRemap;
+	hkArray<int> weldedToInput;
+	const int numWeldedVertices = weldVertices(vb, HK_NULL, weldRemap, weldedToInput);
+	for (int i = 0; i < indices.getSize(); i++)
+	{
+		indices[i] = (hkUint32) weldRemap[indices[i]];
+	}
+
+	hkArray<hkVector4> positions;
+	hkArray<hkUint64> skinGroups(numWeldedVertices, 0);
+	{
+		hkArray<hkVector4> inputPositions;
+		getVertexPositions(vb, inputPositions);
+		positions.setSize(numWeldedVertices);
+
+		// Only vertices with identical skinning may be collapsed onto each other
+		const hkxVertexDescription::ElementDecl* weightsDecl = vb->getVertexDesc().getElementDecl(hkxVertexDescription::HKX_DU_BLENDWEIGHTS, 0);
+		const hkxVertexDescription::ElementDecl* indicesDecl = vb->getVertexDesc().getElementDecl(hkxVertexDescription::HKX_DU_BLENDINDICES, 0);
+
+		for (int v = 0; v < numWeldedVertices; v++)
+		{
+			const int inputVertex = weldedToInput[v];
+			positions[v] = inputPositions[inputVertex];
+
+			if (weightsDecl && indicesDecl)
+			{
+				const hkUint32 weights = *reinterpret_cast<const hkUint32*>(getVertexElement(vb, *weightsDecl, inputVertex));
+				const hkUint32 boneIndices = *reinterpret_cast<const hkUint32*>(getVertexElement(vb, *indicesDecl, inputVertex));
+				skinGroups[v] = ((hkUint64) boneIndices << 32) | weights;
+			}
+		}
+	}
+
+	const int targetTriangles = hkMath::max2(1, (int) (numInputTriangles * ratio));
+	errorOut = FbxToHkxMeshSimplifier::simplify(indices, positions, skinGroups, targetTriangles);
+
+	hkArray<int> fetchRemap;
+	const int numOutputVertices = FbxToHkxIndexOptimizer::optimizeVertexFetch(indices, numWeldedVertices, fetchRemap);
+
+	hkArray<int> outputToInput(numOutputVertices);
+	for (int v = 0; v < numWeldedVertices; v++)
+	{
+		if (fetchRemap[v] >= 0)
+		{
+			outputToInput[fetchRemap[v]] = weldedToInput[v];
+		}
+	}
+
+	hkxMeshSection* lodSection = new hkxMeshSection();
+	lodSection->m_material = section->m_material;
+
+	hkxVertexBuffer* lodVB = createRemappedVertexBuffer(vb, outputToInput);
+	lodSection->m_vertexBuffer = lodVB;
+	lodVB->removeReference();
+
+	hkxIndexBuffer* lodIB = new hkxIndexBuffer();
+	setTriangleListIndices(lodIB, indices, numOutputVertices);
+	lodSection->m_indexBuffers.pushBack(lodIB);
+	lodIB->removeReference();
+
+	logOut.appendPrintf("Generated LOD [%s]: triangles %d -> %d (target %d), vertices %d, error %g\n",
+		lodName, numInputTriangles, indices.getSize() / 3, targetTriangles, numOutputVertices, errorOut);
+
+	// Locked borders, seams and skin groups can stop the simplifier well short of the requested ratio
+	if (indices.getSize() / 3 > targetTriangles * LOD_TARGET_TOLERANCE)
+	{
+		HK_WARN(0x0, "LOD " << lodName << " misses its target: " << indices.getSize() / 3 << " triangles for a target of " << targetTriangles);
+	}
+
+	return lodSection;
+}
+
+//
+// Geometry deduplication
+//
+
+// FNV-1a hash over the vertex layout, the vertices and the indices of a section
+static hkUint32 hashMeshSectionContent(hkxMeshSection* section)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const hkxVertexDescription& desc = vb->getVertexDesc();
+
+	hkUint32 hash = 2166136261u;
+	for (int d = 0; d < desc.m_decls.getSize(); d++)
+	{
+		hash = (hash ^ (hkUint32) ((desc.m_decls[d].m_usage << 16) | (desc.m_decls[d].m_type << 8) | desc.m_decls[d].m_numElements)) * 16777619u;
+	}
+
+	for (int v = 0, numVertices = vb->getNumVertices(); v < numVertices; v++)
+	{
+		hash = (hash ^ hashVertex(vb, v)) * 16777619u;
+	}
+
+	for (int b = 0; b < section->m_indexBuffers.getSize(); b++)
+	{
+		hkArray<hkUint32> indices;
+		getTriangleListIndices(section->m_indexBuffers[b], indices);
+		for (int i = 0; i < indices.getSize(); i++)
+		{
+			hash = (hash ^ indices[i]) * 16777619u;
+		}
+	}
+
+	return hash;
+}
+
+static bool meshSectionContentsEqual(hkxMeshSection* sectionA, hkxMeshSection* sectionB)
+{
+	hkxVertexBuffer* vbA = sectionA->m_vertexBuffer;
+	hkxVertexBuffer* vbB = sectionB->m_vertexBuffer;
+	const hkxVertexDescription& descA = vbA->getVertexDesc();
+	const hkxVertexDescription& descB = vbB->getVertexDesc();
+
+	if (vbA->getNumVertices() != vbB->getNumVertices() ||
+		descA.m_decls.getSize() != descB.m_decls.getSize() ||
+		sectionA->m_indexBuffers.getSize() != sectionB->m_indexBuffers.getSize())
+	{
+		return false;
+	}
+
+	for (int d = 0; d < descA.m_decls.getSize(); d++)
+	{
+		const hkxVertexDescription::ElementDecl& declA = descA.m_decls[d];
+		const hkxVertexDescription::ElementDecl& declB = descB.m_decls[d];
+		if (declA.m_usage != declB.m_usage || declA.m_type != declB.m_type || declA.m_numElements != declB.m_numElements)
+		{
+			return false;
+		}
+
+		const int byteSize = getElementByteSize(declA);
+		for (int v = 0, numVertices = vbA->getNumVertices(); v < numVertices; v++)
+		{
+			if (hkString::memCmp(getVertexElement(vbA, declA, v), getVertexElement(vbB, declB, v), byteSize) != 0)
+			{
+				return false;
+			}
+		}
+	}
+
+	for (int b = 0; b < sectionA->m_indexBuffers.getSize(); b++)
+	{
+		const hkxIndexBuffer* ibA = sectionA->m_indexBuffers[b];
+		const hkxIndexBuffer* ibB = sectionB->m_indexBuffers[b];
+		if (ibA->m_indexType != ibB->m_indexType ||
+			ibA->m_vertexBaseOffset != ibB->m_vertexBaseOffset ||
+			ibA->m_length != ibB->m_length ||
+			ibA->m_indices16.getSize() != ibB->m_indices16.getSize() ||
+			ibA->m_indices32.getSize() != ibB->m_indices32.getSize())
+		{
+			return false;
+		}
+
+		if (hkString::memCmp(ibA->m_indices16.begin(), ibB->m_indices16.begin(), ibA->m_indices16.getSize() * sizeof(hkUint16)) != 0 ||
+			hkString::memCmp(ibA->m_indices32.begin(), ibB->m_indices32.begin(), ibA->m_indices32.getSize() * sizeof(hkUint32)) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static const hkxAttributeGroup* findAttributeGroup(const hkxNode* node, const char* name)
+{
+	for (int g = 0; g < node->m_attributeGroups.getSize(); g++)
+	{
+		if (hkString::strCmp(node->m_attributeGroups[g].m_name, name) == 0)
+		{
+			return &node->m_attributeGroups[g];
+		}
+	}
+	return HK_NULL;
+}
+
+// Equal compacted streams only hold the same geometry if they are decoded with the same ranges
+static bool quantizationRangesEqual(const hkxNode* nodeA, const hkxNode* nodeB)
+{
+	const hkxAttributeGroup* groupA = findAttributeGroup(nodeA, "hkVertexQuantization");
+	const hkxAttributeGroup* groupB = findAttributeGroup(nodeB, "hkVertexQuantization");
+	if (!groupA || !groupB)
+	{
+		return groupA == groupB;
+	}
+
+	if (groupA->m_attributes.getSize() != groupB->m_attributes.getSize())
+	{
+		return false;
+	}
+
+	for (int a = 0; a < groupA->m_attributes.getSize(); a++)
+	{
+		const hkxAttribute& attributeA = groupA->m_attributes[a];
+		const hkxAttribute& attributeB = groupB->m_attributes[a];
+		const hkxAnimatedVector* vectorA = static_cast<const hkxAnimatedVector*>(attributeA.m_value.val());
+		const hkxAnimatedVector* vectorB = static_cast<const hkxAnimatedVector*>(attributeB.m_value.val());
+
+		if (hkString::strCmp(attributeA.m_name, attributeB.m_name) != 0 ||
+			vectorA->m_vectors.getSize() != vectorB->m_vectors.getSize() ||
+			hkString::memCmp(vectorA->m_vectors.begin(), vectorB->m_vectors.begin(), vectorA->m_vectors.getSize() * sizeof(hkReal)) != 0)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int getMeshSectionByteSize(hkxMeshSection* section)
+{
+	hkxVertexBuffer* vb = section->m_vertexBuffer;
+	const hkxVertexDescription& desc = vb->getVertexDesc();
+
+	int vertexSize = 0;
+	for (int d = 0; d < desc.m_decls.getSize(); d++)
+	{
+		vertexSize += getElementByteSize(desc.m_decls[d]);
+	}
+
+	int byteSize = vertexSize * vb->getNumVertices();
+	for (int b = 0; b < section->m_indexBuffers.getSize(); b++)
+	{
+		byteSize += section->m_indexBuffers[b]->m_indices16.getSize() * sizeof(hkUint16);
+		byteSize += section->m_indexBuffers[b]->m_indices32.getSize() * sizeof(hkUint32);
+	}
+	return byteSize;
+}
+
+void FbxToHkxConverter::shareIdenticalMeshBuffers()
+{
+	// Every converted section of the scene with the node that holds its quantization ranges
+	hkArray<hkxMeshSection*> sections;
+	hkArray<const hkxNode*> sectionNodes;
+	for (int i = 0; i < m_meshSectionJobs.getSize(); i++)
+	{
+		const MeshSectionJob* job = m_meshSectionJobs[i];
+		sections.pushBack(job->m_section);
+		sectionNodes.pushBack(job->m_node);
+
+		for (int level = 0; level < job->m_lodNodes.getSize(); level++)
+		{
+			const hkxNode* lodNode = job->m_lodNodes[level];
+			const hkxMesh* lodMesh = job->m_skinBinding ?
+				static_cast<const hkxSkinBinding*>(lodNode->m_object.val())->m_mesh.val() :
+				static_cast<const hkxMesh*>(lodNode->m_object.val());
+			sections.pushBack(lodMesh->m_sections[0]);
+			sectionNodes.pushBack(lodNode);
+		}
+	}
+
+	// Buckets are chained through nextInBucket like in weldVertices
+	hkPointerMap<hkUlong, int> bucketHeads;
+	hkArray<int> uniqueSections;
+	hkArray<int> nextInBucket;
+
+	int numSharedSections = 0;
+	int savedBytes = 0;
+	for (int s = 0; s < sections.getSize(); s++)
+	{
+		hkxMeshSection* section = sections[s];
+		const hkUlong key = hashMeshSectionContent(section) & 0x7fffffff;
+
+		int match = -1;
+		for (int u = bucketHeads.getWithDefault(key, -1); u >= 0; u = nextInBucket[u])
+		{
+			const int candidate = uniqueSections[u];
+			if (quantizationRangesEqual(sectionNodes[candidate], sectionNodes[s]) && meshSectionContentsEqual(sections[candidate], section))
+			{
+				match = candidate;
+				break;
+			}
+		}
+
+		if (match < 0)
+		{
+			nextInBucket.pushBack(bucketHeads.getWithDefault(key, -1));
+			bucketHeads.insert(key, uniqueSections.getSize());
+			uniqueSections.pushBack(s);
+			continue;
+		}
+
+		numSharedSections++;
+		savedBytes += getMeshSectionByteSize(section);
+
+		section->m_vertexBuffer = sections[match]->m_vertexBuffer;
+		for (int b = 0; b < section->m_indexBuffers.getSize(); b++)
+		{
+			section->m_indexBuffers[b] = sections[match]->m_indexBuffers[b];
+		}
+	}
+
+	if (numSharedSections > 0)
+	{
+		printf("Geometry deduplication: %d of %d sections share buffers, %d bytes saved\n", numSharedSections, sections.getSize(), savedBytes);
+	}
+}
+
+void HK_CALL FbxToHkxConverter::processMeshSectionJob(void* converter, int jobIndex)
+{
+	FbxToHkxConverter* self = static_cast<FbxToHkxConverter*>(converter);
+	MeshSectionJob& job = *self->m_meshSectionJobs[jobIndex];
+	hkxMeshSection* section = job.m_section;
+
+	// fillBuffers may have stopped half way through the section
+	if (self->isCancelled())
+	{
+		return;
+	}
+
+	FbxToHkxTraceScope traceScope("processMeshSection", job.m_meshName);
+
+	if (job.m_triangleSmoothingGroups.getSize() > 0)
+	{
+		generateNormals(section, job.m_vertexControlPoints, job.m_triangleSmoothingGroups);
+	}
+
+	for (int t = 0; t < job.m_tangentUvSets.getSize(); t++)
+	{
+		generateTangents(section, job.m_tangentUvSets[t]);
+	}
+
+	// LODs are simplified from the full section before it gets optimized and compacted
+	hkArray<hkxMeshSection*> lodSections;
+	for (int level = 0; level < self->m_options.m_lodTargetRatios.getSize(); level++)
+	{
+		hkStringBuf lodName;
+		lodName.printf("%s_LOD%d", job.m_meshName.cString(), level + 1);
+
+		hkReal error;
+		hkxMeshSection* lodSection = createLodSection(section, self->m_options.m_lodTargetRatios[level], lodName.cString(), error, job.m_log);
+		lodSections.pushBack(lodSection);
+
+		hkxNode* lodNode = new hkxNode();
+		lodNode->m_name = lodName.cString();
+		lodNode->m_keyFrames.setSize(job.m_scene->m_numFrames > 1 ? 2 : 1, hkMatrix4::getIdentity());
+		job.m_lodNodes.pushBack(lodNode);
+		lodNode->removeReference();
+	}
+
+	// Maps each vertex of the section back to the vertex written by fillBuffers
+	hkArray<int> outputToInput;
+	const bool hasBlendShapes = job.m_blendShapeTargets.getSize() > 0;
+
+	if (self->m_options.m_optimizeIndexBuffers)
+	{
+		// Vertices of different control points have to stay separate for the blend shapes to move them independently
+		self->optimizeMeshSection(section, job.m_meshName, hasBlendShapes ? &job.m_vertexControlPoints : HK_NULL, outputToInput, job.m_log);
+	}
+	else
+	{
+		outputToInput.setSize(section->m_vertexBuffer->getNumVertices());
+		for (int v = 0; v < outputToInput.getSize(); v++)
+		{
+			outputToInput[v] = v;
+		}
+	}
+
+	if (hasBlendShapes)
+	{
+		self->createBlendShapeAnimations(section, job, outputToInput, job.m_log);
+	}
+
+	if (self->m_options.m_normalFormat != NORMAL_FORMAT_FLOAT32 ||
+		self->m_options.m_texCoordFormat != TEXCOORD_FORMAT_FLOAT32 ||
+		self->m_options.m_positionFormat != POSITION_FORMAT_FLOAT32)
+	{
+		self->compactMeshSection(section, job.m_node, job.m_meshName, job.m_log);
+	}
+
+	for (int level = 0; level < lodSections.getSize(); level++)
+	{
+		hkxMeshSection* lodSection = lodSections[level];
+		hkxNode* lodNode = job.m_lodNodes[level];
+
+		if (self->m_options.m_optimizeIndexBuffers)
+		{
+			hkArray<int> lodOutputToInput;
+			self->optimizeMeshSection(lodSection, lodNode->m_name, HK_NULL, lodOutputToInput, job.m_log);
+		}
+
+		if (self->m_options.m_normalFormat != NORMAL_FORMAT_FLOAT32 ||
+			self->m_options.m_texCoordFormat != TEXCOORD_FORMAT_FLOAT32 ||
+			self->m_options.m_positionFormat != POSITION_FORMAT_FLOAT32)
+		{
+			self->compactMeshSection(lodSection, lodNode, lodNode->m_name, job.m_log);
+		}
+
+		hkxMesh* lodMesh = new hkxMesh();
+		lodMesh->m_sections.pushBack(lodSection);
+		lodSection->removeReference();
+
+		// Skinned LODs get their own binding to the same bones
+		if (job.m_skinBinding)
+		{
+			hkxSkinBinding* lodSkin = new hkxSkinBinding();
+			lodSkin->m_mesh = lodMesh;
+			lodSkin->m_nodeNames = job.m_skinBinding->m_nodeNames;
+			lodSkin->m_bindPose = job.m_skinBinding->m_bindPose;
+			lodSkin->m_initSkinTransform = job.m_skinBinding->m_initSkinTransform;
+			lodNode->m_object = lodSkin;
+			lodSkin->removeReference();
+		}
+		else
+		{
+			lodNode->m_object = lodMesh;
+		}
+		lodMesh->removeReference();
+	}
+}
+
+void FbxToHkxConverter::processMeshSectionJobs()
+{
+	FbxToHkxThreadPool::processJobs(processMeshSectionJob, this, m_meshSectionJobs.getSize(), m_options.m_numThreads);
+
+	// The scene is discarded, so the unprocessed sections are left as they are
+	if (isCancelled())
+	{
+		for (int i = 0; i < m_meshSectionJobs.getSize(); i++)
+		{
+			delete m_meshSectionJobs[i];
+		}
+		m_meshSectionJobs.clear();
+		m_meshInstances.clear();
+		return;
+	}
+
+	// The jobs finish in any order, so their reports are printed here to keep the output deterministic
+	for (int i = 0; i < m_meshSectionJobs.getSize(); i++)
+	{
+		printf("%s", m_meshSectionJobs[i]->m_log.cString());
+	}
+
+	// Sections are compared once all of them have been compacted
+	shareIdenticalMeshBuffers();
+
+	int numInstancedMeshes = 0;
+	int numInstances = 0;
+
+	for (int i = 0; i < m_meshSectionJobs.getSize(); i++)
+	{
+		MeshSectionJob* job = m_meshSectionJobs[i];
+
+		// The scene and node hierarchy are only modified on the main thread
+		for (int level = 0; level < job->m_lodNodes.getSize(); level++)
+		{
+			hkxNode* lodNode = job->m_lodNodes[level];
+			job->m_node->m_children.pushBack(lodNode);
+
+			if (job->m_skinBinding)
+			{
+				hkxSkinBinding* lodSkin = static_cast<hkxSkinBinding*>(lodNode->m_object.val());
+				job->m_scene->m_meshes.pushBack(lodSkin->m_mesh);
+				job->m_scene->m_skinBindings.pushBack(lodSkin);
+			}
+			else
+			{
+				job->m_scene->m_meshes.pushBack(static_cast<hkxMesh*>(lodNode->m_object.val()));
+			}
+		}
+
+		for (int n = 0; n < job->m_instanceNodes.getSize(); n++)
+		{
+			addMeshInstanceData(*job, job->m_instanceNodes[n]);
+		}
+
+		if (job->m_instanceNodes.getSize() > 0)
+		{
+			numInstancedMeshes++;
+			numInstances += job->m_instanceNodes.getSize() + 1;
+			printf("Instanced mesh [%s]: %d nodes\n", job->m_meshName.cString(), job->m_instanceNodes.getSize() + 1);
+		}
+
+		delete job;
+	}
+
+	if (numInstancedMeshes > 0)
+	{
+		printf("Mesh instancing: %d meshes converted once for %d nodes\n", numInstancedMeshes, numInstances);
+	}
+
+	m_meshSectionJobs.clear();
+	m_meshInstances.clear();
+}
+
+// Give an instancing node the per node data that the job created for the node it was converted for
+void FbxToHkxConverter::addMeshInstanceData(MeshSectionJob& job, hkxNode* instanceNode)
+{
+	for (int g = 0; g < job.m_node->m_attributeGroups.getSize(); g++)
+	{
+		const hkxAttributeGroup& group = job.m_node->m_attributeGroups[g];
+		if (hkString::strCmp(group.m_name, "hkVertexQuantization") == 0 ||
+			hkString::strCmp(group.m_name, "hkBlendShapeTargets") == 0)
+		{
+			instanceNode->m_attributeGroups.pushBack(group);
+		}
+	}
+
+	for (int level = 0; level < job.m_lodNodes.getSize(); level++)
+	{
+		const hkxNode* lodNode = job.m_lodNodes[level];
+
+		hkStringBuf lodName;
+		lodName.printf("%s_LOD%d", instanceNode->m_name.cString(), level + 1);
+
+		hkxNode* instanceLodNode = new hkxNode();
+		instanceLodNode->m_name = lodName.cString();
+		instanceLodNode->m_keyFrames = lodNode->m_keyFrames;
+		instanceLodNode->m_attributeGroups = lodNode->m_attributeGroups;
+
+		// The LOD mesh is shared, skinned instances bind it with their own skin transform
+		if (job.m_skinBinding)
+		{
+			const hkxSkinBinding* lodSkin = static_cast<const hkxSkinBinding*>(lodNode->m_object.val());
+			const hkxSkinBinding* instanceSkin = static_cast<const hkxSkinBinding*>(instanceNode->m_object.val());
+
+			hkxSkinBinding* instanceLodSkin = new hkxSkinBinding();
+			instanceLodSkin->m_mesh = lodSkin->m_mesh;
+			instanceLodSkin->m_nodeNames = lodSkin->m_nodeNames;
+			instanceLodSkin->m_bindPose = lodSkin->m_bindPose;
+			instanceLodSkin->m_initSkinTransform = instanceSkin->m_initSkinTransform;
+			instanceLodNode->m_object = instanceLodSkin;
+			job.m_scene->m_skinBindings.pushBack(instanceLodSkin);
+			instanceLodSkin->removeReference();
+		}
+		else
+		{
+			instanceLodNode->m_object = lodNode->m_object;
+		}
+
+		instanceNode->m_children.pushBack(instanceLodNode);
+		instanceLodNode->removeReference();
+	}
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
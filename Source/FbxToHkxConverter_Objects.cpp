@@ -7,6 +7,8 @@
  */
 
 #include "FbxToHkxConverter.h"
+#include "FbxToHkxThreadPool.h"
+#include "FbxToHkxTrace.h"
 #include <Common/SceneData/Skin/hkxSkinUtils.h>
 
 template <class T>
@@ -61,6 +63,10 @@ void FbxToHkxConverter::addSpline(hkxScene *scene, FbxNode* splineNode, hkxNode*
 
 		hkxSpline::ControlPoint& controlpoint = newSpline->m_controlPoints.expandOne();
 
+		cvPtL = convertPosition(cvPtL);
+		cvPtM = convertPosition(cvPtM);
+		cvPtR = convertPosition(cvPtR);
+
 		controlpoint.m_tangentIn.set((float)cvPtL[0], (float)cvPtL[1], (float)cvPtL[2]);
 		controlpoint.m_position.set((float)cvPtM[0], (float)cvPtM[1], (float)cvPtM[2]);
 		controlpoint.m_tangentOut.set((float)cvPtR[0], (float)cvPtR[1], (float)cvPtR[2]);
@@ -80,19 +86,23 @@ void FbxToHkxConverter::addCamera(hkxScene *scene, FbxNode* cameraNode, hkxNode*
 	FbxCamera* cameraAttrib =(FbxCamera*)cameraNode->GetNodeAttribute();
 	HK_ASSERT(0x0, cameraAttrib->GetAttributeType()== FbxNodeAttribute::eCamera);
 
-	FbxDouble3 pos = cameraAttrib->Position.Get();
+	const FbxDouble3 fbxPos = cameraAttrib->Position.Get();
+	const FbxVector4 pos = convertPosition(FbxVector4(fbxPos[0], fbxPos[1], fbxPos[2]));
 	newCamera->m_from.set((hkReal)pos[0],(hkReal)pos[1],(hkReal)pos[2]);
-	FbxDouble3 up = cameraAttrib->UpVector.Get();
+	const FbxDouble3 fbxUp = cameraAttrib->UpVector.Get();
+	const FbxVector4 up = convertDirection(FbxVector4(fbxUp[0], fbxUp[1], fbxUp[2], 0.0));
 	newCamera->m_up.set((hkReal)up[0],(hkReal)up[1],(hkReal)up[2]);
-	FbxDouble3 focus = cameraAttrib->InterestPosition.Get();
+	const FbxDouble3 fbxFocus = cameraAttrib->InterestPosition.Get();
+	const FbxVector4 focus = convertPosition(FbxVector4(fbxFocus[0], fbxFocus[1], fbxFocus[2]));
 	newCamera->m_focus.set((hkReal)focus[0],(hkReal)focus[1],(hkReal)focus[2]);
 
 	const hkReal degreesToRadians  = HK_REAL_PI / 180.0f;
 	newCamera->m_fov =(hkReal)cameraAttrib->FieldOfViewY.Get()* degreesToRadians;
-	newCamera->m_near =(hkReal)cameraAttrib->NearPlane.Get();
-	newCamera->m_far =(hkReal)cameraAttrib->FarPlane.Get();
+	// The clip planes are distances in the unit of the file
+	newCamera->m_near =(hkReal)cameraAttrib->NearPlane.Get() * m_unitScale;
+	newCamera->m_far =(hkReal)cameraAttrib->FarPlane.Get() * m_unitScale;
 
-	newCamera->m_leftHanded = false;
+	newCamera->m_leftHanded = (m_options.m_targetAxisSystem.GetCoorSystem() == FbxAxisSystem::eLeftHanded);
 
 	node->m_object = newCamera;
 	scene->m_cameras.pushBack(newCamera);
@@ -106,12 +116,12 @@ void FbxToHkxConverter::addLight(hkxScene *scene, FbxNode* lightNode, hkxNode* n
 	FbxLight* lightAttrib =(FbxLight*)lightNode->GetNodeAttribute();
 	HK_ASSERT(0x0, lightAttrib->GetAttributeType()== FbxNodeAttribute::eLight);
 
-	const FbxAMatrix& lightTransform = lightNode->EvaluateLocalTransform();
-	const FbxVector4& lightPos = lightTransform.GetT();
+	const FbxAMatrix lightTransform = evaluateLocalTransform(lightNode, FbxTime());
+	const FbxVector4 lightPos = convertPosition(lightTransform.GetT());
 	newLight->m_position.set((hkReal)lightPos[0],(hkReal)lightPos[1],(hkReal)lightPos[2]);
 
 	// FBX lights point along their node's negative Y axis
-	const FbxVector4& negLightDir = lightTransform.GetRow(1);
+	const FbxVector4 negLightDir = convertDirection(lightTransform.GetRow(1));
 	newLight->m_direction.set((hkReal)-negLightDir[0],(hkReal)-negLightDir[1],(hkReal)-negLightDir[2]);
 
 	const FbxDouble3 color = lightAttrib->Color.Get();
@@ -146,14 +156,14 @@ void FbxToHkxConverter::addLight(hkxScene *scene, FbxNode* lightNode, hkxNode* n
 	case FbxLight::eDirectional:
 		{
 			newLight->m_type = hkxLight::DIRECTIONAL_LIGHT;
-			newLight->m_range =(hkReal)lightAttrib->FarAttenuationEnd.Get();
+			newLight->m_range =(hkReal)lightAttrib->FarAttenuationEnd.Get() * m_unitScale;
 			break;
 		}
 	case FbxLight::eSpot:
 		{
 			newLight->m_angle =(hkReal)lightAttrib->InnerAngle.Get();
 			newLight->m_type = hkxLight::SPOT_LIGHT;
-			newLight->m_range =(hkReal)lightAttrib->FarAttenuationEnd.Get();
+			newLight->m_range =(hkReal)lightAttrib->FarAttenuationEnd.Get() * m_unitScale;
 			break;
 		}
 	default:
@@ -192,120 +202,184 @@ static hkxMaterial* createDefaultMaterial(const char* name)
 	return mat;
 }
 
-void FbxToHkxConverter::addMesh(hkxScene *scene, FbxNode* meshNode, hkxNode* node)
+static FbxAMatrix getGeometricTransform(FbxNode* meshNode)
 {
-	FbxMesh* originalMesh = meshNode->GetMesh();
-	FbxMesh* triMesh;
+	FbxAMatrix geometricTransform;
+	FbxVector4 T = meshNode->GetGeometricTranslation(FbxNode::eSourcePivot);
+	FbxVector4 R = meshNode->GetGeometricRotation(FbxNode::eSourcePivot);
+	FbxVector4 S = meshNode->GetGeometricScaling(FbxNode::eSourcePivot);
+	geometricTransform.SetTRS(T,R,S);
+	return geometricTransform;
+}
 
-	if (!originalMesh->IsTriangleMesh())
+// Look up a per control point or per polygon vertex layer element
+template<typename ElementType>
+static FbxVector4 getLayerElementValue(const ElementType* element, int controlPointIndex, int polygonVertexIndex)
+{
+	int index;
+	switch (element->GetMappingMode())
 	{
-		 FbxGeometryConverter lGeometryConverter(m_options.m_fbxSdkManager);
-		 bool status;
-		 triMesh = lGeometryConverter.TriangulateMeshAdvance(originalMesh,status);
+	case FbxGeometryElement::eByControlPoint:
+		index = controlPointIndex;
+		break;
+	case FbxGeometryElement::eByPolygonVertex:
+		index = polygonVertexIndex;
+		break;
+	default:
+		// Other mapping modes not supported
+		return FbxVector4(0, 0, 0, 0);
+	}
 
-		 HK_ASSERT(0,status);
+	if (element->GetReferenceMode() == FbxGeometryElement::eIndexToDirect)
+	{
+		index = element->GetIndexArray().GetAt(index);
 	}
-	else
+	return element->GetDirectArray().GetAt(index);
+}
+
+void FbxToHkxConverter::addMesh(hkxScene *scene, FbxNode* meshNode, hkxNode* node)
+{
+	FbxToHkxTraceScope traceScope("addMesh", meshNode->GetName());
+
+	FbxMesh* originalMesh = meshNode->GetMesh();
+	const FbxAMatrix geometricTransform = getGeometricTransform(meshNode);
+
+	// Nodes sharing an FBX mesh with the same geometric transform reference the mesh converted for the first one
+	MeshSectionJob* instancedJob = m_meshInstances.getWithDefault(originalMesh, HK_NULL);
+	if (instancedJob && !(instancedJob->m_geometricTransform == geometricTransform))
 	{
-		triMesh = originalMesh;
+		instancedJob = HK_NULL;
 	}
 
 	hkxMesh* newMesh = HK_NULL;
 	hkxSkinBinding* newSkin = HK_NULL;
+	MeshSectionJob* job = HK_NULL;
 
-	hkArray<hkxMeshSection*> exportedSections;
+	// Get skinning info	
+	const int lSkinCount = originalMesh->GetDeformerCount(FbxDeformer::eSkin);
+	FbxSkin *skin = (FbxSkin *)originalMesh->GetDeformer(0, FbxDeformer::eSkin);
 
-	// Get material
-	hkxMaterial* sectMat = HK_NULL;
-	if (m_options.m_exportMaterials)
+	if (instancedJob)
+	{
+		newMesh = instancedJob->m_mesh;
+		newMesh->addReference();
+		instancedJob->m_instanceNodes.pushBack(node);
+	}
+	else
 	{
-		// Use original mesh for materials
-		sectMat = createMaterial(scene, originalMesh);
+		hkArray<hkxMeshSection*> exportedSections;
 
-		if (sectMat == HK_NULL)
+		// Get material
+		hkxMaterial* sectMat = HK_NULL;
+		if (m_options.m_exportMaterials)
 		{
-			sectMat = createDefaultMaterial("default_material");
+			sectMat = getMaterial(scene, originalMesh);
 		}
 
-		scene->m_materials.pushBack(sectMat);
-	}
-
-	// Get skinning info	
-	const int lSkinCount = triMesh->GetDeformerCount(FbxDeformer::eSkin);
-	FbxSkin *skin = (FbxSkin *)triMesh->GetDeformer(0, FbxDeformer::eSkin);
-
-	hkArray<float> skinControlPointWeights;
-	hkArray<int> skinIndicesToClusters;
-	{
-		if (lSkinCount>0)
+		hkArray<float> skinControlPointWeights;
+		hkArray<int> skinIndicesToClusters;
 		{
-			const int skinDataCount = triMesh->GetControlPointsCount()*4;
-			skinControlPointWeights.setSize(skinDataCount,0.0f);
-			skinIndicesToClusters.setSize(skinDataCount,-1);
-	
-			const int lClusterCount = skin->GetClusterCount();
-			for (int curClusterIndex=0; curClusterIndex < lClusterCount; ++curClusterIndex)
+			if (lSkinCount>0)
 			{
-				FbxCluster* lCluster = skin->GetCluster(curClusterIndex);
-				const int lIndexCount = lCluster->GetControlPointIndicesCount();
-				int* lIndices = lCluster->GetControlPointIndices();
-				double* lWeights = lCluster->GetControlPointWeights();
+				const int skinDataCount = originalMesh->GetControlPointsCount()*4;
+				skinControlPointWeights.setSize(skinDataCount,0.0f);
+				skinIndicesToClusters.setSize(skinDataCount,-1);
 	
-				for (int k = 0; k < lIndexCount; k++)
+				const int lClusterCount = skin->GetClusterCount();
+				for (int curClusterIndex=0; curClusterIndex < lClusterCount; ++curClusterIndex)
 				{
-					const int controlPointIndexFour = lIndices[k] * 4;
-					for(int i = controlPointIndexFour; i < controlPointIndexFour + 4; ++i)
+					FbxCluster* lCluster = skin->GetCluster(curClusterIndex);
+					const int lIndexCount = lCluster->GetControlPointIndicesCount();
+					int* lIndices = lCluster->GetControlPointIndices();
+					double* lWeights = lCluster->GetControlPointWeights();
+	
+					for (int k = 0; k < lIndexCount; k++)
 					{
-						if (skinIndicesToClusters[i] < 0)
+						const int controlPointIndexFour = lIndices[k] * 4;
+						for(int i = controlPointIndexFour; i < controlPointIndexFour + 4; ++i)
 						{
-							skinIndicesToClusters[i] = curClusterIndex;
-							skinControlPointWeights[i] =(float)lWeights[k];
-							break;
+							if (skinIndicesToClusters[i] < 0)
+							{
+								skinIndicesToClusters[i] = curClusterIndex;
+								skinControlPointWeights[i] =(float)lWeights[k];
+								break;
+							}
 						}
 					}
 				}
 			}
-		}
 	
-		// Zero unused indices
-		for (int i = 0; i <skinIndicesToClusters.getSize(); ++i)
+			// Zero unused indices
+			for (int i = 0; i <skinIndicesToClusters.getSize(); ++i)
+			{
+				if (skinIndicesToClusters[i] < 0)
+				{
+					skinIndicesToClusters[i] = 0;
+				}
+			}
+		}
+
+		// Normals are generated from polygon smoothing groups, so edge smoothing has to be converted up front
+		if (m_options.m_exportVertexTangents && originalMesh->GetElementNormal(0) == NULL)
 		{
-			if (skinIndicesToClusters[i] < 0)
+			const FbxGeometryElementSmoothing* smoothing = originalMesh->GetElementSmoothing(0);
+			if (smoothing && smoothing->GetMappingMode() == FbxGeometryElement::eByEdge)
 			{
-				skinIndicesToClusters[i] = 0;
+				FbxGeometryConverter lGeometryConverter(m_options.m_fbxSdkManager);
+				lGeometryConverter.ComputePolygonSmoothingFromEdgeSmoothing(originalMesh);
 			}
 		}
-	}
 
-	// Vertex buffer
-	hkxVertexBuffer* newVB = new hkxVertexBuffer();
-	hkxIndexBuffer* newIB = new hkxIndexBuffer();
-	fillBuffers(triMesh, meshNode, newVB, newIB, skinControlPointWeights, skinIndicesToClusters);
+		job = new MeshSectionJob();
+		job->m_scene = scene;
+		job->m_node = node;
+		job->m_skinBinding = HK_NULL;
+		job->m_meshName = meshNode->GetName();
+		job->m_geometricTransform = geometricTransform;
+
+		// Vertex buffer
+		hkxVertexBuffer* newVB = new hkxVertexBuffer();
+		hkxIndexBuffer* newIB = new hkxIndexBuffer();
+		fillBuffers(originalMesh, meshNode, newVB, newIB, skinControlPointWeights, skinIndicesToClusters, m_options.m_exportVertexTangents, *job);
+
+		hkxMeshSection* newSection = new hkxMeshSection();
+		newSection->m_material = sectMat;
+		newSection->m_vertexBuffer = newVB;
+		newSection->m_indexBuffers.setSize(1);
+		newSection->m_indexBuffers[0] = newIB;
+		exportedSections.pushBack(newSection);
+
+		if (m_options.m_exportVertexAnimations)
+		{
+			gatherBlendShapes(originalMesh, meshNode, *job);
+		}
 
-	hkxMeshSection* newSection = new hkxMeshSection();
-	newSection->m_material = sectMat;
-	newSection->m_vertexBuffer = newVB;
-	newSection->m_indexBuffers.setSize(1);
-	newSection->m_indexBuffers[0] = newIB;
-	exportedSections.pushBack(newSection);
+		// Tangent generation, optimization, blend shapes and compaction run once the whole scene has been gathered
+		job->m_section = newSection;
+		m_meshSectionJobs.pushBack(job);
 
-	if (sectMat)
-	{
-		sectMat->removeReference();
-	}
+		if (sectMat)
+		{
+			sectMat->removeReference();
+		}
 
-	newVB->removeReference();
-	newIB->removeReference();
+		newVB->removeReference();
+		newIB->removeReference();
 
-	newMesh = new hkxMesh();
-	newMesh->m_sections.setSize(exportedSections.getSize());
-	for(int cs =0; cs < newMesh->m_sections.getSize(); ++cs)
-	{
-		newMesh->m_sections[cs] = exportedSections[cs];
-		exportedSections[cs]->removeReference();
+		newMesh = new hkxMesh();
+		newMesh->m_sections.setSize(exportedSections.getSize());
+		for(int cs =0; cs < newMesh->m_sections.getSize(); ++cs)
+		{
+			newMesh->m_sections[cs] = exportedSections[cs];
+			exportedSections[cs]->removeReference();
+		}
+
+		job->m_mesh = newMesh;
+		m_meshInstances.insert(originalMesh, job);
+		scene->m_meshes.pushBack(newMesh);
 	}
 
-	// Add skin bindings
+	// Add skin bindings, every instance needs its own since the skin transform is per node
 	if (lSkinCount > 0)
 	{
 		newSkin = new hkxSkinBinding();
@@ -322,35 +396,218 @@ void FbxToHkxConverter::addMesh(hkxScene *scene, FbxNode* meshNode, hkxNode* nod
 
 			newSkin->m_nodeNames[curClusterIndex] = lCluster->GetLink()->GetName();
 
-			const FbxAMatrix lMatrix = getGlobalPosition(lCluster->GetLink(), m_startTime, m_pose, NULL);			
+			const FbxAMatrix lMatrix = convertTransform(getGlobalPosition(lCluster->GetLink(), m_startTime, m_pose, NULL));
 			convertFbxXMatrixToMatrix4(lMatrix, newSkin->m_bindPose[curClusterIndex]);
 		}
 
 		// Extract the world transform of the original, skinned mesh
 		{
-			FbxAMatrix lMatrix = meshNode->EvaluateGlobalTransform();
+			FbxAMatrix lMatrix = convertTransform(meshNode->EvaluateGlobalTransform());
 			convertFbxXMatrixToMatrix4(lMatrix, newSkin->m_initSkinTransform);
 		}
+
+		if (job)
+		{
+			job->m_skinBinding = newSkin;
+		}
+	}
+
+	if (newSkin)
+	{
+		node->m_object = newSkin;
+
+		scene->m_skinBindings.pushBack(newSkin);
+		newSkin->removeReference();
+	}
+	else
+	{
+		node->m_object = newMesh;
 	}
+	newMesh->removeReference();
+}
+
+void FbxToHkxConverter::gatherBlendShapes(FbxMesh* pMesh, FbxNode* originalNode, MeshSectionJob& job) const
+{
+	const FbxAMatrix vertexTransform = m_axisConversion * getGeometricTransform(originalNode);
+	const int numControlPoints = pMesh->GetControlPointsCount();
+	const FbxVector4* baseControlPoints = pMesh->GetControlPoints();
 
-	if (newMesh)
+	for (int d = 0, numBlendShapes = pMesh->GetDeformerCount(FbxDeformer::eBlendShape); d < numBlendShapes; d++)
 	{
- 		if (newSkin)
- 		{
- 			node->m_object = newSkin;
+		FbxBlendShape* blendShape = (FbxBlendShape*) pMesh->GetDeformer(d, FbxDeformer::eBlendShape);
+
+		for (int c = 0; c < blendShape->GetBlendShapeChannelCount(); c++)
+		{
+			FbxBlendShapeChannel* channel = blendShape->GetBlendShapeChannel(c);
+			const double* fullWeights = channel->GetTargetShapeFullWeights();
+			const int channelIndex = job.m_blendShapeChannels.getSize();
+			job.m_blendShapeChannels.pushBack(channel->GetName());
 
- 			scene->m_meshes.pushBack(newMesh);
- 			scene->m_skinBindings.pushBack(newSkin);
- 			newMesh->removeReference();
- 			newSkin->removeReference();
- 		}
- 		else
- 		{
- 			node->m_object = newMesh;
+			for (int t = 0; t < channel->GetTargetShapeCount(); t++)
+			{
+				FbxShape* shape = channel->GetTargetShape(t);
+				const int numShapeControlPoints = hkMath::min2(shape->GetControlPointsCount(), numControlPoints);
+				const FbxVector4* shapeControlPoints = shape->GetControlPoints();
 
- 			scene->m_meshes.pushBack(newMesh);
- 			newMesh->removeReference();
- 		}
+				MeshSectionJob::BlendShapeTarget& target = job.m_blendShapeTargets.expandOne();
+				target.m_channel = channelIndex;
+				target.m_fullWeight = fullWeights ? (hkReal) fullWeights[t] : 100.0f;
+
+				target.m_positionDeltas.setSize(numControlPoints);
+				for (int cp = 0; cp < numControlPoints; cp++)
+				{
+					if (cp < numShapeControlPoints)
+					{
+						const FbxVector4 delta = vertexTransform.MultT(shapeControlPoints[cp]) - vertexTransform.MultT(baseControlPoints[cp]);
+						target.m_positionDeltas[cp].set((float)delta[0], (float)delta[1], (float)delta[2], 0.0f);
+					}
+					else
+					{
+						target.m_positionDeltas[cp].setZero();
+					}
+				}
+
+				// The section has one vertex per polygon vertex, so both mapping modes can be looked up directly
+				const FbxGeometryElementNormal* leNormal = shape->GetElementNormal(0);
+				if (leNormal &&
+					(leNormal->GetMappingMode() == FbxGeometryElement::eByControlPoint ||
+					 leNormal->GetMappingMode() == FbxGeometryElement::eByPolygonVertex))
+				{
+					target.m_normals.setSize(job.m_vertexControlPoints.getSize());
+					for (int v = 0; v < target.m_normals.getSize(); v++)
+					{
+						const FbxVector4 fbxNormal = convertDirection(getLayerElementValue(leNormal, job.m_vertexControlPoints[v], v));
+						target.m_normals[v].set((float)fbxNormal[0], (float)fbxNormal[1], (float)fbxNormal[2], 0.0f);
+					}
+				}
+			}
+		}
+	}
+}
+
+// Triangulate a polygon into polygonSize - 2 triangles, writing the triangle corners (0 to polygonSize - 1) in order.
+// Convex polygons are split into a fan, concave ones are ear clipped in the plane of the polygon.
+static void triangulatePolygon(
+	const FbxVector4* controlPoints,
+	const int* polygonVertices,
+	int polygonSize,
+	hkArray<hkVector4>& projectedScratch,
+	hkArray<int>& remainingScratch,
+	hkArray<int>& cornersOut)
+{
+	cornersOut.clear();
+
+	// Newell's method gives the polygon normal for non planar polygons too
+	FbxVector4 normal(0, 0, 0, 0);
+	if (polygonSize > 3)
+	{
+		for (int j = 0; j < polygonSize; j++)
+		{
+			const FbxVector4& a = controlPoints[polygonVertices[j]];
+			const FbxVector4& b = controlPoints[polygonVertices[(j + 1) % polygonSize]];
+			normal[0] += (a[1] - b[1]) * (a[2] + b[2]);
+			normal[1] += (a[2] - b[2]) * (a[0] + b[0]);
+			normal[2] += (a[0] - b[0]) * (a[1] + b[1]);
+		}
+	}
+
+	// Project onto the plane that drops the dominant normal axis, flipped so the polygon winds counter clockwise
+	const hkReal absNormal[3] = { hkMath::fabs((hkReal) normal[0]), hkMath::fabs((hkReal) normal[1]), hkMath::fabs((hkReal) normal[2]) };
+	const int dropAxis = (absNormal[0] > absNormal[1]) ? (absNormal[0] > absNormal[2] ? 0 : 2) : (absNormal[1] > absNormal[2] ? 1 : 2);
+	const int uAxis = (dropAxis + 1) % 3;
+	const int vAxis = (dropAxis + 2) % 3;
+	const double orientation = normal[dropAxis] < 0.0 ? -1.0 : 1.0;
+
+	bool convex = true;
+	if (polygonSize > 3 && absNormal[dropAxis] > 0.0f)
+	{
+		const FbxVector4& origin = controlPoints[polygonVertices[0]];
+		projectedScratch.setSize(polygonSize);
+		for (int j = 0; j < polygonSize; j++)
+		{
+			const FbxVector4& p = controlPoints[polygonVertices[j]];
+			projectedScratch[j].set((hkReal) (p[uAxis] - origin[uAxis]), (hkReal) ((p[vAxis] - origin[vAxis]) * orientation), 0.0f, 0.0f);
+		}
+
+		for (int j = 0; j < polygonSize && convex; j++)
+		{
+			const hkVector4& a = projectedScratch[(j + polygonSize - 1) % polygonSize];
+			const hkVector4& b = projectedScratch[j];
+			const hkVector4& c = projectedScratch[(j + 1) % polygonSize];
+			convex = ((b(0) - a(0)) * (c(1) - a(1)) - (b(1) - a(1)) * (c(0) - a(0))) >= 0.0f;
+		}
+	}
+
+	if (convex)
+	{
+		for (int j = 1; j + 1 < polygonSize; j++)
+		{
+			cornersOut.pushBack(0);
+			cornersOut.pushBack(j);
+			cornersOut.pushBack(j + 1);
+		}
+		return;
+	}
+
+	remainingScratch.setSize(polygonSize);
+	for (int j = 0; j < polygonSize; j++)
+	{
+		remainingScratch[j] = j;
+	}
+
+	while (remainingScratch.getSize() > 3)
+	{
+		const int numRemaining = remainingScratch.getSize();
+		int ear = -1;
+		for (int j = 0; j < numRemaining && ear < 0; j++)
+		{
+			const hkVector4& a = projectedScratch[remainingScratch[(j + numRemaining - 1) % numRemaining]];
+			const hkVector4& b = projectedScratch[remainingScratch[j]];
+			const hkVector4& c = projectedScratch[remainingScratch[(j + 1) % numRemaining]];
+			if (((b(0) - a(0)) * (c(1) - a(1)) - (b(1) - a(1)) * (c(0) - a(0))) <= 0.0f)
+			{
+				continue;
+			}
+
+			// An ear must not contain any of the other remaining corners
+			bool isEar = true;
+			for (int k = 0; k < numRemaining && isEar; k++)
+			{
+				if (k == j || k == (j + 1) % numRemaining || k == (j + numRemaining - 1) % numRemaining)
+				{
+					continue;
+				}
+
+				const hkVector4& p = projectedScratch[remainingScratch[k]];
+				const hkReal ab = (b(0) - a(0)) * (p(1) - a(1)) - (b(1) - a(1)) * (p(0) - a(0));
+				const hkReal bc = (c(0) - b(0)) * (p(1) - b(1)) - (c(1) - b(1)) * (p(0) - b(0));
+				const hkReal ca = (a(0) - c(0)) * (p(1) - c(1)) - (a(1) - c(1)) * (p(0) - c(0));
+				isEar = !(ab >= 0.0f && bc >= 0.0f && ca >= 0.0f);
+			}
+
+			if (isEar)
+			{
+				ear = j;
+			}
+		}
+
+		// Self intersecting polygons have no ear left, the rest is fanned
+		if (ear < 0)
+		{
+			break;
+		}
+
+		cornersOut.pushBack(remainingScratch[(ear + numRemaining - 1) % numRemaining]);
+		cornersOut.pushBack(remainingScratch[ear]);
+		cornersOut.pushBack(remainingScratch[(ear + 1) % numRemaining]);
+		remainingScratch.removeAtAndCopy(ear);
+	}
+
+	for (int j = 1; j + 1 < remainingScratch.getSize(); j++)
+	{
+		cornersOut.pushBack(remainingScratch[0]);
+		cornersOut.pushBack(remainingScratch[j]);
+		cornersOut.pushBack(remainingScratch[j + 1]);
 	}
 }
 
@@ -360,8 +617,39 @@ void FbxToHkxConverter::fillBuffers(
 	hkxVertexBuffer* newVB,
 	hkxIndexBuffer* newIB,
 	const hkArray<float>& skinControlPointWeights,
-	const hkArray<int>& skinIndicesToClusters)
+	const hkArray<int>& skinIndicesToClusters,
+	bool exportTangents,
+	MeshSectionJob& job) const
 {
+	FbxToHkxTraceScope traceScope("fillBuffers", originalNode->GetName());
+
+	const int maxNumUVs = (int) hkxMaterial::PROPERTY_MTL_UV_ID_STAGE_MAX - (int) hkxMaterial::PROPERTY_MTL_UV_ID_STAGE0;
+	const bool generateNormals = exportTangents && pMesh->GetElementNormal(0) == NULL;
+
+	FbxStringList lUVSetNameList;
+	pMesh->GetUVSetNames(lUVSetNameList);
+	const int numTangentSets = exportTangents ? hkMath::min2(lUVSetNameList.GetCount(), maxNumUVs) : 0;
+
+	// Use the FBX tangent and binormal layers where they exist, generate the others
+	hkArray<const FbxGeometryElementTangent*> tangentLayers;
+	hkArray<const FbxGeometryElementBinormal*> binormalLayers;
+	for (int t = 0; t < numTangentSets; ++t)
+	{
+		const FbxGeometryElementTangent* leTangent = t < pMesh->GetElementTangentCount() ? pMesh->GetElementTangent(t) : HK_NULL;
+		const FbxGeometryElementBinormal* leBinormal = t < pMesh->GetElementBinormalCount() ? pMesh->GetElementBinormal(t) : HK_NULL;
+		if (leTangent && leBinormal)
+		{
+			tangentLayers.pushBack(leTangent);
+			binormalLayers.pushBack(leBinormal);
+		}
+		else
+		{
+			tangentLayers.pushBack(HK_NULL);
+			binormalLayers.pushBack(HK_NULL);
+			job.m_tangentUvSets.pushBack(t);
+		}
+	}
+
 	// Vertex buffer
 	{
 		const int lPolygonCount = pMesh->GetPolygonCount();		
@@ -369,7 +657,7 @@ void FbxToHkxConverter::fillBuffers(
 
 		desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_POSITION, hkxVertexDescription::HKX_DT_FLOAT, 3)); 
 
-		if (pMesh->GetElementNormal(0)!=NULL)
+		if (pMesh->GetElementNormal(0)!=NULL || generateNormals)
 		{
 			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_NORMAL, hkxVertexDescription::HKX_DT_FLOAT, 3));
 		}
@@ -384,23 +672,23 @@ void FbxToHkxConverter::fillBuffers(
 			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_TEXCOORD, hkxVertexDescription::HKX_DT_FLOAT, 2));
 		}
 
+		for (int t = 0; t < numTangentSets; ++t)
+		{
+			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_TANGENT, hkxVertexDescription::HKX_DT_FLOAT, 3));
+			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_BINORMAL, hkxVertexDescription::HKX_DT_FLOAT, 3));
+		}
+
 		if (skinControlPointWeights.getSize()>0 && skinIndicesToClusters.getSize()>0)
 		{
 			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_BLENDWEIGHTS, hkxVertexDescription::HKX_DT_UINT8, 4));
 			desiredVertDesc.m_decls.pushBack(hkxVertexDescription::ElementDecl(hkxVertexDescription::HKX_DU_BLENDINDICES, hkxVertexDescription::HKX_DT_UINT8, 4)); 
 		}
 
-		FbxAMatrix geometricTransform;
-		{
-			FbxNode* meshNode = originalNode;
-			FbxVector4 T = meshNode->GetGeometricTranslation(FbxNode::eSourcePivot);
-			FbxVector4 R = meshNode->GetGeometricRotation(FbxNode::eSourcePivot);
-			FbxVector4 S = meshNode->GetGeometricScaling(FbxNode::eSourcePivot);
-			geometricTransform.SetTRS(T,R,S);
-		}
+		// The geometric transform and the axis conversion in one
+		const FbxAMatrix vertexTransform = m_axisConversion * getGeometricTransform(originalNode);
 		
-		// XXX be safe, set the maximum possible vertex num... assuming triangle lists
-		const int numVertices = lPolygonCount*3; 
+		// One vertex per polygon vertex, the polygons are triangulated in the index buffer
+		const int numVertices = pMesh->GetPolygonVertexCount();
 		newVB->setNumVertices(numVertices, desiredVertDesc);
 
 		const hkxVertexDescription& vertDesc = newVB->getVertexDesc();
@@ -422,27 +710,28 @@ void FbxToHkxConverter::fillBuffers(
 		char* weightsBuf = static_cast<char*>(weightsDecl? newVB->getVertexDataPtr(*weightsDecl): HK_NULL);
 		char* indicesBuf = static_cast<char*>(indicesDecl? newVB->getVertexDataPtr(*indicesDecl): HK_NULL);
 
-		const int maxNumUVs = (int) hkxMaterial::PROPERTY_MTL_UV_ID_STAGE_MAX - (int) hkxMaterial::PROPERTY_MTL_UV_ID_STAGE0;
 		hkArray<int>::Temp textureCoordinateArrayPositions(maxNumUVs);
 		textureCoordinateArrayPositions.setSize(maxNumUVs);
 		hkString::memSet4(textureCoordinateArrayPositions.begin(), 0, textureCoordinateArrayPositions.getSize());
 
+		job.m_vertexControlPoints.setSize(numVertices);
+
 		FbxVector4* lControlPoints = pMesh->GetControlPoints(); 
 		int vertexId = 0;
-		for (int i = 0; i < lPolygonCount; i++)
+		for (int i = 0; i < lPolygonCount && !isCancelled(); i++)
 		{
 			const int lPolygonSize = pMesh->GetPolygonSize(i);
 
-			HK_ASSERT(0x0,lPolygonSize==3);
-
 			for (int j = 0; j < lPolygonSize; j++)
 			{
 				const int lControlPointIndex = pMesh->GetPolygonVertex(i, j);
+
+				job.m_vertexControlPoints[vertexId] = lControlPointIndex;
 				
 				if (posBuf)
 				{
 					FbxVector4 fbxPos = lControlPoints[lControlPointIndex];
-					fbxPos = geometricTransform.MultT(fbxPos);
+					fbxPos = vertexTransform.MultT(fbxPos);
 
 					float* _pos = (float*)(posBuf);
 					_pos[0] = (float)fbxPos[0];
@@ -452,7 +741,14 @@ void FbxToHkxConverter::fillBuffers(
 					posBuf += posStride;
 				}
 
-				if (normBuf)
+				if (normBuf && generateNormals)
+				{
+					// No normal layer, generateNormals() fills the slot in on the worker
+					float* _normal =(float*)(normBuf);
+					_normal[0] = _normal[1] = _normal[2] = _normal[3] = 0;
+					normBuf += normStride;
+				}
+				else if (normBuf)
 				{
 					FbxVector4 fbxNormal;
 					FbxGeometryElementNormal* leNormal = pMesh->GetElementNormal(0);
@@ -496,6 +792,8 @@ void FbxToHkxConverter::fillBuffers(
 						}
 					}
 
+					fbxNormal = convertDirection(fbxNormal);
+
 					float* _normal =(float*)(normBuf);
 					_normal[0] = (float)fbxNormal[0];
 					_normal[1] = (float)fbxNormal[1];
@@ -504,9 +802,6 @@ void FbxToHkxConverter::fillBuffers(
 					normBuf += normStride;
 				}				
 
-				FbxStringList lUVSetNameList;
-				pMesh->GetUVSetNames(lUVSetNameList);
-
 				// Tex coord UV channels
 				for(int t = 0, numUVs = hkMath::min2(lUVSetNameList.GetCount(), maxNumUVs); t < numUVs; ++t)
 				{
@@ -569,6 +864,31 @@ void FbxToHkxConverter::fillBuffers(
 					textureCoordinateArrayPositions[t] += texCoordStride;
 				}
 
+				// Tangents and binormals from the FBX layers, the generated ones are filled in later
+				for (int t = 0; t < numTangentSets; ++t)
+				{
+					if (!tangentLayers[t])
+					{
+						continue;
+					}
+
+					const hkxVertexDescription::ElementDecl* tangentDecl = vertDesc.getElementDecl(hkxVertexDescription::HKX_DU_TANGENT, t);
+					const hkxVertexDescription::ElementDecl* binormalDecl = vertDesc.getElementDecl(hkxVertexDescription::HKX_DU_BINORMAL, t);
+
+					const FbxVector4 fbxTangent = convertDirection(getLayerElementValue(tangentLayers[t], lControlPointIndex, vertexId));
+					const FbxVector4 fbxBinormal = convertDirection(getLayerElementValue(binormalLayers[t], lControlPointIndex, vertexId));
+
+					float* _tangent = (float*)(static_cast<char*>(newVB->getVertexDataPtr(*tangentDecl)) + vertexId * tangentDecl->m_byteStride);
+					_tangent[0] = (float)fbxTangent[0];
+					_tangent[1] = (float)fbxTangent[1];
+					_tangent[2] = (float)fbxTangent[2];
+
+					float* _binormal = (float*)(static_cast<char*>(newVB->getVertexDataPtr(*binormalDecl)) + vertexId * binormalDecl->m_byteStride);
+					_binormal[0] = (float)fbxBinormal[0];
+					_binormal[1] = (float)fbxBinormal[1];
+					_binormal[2] = (float)fbxBinormal[2];
+				}
+
  				if (colorBuf)
  				{
  					FbxGeometryElementVertexColor* leVtxc = pMesh->GetElementVertexColor(0);
@@ -679,22 +999,69 @@ void FbxToHkxConverter::fillBuffers(
 		} // For polygonCount
 	}
 
-	// Index buffer... assumes triangle list for now
+	// Index buffer
 	{
+		const int lPolygonCount = pMesh->GetPolygonCount();
+		const FbxVector4* lControlPoints = pMesh->GetControlPoints();
+		const int* lPolygonVertices = pMesh->GetPolygonVertices();
+		const bool use16BitIndices = pMesh->GetPolygonVertexCount() <= 0xffff;
+
+		// Without smoothing information the whole mesh is smooth
+		const FbxGeometryElementSmoothing* leSmoothing = pMesh->GetElementSmoothing(0);
+		if (leSmoothing && leSmoothing->GetMappingMode() != FbxGeometryElement::eByPolygon)
+		{
+			leSmoothing = HK_NULL;
+		}
+
 		newIB->m_indexType = hkxIndexBuffer::INDEX_TYPE_TRI_LIST;
 		newIB->m_vertexBaseOffset = 0;
-		newIB->m_length = pMesh->GetPolygonCount()* 3;
-		newIB->m_indices16.setSize(newIB->m_length);
 
-		hkUint16* curIndex = newIB->m_indices16.begin();
-		for(int i = 0, vertexId = 0; i < pMesh->GetPolygonCount(); i++)
+		hkArray<hkVector4> projectedScratch;
+		hkArray<int> remainingScratch;
+		hkArray<int> corners;
+		for (int i = 0; i < lPolygonCount && !isCancelled(); i++)
 		{
-			for(int j = 0; j < 3; j++)
+			const int lPolygonStart = pMesh->GetPolygonVertexIndex(i);
+			const int lPolygonSize = pMesh->GetPolygonSize(i);
+			if (lPolygonSize < 3)
 			{
-				*curIndex =(hkUint16)vertexId++;
-				curIndex++;
+				continue;
+			}
+
+			triangulatePolygon(lControlPoints, lPolygonVertices + lPolygonStart, lPolygonSize, projectedScratch, remainingScratch, corners);
+
+			for (int c = 0; c < corners.getSize(); c++)
+			{
+				// A change of handedness mirrors the mesh, so the second and third corner of each triangle are swapped
+				const int corner = (m_flipWinding && (c % 3) != 0) ? (c - (c % 3)) + 3 - (c % 3) : c;
+				const int vertexId = lPolygonStart + corners[corner];
+				if (use16BitIndices)
+				{
+					newIB->m_indices16.pushBack((hkUint16) vertexId);
+				}
+				else
+				{
+					newIB->m_indices32.pushBack((hkUint32) vertexId);
+				}
+			}
+
+			if (generateNormals)
+			{
+				int group = 1;
+				if (leSmoothing)
+				{
+					const int id = (leSmoothing->GetReferenceMode() == FbxGeometryElement::eIndexToDirect) ? leSmoothing->GetIndexArray().GetAt(i) : i;
+					group = leSmoothing->GetDirectArray().GetAt(id);
+				}
+
+				for (int t = 0; t < corners.getSize() / 3; t++)
+				{
+					job.m_triangleSmoothingGroups.pushBack(group);
+				}
 			}
 		}
+
+		newIB->m_length = use16BitIndices ? newIB->m_indices16.getSize() : newIB->m_indices32.getSize();
 	}
 }
 
@@ -784,7 +1151,101 @@ void FbxToHkxConverter::convertTexture(hkxScene *scene, FbxSurfaceMaterial* fbxM
 		convertedTexture->removeReference();
 		stage.m_usageHint = textureType;
 		stage.m_tcoordChannel = uvSetIndex;
+
+		if (m_options.m_textureBakePath)
+		{
+			queueTextureBake(static_cast<hkxTextureFile*>(convertedTexture), textureType);
+		}
+	}
+}
+
+void FbxToHkxConverter::queueTextureBake(hkxTextureFile* texture, hkxMaterial::TextureType textureType)
+{
+	// A texture has a single file, so the first stage that uses it decides how it is baked
+	if (m_queuedTextures.getWithDefault(texture, -1) >= 0)
+	{
+		return;
+	}
+
+	FbxToHkxTextureBaker::Usage usage = FbxToHkxTextureBaker::USAGE_LINEAR;
+	if (textureType == hkxMaterial::TEX_NORMAL)
+	{
+		usage = FbxToHkxTextureBaker::USAGE_NORMAL;
+	}
+	else if (textureType == hkxMaterial::TEX_DIFFUSE || textureType == hkxMaterial::TEX_SPECULAR ||
+			 textureType == hkxMaterial::TEX_EMISSIVE || textureType == hkxMaterial::TEX_REFLECTION)
+	{
+		usage = FbxToHkxTextureBaker::USAGE_COLOR;
 	}
+
+	// Different FBX textures often reference the same image
+	int jobIndex = -1;
+	for (int i = 0; i < m_textureBakeJobs.getSize() && jobIndex < 0; i++)
+	{
+		if (m_textureBakeJobs[i]->m_usage == usage && hkString::strCasecmp(m_textureBakeJobs[i]->m_sourceFilename, texture->m_filename) == 0)
+		{
+			jobIndex = i;
+		}
+	}
+
+	if (jobIndex < 0)
+	{
+		TextureBakeJob* job = new TextureBakeJob();
+		job->m_sourceFilename = texture->m_filename;
+		job->m_usage = usage;
+		job->m_result = FbxToHkxTextureBaker::RESULT_FAILED;
+		jobIndex = m_textureBakeJobs.getSize();
+		m_textureBakeJobs.pushBack(job);
+	}
+
+	m_textureBakeJobs[jobIndex]->m_textures.pushBack(texture);
+	m_queuedTextures.insert(texture, jobIndex);
+}
+
+void HK_CALL FbxToHkxConverter::bakeTextureJob(void* converter, int jobIndex)
+{
+	FbxToHkxConverter* self = static_cast<FbxToHkxConverter*>(converter);
+	TextureBakeJob& job = *self->m_textureBakeJobs[jobIndex];
+	FbxToHkxTraceScope traceScope("bakeTexture", job.m_sourceFilename);
+
+	hkStringBuf bakedFilename;
+	hkStringBuf description;
+	job.m_result = FbxToHkxTextureBaker::bakeTexture(job.m_sourceFilename, self->m_options.m_textureBakePath, job.m_usage, bakedFilename, description);
+	job.m_bakedFilename = bakedFilename.cString();
+	job.m_description = description.cString();
+}
+
+void FbxToHkxConverter::bakeTextures()
+{
+	FbxToHkxThreadPool::processJobs(bakeTextureJob, this, m_textureBakeJobs.getSize(), m_options.m_numThreads);
+
+	int numResults[FbxToHkxTextureBaker::RESULT_FAILED + 1] = { 0, 0, 0, 0 };
+	for (int i = 0; i < m_textureBakeJobs.getSize(); i++)
+	{
+		const TextureBakeJob& job = *m_textureBakeJobs[i];
+		numResults[job.m_result]++;
+
+		if (job.m_result == FbxToHkxTextureBaker::RESULT_BAKED || job.m_result == FbxToHkxTextureBaker::RESULT_CACHED)
+		{
+			for (int t = 0; t < job.m_textures.getSize(); t++)
+			{
+				job.m_textures[t]->m_filename = job.m_bakedFilename;
+			}
+		}
+
+		if (job.m_result == FbxToHkxTextureBaker::RESULT_FAILED)
+		{
+			HK_WARN(0x0, "Could not bake texture " << job.m_sourceFilename << ": " << job.m_description);
+		}
+		else
+		{
+			printf("Texture [%s]: %s\n", job.m_sourceFilename.cString(), job.m_description.cString());
+		}
+	}
+
+	printf("Textures: %d baked, %d unchanged, %d skipped, %d failed\n",
+		numResults[FbxToHkxTextureBaker::RESULT_BAKED], numResults[FbxToHkxTextureBaker::RESULT_CACHED],
+		numResults[FbxToHkxTextureBaker::RESULT_SKIPPED], numResults[FbxToHkxTextureBaker::RESULT_FAILED]);
 }
 
 void FbxToHkxConverter::convertTextures(hkxScene *scene, FbxSurfaceMaterial* fbxMat, const FbxStringList& uvSetNames, hkxMaterial* mat)
@@ -807,64 +1268,108 @@ void FbxToHkxConverter::convertTextures(hkxScene *scene, FbxSurfaceMaterial* fbx
 	}
 }
 
-hkxMaterial* FbxToHkxConverter::createMaterial(hkxScene *scene, FbxMesh* pMesh)
+hkxMaterial* FbxToHkxConverter::getMaterial(hkxScene *scene, FbxMesh* pMesh)
 {
-	hkxMaterial* mat = HK_NULL;
-	FbxSurfaceMaterial *lMaterial = 0;
 	FbxNode* lNode = pMesh->GetNode();
 
-	int lMaterialCount = 0;
-	if (lNode)
+	// Currently assuming just one material per mesh
+	FbxSurfaceMaterial* lMaterial = (lNode && lNode->GetMaterialCount() > 0) ? lNode->GetMaterial(0) : HK_NULL;
+
+	// Textures select their UV set by name, so a material is only reused for meshes with the same UV set names
+	FbxStringList lUVSetNameList;
+	pMesh->GetUVSetNames(lUVSetNameList);
+	hkStringBuf uvSetNames;
+	for (int i = 0; i < lUVSetNameList.GetCount(); i++)
 	{
-		lMaterialCount = lNode->GetMaterialCount();
+		uvSetNames += lUVSetNameList.GetStringAt(i);
+		uvSetNames += ";";
 	}
 
-	// Currently assuming just one material per mesh
-	if (lMaterialCount > 0)
+	// Meshes without a material all share one default material
+	int cacheIndex = lMaterial ? m_materialCacheHeads.getWithDefault(lMaterial, -1) : m_defaultMaterialIndex;
+	while (cacheIndex >= 0 && lMaterial && hkString::strCmp(m_materialCache[cacheIndex].m_uvSetNames, uvSetNames.cString()) != 0)
 	{
-		lMaterial = lNode->GetMaterial(0);
-		mat = createDefaultMaterial(lMaterial->GetName());
-
-		if (lMaterial->GetClassId().Is(FbxSurfacePhong::ClassId))
-		{			
-			FbxSurfacePhong* phongMaterial = (FbxSurfacePhong *)lMaterial;
+		cacheIndex = m_materialCache[cacheIndex].m_next;
+	}
 
-			const float transparency =  1.0f - static_cast<float>(phongMaterial->TransparencyFactor.Get());
+	if (cacheIndex < 0)
+	{
+		hkxMaterial* mat = lMaterial ? createMaterial(scene, lMaterial, lUVSetNameList) : createDefaultMaterial("default_material");
 
-			convertPropertyToVector4(phongMaterial->Ambient, mat->m_ambientColor);
-			convertPropertyToVector4(phongMaterial->Diffuse, mat->m_diffuseColor, transparency);
-			convertPropertyToVector4(phongMaterial->Specular, mat->m_specularColor, transparency);
-			convertPropertyToVector4(phongMaterial->Emissive, mat->m_emissiveColor);
+		ConvertedMaterial& converted = m_materialCache.expandOne();
+		converted.m_material = mat;
+		converted.m_uvSetNames = uvSetNames.cString();
+		converted.m_scene = HK_NULL;
+		mat->removeReference();
 
-			mat->m_specularExponent = static_cast<hkReal>( phongMaterial->Shininess.Get() );
-			mat->m_specularMultiplier = static_cast<hkReal>( phongMaterial->SpecularFactor.Get() );
-		}
-		else if (lMaterial->GetClassId().Is(FbxSurfaceLambert::ClassId))
+		cacheIndex = m_materialCache.getSize() - 1;
+		if (lMaterial)
 		{
-			FbxSurfaceLambert* lamberMaterial = (FbxSurfaceLambert *)lMaterial;
-
-			const float transparency = static_cast<float>( lamberMaterial->TransparencyFactor.Get() );
-
-			convertPropertyToVector4(lamberMaterial->Ambient, mat->m_ambientColor);
-			convertPropertyToVector4(lamberMaterial->Diffuse, mat->m_diffuseColor, transparency);			
-			convertPropertyToVector4(lamberMaterial->Emissive, mat->m_emissiveColor);
+			converted.m_next = m_materialCacheHeads.getWithDefault(lMaterial, -1);
+			m_materialCacheHeads.insert(lMaterial, cacheIndex);
 		}
 		else
 		{
-			// TODO: create from shaders
-			HK_WARN(0x0, "Material \"" << mat->m_name << "\" is of an unsupported type. Expecting Phong or Lambert.");
-			lMaterial = 0;
+			converted.m_next = -1;
+			m_defaultMaterialIndex = cacheIndex;
 		}
+	}
+	else
+	{
+		m_numReusedMaterials++;
+	}
 
-		// Extract texture stage info
-		if (lMaterial)
-		{
-			// Get all UV set names from the mesh
-			FbxStringList lUVSetNameList;
-			pMesh->GetUVSetNames(lUVSetNameList);
+	// Materials are shared between the scenes of all animation stacks, but each scene lists them once
+	ConvertedMaterial& converted = m_materialCache[cacheIndex];
+	if (converted.m_scene != scene)
+	{
+		converted.m_scene = scene;
+		scene->m_materials.pushBack(converted.m_material);
+	}
 
-			convertTextures(scene, lMaterial, lUVSetNameList, mat);
-		}
+	converted.m_material->addReference();
+	return converted.m_material;
+}
+
+hkxMaterial* FbxToHkxConverter::createMaterial(hkxScene *scene, FbxSurfaceMaterial* lMaterial, const FbxStringList& lUVSetNameList)
+{
+	hkxMaterial* mat = createDefaultMaterial(lMaterial->GetName());
+
+	if (lMaterial->GetClassId().Is(FbxSurfacePhong::ClassId))
+	{			
+		FbxSurfacePhong* phongMaterial = (FbxSurfacePhong *)lMaterial;
+
+		const float transparency =  1.0f - static_cast<float>(phongMaterial->TransparencyFactor.Get());
+
+		convertPropertyToVector4(phongMaterial->Ambient, mat->m_ambientColor);
+		convertPropertyToVector4(phongMaterial->Diffuse, mat->m_diffuseColor, transparency);
+		convertPropertyToVector4(phongMaterial->Specular, mat->m_specularColor, transparency);
+		convertPropertyToVector4(phongMaterial->Emissive, mat->m_emissiveColor);
+
+		mat->m_specularExponent = static_cast<hkReal>( phongMaterial->Shininess.Get() );
+		mat->m_specularMultiplier = static_cast<hkReal>( phongMaterial->SpecularFactor.Get() );
+	}
+	else if (lMaterial->GetClassId().Is(FbxSurfaceLambert::ClassId))
+	{
+		FbxSurfaceLambert* lamberMaterial = (FbxSurfaceLambert *)lMaterial;
+
+		const float transparency = static_cast<float>( lamberMaterial->TransparencyFactor.Get() );
+
+		convertPropertyToVector4(lamberMaterial->Ambient, mat->m_ambientColor);
+		convertPropertyToVector4(lamberMaterial->Diffuse, mat->m_diffuseColor, transparency);			
+		convertPropertyToVector4(lamberMaterial->Emissive, mat->m_emissiveColor);
+	}
+	else
+	{
+		// TODO: create from shaders
+		HK_WARN(0x0, "Material \"" << mat->m_name << "\" is of an unsupported type. Expecting Phong or Lambert.");
+		lMaterial = 0;
+	}
+
+	// Extract texture stage info
+	if (lMaterial)
+	{
+		convertTextures(scene, lMaterial, lUVSetNameList, mat);
 	}
 	return mat;
 }
@@ -0,0 +1,488 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxIndexOptimizer.h"
+
+#include <Common/Base/Math/hkMath.h>
+#include <Common/Base/Algorithm/Sort/hkSort.h>
+
+// Parameters of the vertex scoring function, see "Linear-Speed Vertex Cache Optimisation" (Tom Forsyth)
+static const int FORSYTH_CACHE_SIZE = 32;
+static const hkReal FORSYTH_CACHE_DECAY_POWER = 1.5f;
+static const hkReal FORSYTH_LAST_TRIANGLE_SCORE = 0.75f;
+static const hkReal FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+static const hkReal FORSYTH_VALENCE_BOOST_POWER = 0.5f;
+
+// Clusters created by the overdraw pass at soft boundaries are at least this many triangles long
+static const int MIN_OVERDRAW_CLUSTER_SIZE = 64;
+
+static hkReal computeForsythVertexScore(int cachePosition, int numRemainingTriangles)
+{
+	if (numRemainingTriangles == 0)
+	{
+		// No triangles left, this vertex should never be picked again
+		return -1.0f;
+	}
+
+	hkReal score = 0.0f;
+	if (cachePosition >= 0)
+	{
+		if (cachePosition < 3)
+		{
+			// The vertices of the last triangle get a fixed score so that the optimizer doesn't prefer
+			// immediately re-using the triangle's edge, which would produce strips rather than fans
+			score = FORSYTH_LAST_TRIANGLE_SCORE;
+		}
+		else
+		{
+			const hkReal scaler = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+			score = hkMath::pow(1.0f - (cachePosition - 3) * scaler, FORSYTH_CACHE_DECAY_POWER);
+		}
+	}
+
+	// Boost vertices with few remaining triangles, so that lone triangles are not left behind
+	score += FORSYTH_VALENCE_BOOST_SCALE * hkMath::pow((hkReal)numRemainingTriangles, -FORSYTH_VALENCE_BOOST_POWER);
+	return score;
+}
+
+static void computeTriangleNormal(const hkVector4& a, const hkVector4& b, const hkVector4& c, hkReal normalOut[3])
+{
+	const hkReal e0[3] = { b(0) - a(0), b(1) - a(1), b(2) - a(2) };
+	const hkReal e1[3] = { c(0) - a(0), c(1) - a(1), c(2) - a(2) };
+
+	// Unnormalized, the length is twice the triangle area
+	normalOut[0] = e0[1] * e1[2] - e0[2] * e1[1];
+	normalOut[1] = e0[2] * e1[0] - e0[0] * e1[2];
+	normalOut[2] = e0[0] * e1[1] - e0[1] * e1[0];
+}
+
+void FbxToHkxIndexOptimizer::computeCacheStatistics(const hkArray<hkUint32>& indices, int numVertices, int cacheSize, CacheStatistics& statisticsOut)
+{
+	statisticsOut.m_acmr = 0.0f;
+	statisticsOut.m_atvr = 0.0f;
+
+	const int numTriangles = indices.getSize() / 3;
+	if (numTriangles == 0)
+	{
+		return;
+	}
+
+	// A vertex is in a FIFO cache as long as fewer than cacheSize vertices were inserted after it
+	hkArray<int>::Temp cacheTimeStamps(numVertices);
+	cacheTimeStamps.setSize(numVertices, -1);
+
+	int time = 0;
+	int numMisses = 0;
+	int numReferencedVertices = 0;
+	for (int i = 0; i < numTriangles * 3; i++)
+	{
+		const int vertexIndex = (int) indices[i];
+		const int timeStamp = cacheTimeStamps[vertexIndex];
+
+		if (timeStamp < 0)
+		{
+			numReferencedVertices++;
+		}
+
+		if (timeStamp < 0 || time - timeStamp >= cacheSize)
+		{
+			cacheTimeStamps[vertexIndex] = time++;
+			numMisses++;
+		}
+	}
+
+	statisticsOut.m_acmr = (hkReal) numMisses / (hkReal) numTriangles;
+	statisticsOut.m_atvr = (hkReal) numMisses / (hkReal) hkMath::max2(numReferencedVertices, 1);
+}
+
+int FbxToHkxIndexOptimizer::removeDegenerateTriangles(hkArray<hkUint32>& indices, const hkArray<hkVector4>& positions, hkReal minArea)
+{
+	const int numTriangles = indices.getSize() / 3;
+	const hkReal minDoubleAreaSquared = (2.0f * minArea) * (2.0f * minArea);
+
+	int numKept = 0;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		const hkUint32 i0 = indices[t * 3 + 0];
+		const hkUint32 i1 = indices[t * 3 + 1];
+		const hkUint32 i2 = indices[t * 3 + 2];
+
+		if (i0 == i1 || i1 == i2 || i0 == i2)
+		{
+			continue;
+		}
+
+		hkReal normal[3];
+		computeTriangleNormal(positions[i0], positions[i1], positions[i2], normal);
+		if (normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2] <= minDoubleAreaSquared)
+		{
+			continue;
+		}
+
+		indices[numKept * 3 + 0] = i0;
+		indices[numKept * 3 + 1] = i1;
+		indices[numKept * 3 + 2] = i2;
+		numKept++;
+	}
+
+	indices.setSize(numKept * 3);
+	return numTriangles - numKept;
+}
+
+void FbxToHkxIndexOptimizer::optimizeVertexCache(hkArray<hkUint32>& indices, int numVertices)
+{
+	const int numTriangles = indices.getSize() / 3;
+	if (numTriangles < 2)
+	{
+		return;
+	}
+
+	// Build the vertex -> triangle adjacency. The first numRemainingTriangles[v] entries of each vertex's range
+	// are the triangles that haven't been emitted yet.
+	hkArray<int>::Temp numRemainingTriangles(numVertices);
+	numRemainingTriangles.setSize(numVertices, 0);
+	for (int i = 0; i < numTriangles * 3; i++)
+	{
+		numRemainingTriangles[indices[i]]++;
+	}
+
+	hkArray<int>::Temp adjacencyOffsets(numVertices + 1);
+	adjacencyOffsets.setSize(numVertices + 1);
+	adjacencyOffsets[0] = 0;
+	for (int v = 0; v < numVertices; v++)
+	{
+		adjacencyOffsets[v + 1] = adjacencyOffsets[v] + numRemainingTriangles[v];
+	}
+
+	hkArray<int>::Temp adjacency(numTriangles * 3);
+	adjacency.setSize(numTriangles * 3);
+	{
+		hkArray<int>::Temp fillCounts(numVertices);
+		fillCounts.setSize(numVertices, 0);
+		for (int i = 0; i < numTriangles * 3; i++)
+		{
+			const int v = (int) indices[i];
+			adjacency[adjacencyOffsets[v] + fillCounts[v]++] = i / 3;
+		}
+	}
+
+	hkArray<int>::Temp cachePositions(numVertices);
+	cachePositions.setSize(numVertices, -1);
+
+	hkArray<hkReal>::Temp vertexScores(numVertices);
+	vertexScores.setSize(numVertices);
+	for (int v = 0; v < numVertices; v++)
+	{
+		vertexScores[v] = computeForsythVertexScore(-1, numRemainingTriangles[v]);
+	}
+
+	hkArray<hkReal>::Temp triangleScores(numTriangles);
+	triangleScores.setSize(numTriangles);
+	hkArray<hkBool>::Temp triangleEmitted(numTriangles);
+	triangleEmitted.setSize(numTriangles, false);
+
+	int bestTriangle = -1;
+	hkReal bestScore = -1.0f;
+	for (int t = 0; t < numTriangles; t++)
+	{
+		triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+		if (triangleScores[t] > bestScore)
+		{
+			bestScore = triangleScores[t];
+			bestTriangle = t;
+		}
+	}
+
+	// The simulated cache holds the new triangle's vertices in front of the previous contents, hence the + 3
+	int cache[FORSYTH_CACHE_SIZE + 3];
+	int cacheSize = 0;
+
+	hkArray<hkUint32>::Temp optimizedIndices(numTriangles * 3);
+	optimizedIndices.setSize(numTriangles * 3);
+
+	int numEmitted = 0;
+	int scanCursor = 0;
+	while (numEmitted < numTriangles)
+	{
+		if (bestTriangle < 0)
+		{
+			// No candidate is connected to the cache anymore... continue with the next triangle in input order
+			while (triangleEmitted[scanCursor])
+			{
+				scanCursor++;
+			}
+			bestTriangle = scanCursor;
+		}
+
+		const hkUint32* triangle = &indices[bestTriangle * 3];
+		optimizedIndices[numEmitted * 3 + 0] = triangle[0];
+		optimizedIndices[numEmitted * 3 + 1] = triangle[1];
+		optimizedIndices[numEmitted * 3 + 2] = triangle[2];
+		triangleEmitted[bestTriangle] = true;
+		numEmitted++;
+
+		// Remove the triangle from its vertices' adjacency
+		for (int k = 0; k < 3; k++)
+		{
+			const int v = (int) triangle[k];
+			int* triangles = &adjacency[adjacencyOffsets[v]];
+			const int numRemaining = numRemainingTriangles[v];
+			for (int a = 0; a < numRemaining; a++)
+			{
+				if (triangles[a] == bestTriangle)
+				{
+					triangles[a] = triangles[numRemaining - 1];
+					triangles[numRemaining - 1] = bestTriangle;
+					break;
+				}
+			}
+			numRemainingTriangles[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the cache
+		int newCache[FORSYTH_CACHE_SIZE + 3];
+		int newCacheSize = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			newCache[newCacheSize++] = (int) triangle[k];
+		}
+		for (int c = 0; c < cacheSize; c++)
+		{
+			const int v = cache[c];
+			if (v != (int) triangle[0] && v != (int) triangle[1] && v != (int) triangle[2])
+			{
+				newCache[newCacheSize++] = v;
+			}
+		}
+
+		// Update the scores of all vertices that are (or just were) in the cache, and of their remaining triangles
+		bestTriangle = -1;
+		bestScore = -1.0f;
+		for (int c = 0; c < newCacheSize; c++)
+		{
+			const int v = newCache[c];
+			cachePositions[v] = (c < FORSYTH_CACHE_SIZE) ? c : -1;
+			vertexScores[v] = computeForsythVertexScore(cachePositions[v], numRemainingTriangles[v]);
+		}
+		for (int c = 0; c < newCacheSize; c++)
+		{
+			const int v = newCache[c];
+			const int* triangles = &adjacency[adjacencyOffsets[v]];
+			for (int a = 0; a < numRemainingTriangles[v]; a++)
+			{
+				const int t = triangles[a];
+				const hkReal score = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+				triangleScores[t] = score;
+				if (score > bestScore)
+				{
+					bestScore = score;
+					bestTriangle = t;
+				}
+			}
+		}
+
+		cacheSize = hkMath::min2(newCacheSize, (int) FORSYTH_CACHE_SIZE);
+		for (int c = 0; c < cacheSize; c++)
+		{
+			cache[c] = newCache[c];
+		}
+	}
+
+	indices.swap(optimizedIndices);
+}
+
+namespace
+{
+	struct OverdrawCluster
+	{
+		int m_start;
+		int m_end;
+		hkReal m_sortKey;
+	};
+
+	// Sort outward facing clusters (furthest along their normal) first, keep the input order otherwise
+	struct OverdrawClusterLess
+	{
+		HK_FORCE_INLINE hkBool32 operator()(const OverdrawCluster& a, const OverdrawCluster& b) const
+		{
+			if (a.m_sortKey != b.m_sortKey)
+			{
+				return a.m_sortKey > b.m_sortKey;
+			}
+			return a.m_start < b.m_start;
+		}
+	};
+}
+
+void FbxToHkxIndexOptimizer::optimizeOverdraw(hkArray<hkUint32>& indices, const hkArray<hkVector4>& positions, int cacheSize, hkReal threshold)
+{
+	const int numTriangles = indices.getSize() / 3;
+	if (numTriangles < 2 * MIN_OVERDRAW_CLUSTER_SIZE)
+	{
+		return;
+	}
+
+	CacheStatistics statistics;
+	computeCacheStatistics(indices, positions.getSize(), cacheSize, statistics);
+	const hkReal maxClusterAcmr = statistics.m_acmr * threshold;
+
+	// Split into clusters. Hard boundaries are where the cache simulation misses all three vertices anyway;
+	// soft boundaries are allowed as soon as the cluster is long enough and its ACMR is good enough.
+	hkArray<OverdrawCluster> clusters;
+	{
+		hkArray<int>::Temp cacheTimeStamps(positions.getSize());
+		cacheTimeStamps.setSize(positions.getSize(), -1);
+
+		int time = 0;
+		int clusterMisses = 0;
+		OverdrawCluster* currentCluster = &clusters.expandOne();
+		currentCluster->m_start = 0;
+
+		for (int t = 0; t < numTriangles; t++)
+		{
+			int triangleMisses = 0;
+			for (int k = 0; k < 3; k++)
+			{
+				const int v = (int) indices[t * 3 + k];
+				if (cacheTimeStamps[v] < 0 || time - cacheTimeStamps[v] >= cacheSize)
+				{
+					cacheTimeStamps[v] = time++;
+					triangleMisses++;
+				}
+			}
+
+			const int clusterLength = t - currentCluster->m_start;
+			const bool hardBoundary = (triangleMisses == 3);
+			const bool softBoundary = (clusterLength >= MIN_OVERDRAW_CLUSTER_SIZE) && (clusterMisses <= maxClusterAcmr * clusterLength);
+
+			if (clusterLength > 0 && (hardBoundary || softBoundary))
+			{
+				currentCluster->m_end = t;
+				currentCluster = &clusters.expandOne();
+				currentCluster->m_start = t;
+				clusterMisses = 0;
+			}
+
+			clusterMisses += triangleMisses;
+		}
+		currentCluster->m_end = numTriangles;
+	}
+
+	if (clusters.getSize() < 2)
+	{
+		return;
+	}
+
+	// Area weighted centroid of the whole mesh
+	hkReal meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	{
+		hkReal meshArea = 0.0f;
+		for (int t = 0; t < numTriangles; t++)
+		{
+			const hkVector4& a = positions[indices[t * 3 + 0]];
+			const hkVector4& b = positions[indices[t * 3 + 1]];
+			const hkVector4& c = positions[indices[t * 3 + 2]];
+			hkReal normal[3];
+			computeTriangleNormal(a, b, c, normal);
+			const hkReal area = hkMath::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				meshCentroid[k] += area * (a(k) + b(k) + c(k)) / 3.0f;
+			}
+			meshArea += area;
+		}
+		for (int k = 0; k < 3; k++)
+		{
+			meshCentroid[k] = (meshArea > 0.0f) ? meshCentroid[k] / meshArea : 0.0f;
+		}
+	}
+
+	for (int c = 0; c < clusters.getSize(); c++)
+	{
+		OverdrawCluster& cluster = clusters[c];
+		hkReal clusterCentroid[3] = { 0.0f, 0.0f, 0.0f };
+		hkReal clusterNormal[3] = { 0.0f, 0.0f, 0.0f };
+		hkReal clusterArea = 0.0f;
+
+		for (int t = cluster.m_start; t < cluster.m_end; t++)
+		{
+			const hkVector4& a = positions[indices[t * 3 + 0]];
+			const hkVector4& b = positions[indices[t * 3 + 1]];
+			const hkVector4& p = positions[indices[t * 3 + 2]];
+			hkReal normal[3];
+			computeTriangleNormal(a, b, p, normal);
+			const hkReal area = hkMath::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			for (int k = 0; k < 3; k++)
+			{
+				clusterCentroid[k] += area * (a(k) + b(k) + p(k)) / 3.0f;
+				clusterNormal[k] += normal[k];
+			}
+			clusterArea += area;
+		}
+
+		const hkReal normalLength = hkMath::sqrt(clusterNormal[0] * clusterNormal[0] + clusterNormal[1] * clusterNormal[1] + clusterNormal[2] * clusterNormal[2]);
+		cluster.m_sortKey = 0.0f;
+		if (clusterArea > 0.0f && normalLength > 0.0f)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				cluster.m_sortKey += (clusterCentroid[k] / clusterArea - meshCentroid[k]) * clusterNormal[k] / normalLength;
+			}
+		}
+	}
+
+	hkSort(clusters.begin(), clusters.getSize(), OverdrawClusterLess());
+
+	hkArray<hkUint32>::Temp sortedIndices(numTriangles * 3);
+	sortedIndices.setSize(numTriangles * 3);
+	int numWritten = 0;
+	for (int c = 0; c < clusters.getSize(); c++)
+	{
+		for (int i = clusters[c].m_start * 3; i < clusters[c].m_end * 3; i++)
+		{
+			sortedIndices[numWritten++] = indices[i];
+		}
+	}
+	HK_ASSERT(0x0, numWritten == numTriangles * 3);
+
+	indices.swap(sortedIndices);
+}
+
+int FbxToHkxIndexOptimizer::optimizeVertexFetch(hkArray<hkUint32>& indices, int numVertices, hkArray<int>& remapOut)
+{
+	remapOut.setSize(numVertices);
+	hkString::memSet4(remapOut.begin(), -1, numVertices);
+
+	int numReferencedVertices = 0;
+	for (int i = 0; i < indices.getSize(); i++)
+	{
+		int& newIndex = remapOut[indices[i]];
+		if (newIndex < 0)
+		{
+			newIndex = numReferencedVertices++;
+		}
+		indices[i] = (hkUint32) newIndex;
+	}
+
+	return numReferencedVertices;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,83 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_INDEX_OPTIMIZER
+#define HK_FBXTOHKX_INDEX_OPTIMIZER
+
+#include <Common/Base/hkBase.h>
+
+// Triangle list reordering for the post-transform vertex cache and for overdraw. All functions work on plain
+// triangle list indices so they can be shared between the mesh section optimizer and the LOD generator.
+class FbxToHkxIndexOptimizer
+{
+public:
+
+	enum
+	{
+		// Size of the FIFO cache that is simulated when reporting ACMR/ATVR and when clustering for overdraw
+		DEFAULT_CACHE_SIZE = 16
+	};
+
+	struct CacheStatistics
+	{
+		// Average cache miss ratio (transformed vertices per triangle)
+		hkReal m_acmr;
+		// Average transformed vertex ratio (transformed vertices per referenced vertex)
+		hkReal m_atvr;
+	};
+
+	// Simulate a FIFO post-transform cache of the given size over the triangle list
+	static void computeCacheStatistics(
+		const hkArray<hkUint32>& indices,
+		int numVertices,
+		int cacheSize,
+		CacheStatistics& statisticsOut);
+
+	// Remove triangles that reference the same vertex twice or whose area is below minArea. Returns the number of removed triangles.
+	static int removeDegenerateTriangles(
+		hkArray<hkUint32>& indices,
+		const hkArray<hkVector4>& positions,
+		hkReal minArea);
+
+	// Reorder triangles for the post-transform vertex cache (Tom Forsyth's linear-speed vertex cache optimization)
+	static void optimizeVertexCache(hkArray<hkUint32>& indices, int numVertices);
+
+	// Split a cache-optimized triangle list into clusters and sort them front to back (outward facing first)
+	// to reduce overdraw. A cluster boundary is only inserted while the cluster's ACMR stays within threshold times
+	// the ACMR of the whole list, so the vertex cache efficiency is mostly preserved.
+	static void optimizeOverdraw(
+		hkArray<hkUint32>& indices,
+		const hkArray<hkVector4>& positions,
+		int cacheSize,
+		hkReal threshold);
+
+	// Renumber the vertices in the order in which they are first referenced so vertex fetches are sequential.
+	// remapOut[oldIndex] receives the new vertex index, or -1 for vertices that are no longer referenced.
+	// Returns the number of referenced vertices.
+	static int optimizeVertexFetch(
+		hkArray<hkUint32>& indices,
+		int numVertices,
+		hkArray<int>& remapOut);
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
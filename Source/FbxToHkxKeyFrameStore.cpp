@@ -0,0 +1,126 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxKeyFrameStore.h"
+
+#include <Common/Base/Math/hkMath.h>
+
+void FbxToHkxKeyFrameStore::Track::addKey(const hkQsTransform& transform)
+{
+	m_rotations.pushBack(transform.getRotation());
+	transform.getTranslation().store3(m_translations.expandBy(3));
+	transform.getScale().store3(m_scales.expandBy(3));
+}
+
+bool FbxToHkxKeyFrameStore::Track::isKeyEqual(int keyIndex, int otherKeyIndex) const
+{
+	return
+		hkString::memCmp(&m_rotations[keyIndex], &m_rotations[otherKeyIndex], sizeof(hkQuaternion)) == 0 &&
+		hkString::memCmp(&m_translations[keyIndex * 3], &m_translations[otherKeyIndex * 3], 3 * sizeof(hkFloat32)) == 0 &&
+		hkString::memCmp(&m_scales[keyIndex * 3], &m_scales[otherKeyIndex * 3], 3 * sizeof(hkFloat32)) == 0;
+}
+
+void FbxToHkxKeyFrameStore::Track::getKey(int keyIndex, hkMatrix4& keyOut) const
+{
+	hkQsTransform transform;
+	transform.m_rotation = m_rotations[keyIndex];
+	transform.m_translation.load3(&m_translations[keyIndex * 3]);
+	transform.m_scale.load3(&m_scales[keyIndex * 3]);
+
+	hkFloat32 columnMajor[16];
+	transform.get4x4ColumnMajor(columnMajor);
+	keyOut.set4x4ColumnMajor(columnMajor);
+}
+
+FbxToHkxKeyFrameStore::~FbxToHkxKeyFrameStore()
+{
+	clear();
+}
+
+FbxToHkxKeyFrameStore::Track& FbxToHkxKeyFrameStore::addTrack(hkxNode* node, int numKeys)
+{
+	HK_ASSERT(0x0, m_trackIndices.getWithDefault(node, -1) == -1);
+
+	Track* track = new Track();
+	track->m_node = node;
+	track->m_rotations.reserveExactly(numKeys);
+	track->m_translations.reserveExactly(numKeys * 3);
+	track->m_scales.reserveExactly(numKeys * 3);
+
+	m_trackIndices.insert(node, m_tracks.getSize());
+	m_tracks.pushBack(track);
+	return *track;
+}
+
+void FbxToHkxKeyFrameStore::removeLastTrack()
+{
+	HK_ASSERT(0x0, m_tracks.getSize() > 0);
+
+	Track* track = m_tracks.back();
+	m_trackIndices.remove(track->m_node);
+	m_tracks.popBack();
+	delete track;
+}
+
+const FbxToHkxKeyFrameStore::Track* FbxToHkxKeyFrameStore::findTrack(const hkxNode* node) const
+{
+	const int trackIndex = m_trackIndices.getWithDefault(node, -1);
+	return (trackIndex >= 0) ? m_tracks[trackIndex] : HK_NULL;
+}
+
+void FbxToHkxKeyFrameStore::writeKeyFrames()
+{
+	if (m_tracks.getSize() > 0)
+	{
+		int numKeys = 0;
+		for (int trackIndex = 0; trackIndex < m_tracks.getSize(); trackIndex++)
+		{
+			const Track* track = m_tracks[trackIndex];
+			hkArray<hkMatrix4>& keyFrames = track->m_node->m_keyFrames;
+			HK_ASSERT(0x0, keyFrames.getSize() == 0);
+
+			keyFrames.setSize(track->getNumKeys());
+			for (int keyIndex = 0; keyIndex < track->getNumKeys(); keyIndex++)
+			{
+				track->getKey(keyIndex, keyFrames[keyIndex]);
+			}
+			numKeys += track->getNumKeys();
+		}
+
+		const int bytesPerKey = (int) (sizeof(hkQuaternion) + 6 * sizeof(hkFloat32));
+		printf("Key frames: %d animated nodes, %d keys, %d KB sampled (%d KB as matrices)\n",
+			m_tracks.getSize(), numKeys, (numKeys * bytesPerKey) / 1024, (numKeys * (int) sizeof(hkMatrix4)) / 1024);
+	}
+
+	clear();
+}
+
+void FbxToHkxKeyFrameStore::clear()
+{
+	for (int trackIndex = 0; trackIndex < m_tracks.getSize(); trackIndex++)
+	{
+		delete m_tracks[trackIndex];
+	}
+	m_tracks.clear();
+	m_trackIndices.clear();
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,77 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_KEYFRAME_STORE
+#define HK_FBXTOHKX_KEYFRAME_STORE
+
+#include <Common/Base/hkBase.h>
+#include <Common/Base/Container/PointerMap/hkPointerMap.h>
+#include <Common/SceneData/Graph/hkxNode.h>
+
+// Sampled transforms of the animated nodes of the scene being converted. The rotations, translations and scales of
+// each node are stored in separate arrays (40 bytes per key instead of the 64 of an hkMatrix4) that are allocated
+// once for all frames of the scene. The keys are only written to the nodes as matrices once they are final.
+class FbxToHkxKeyFrameStore
+{
+public:
+
+	struct Track
+	{
+		HK_DECLARE_NONVIRTUAL_CLASS_ALLOCATOR(HK_MEMORY_CLASS_SCENE_DATA, Track);
+
+		hkxNode* m_node;
+		hkArray<hkQuaternion> m_rotations;
+		// Three values (x, y, z) per key
+		hkArray<hkFloat32> m_translations;
+		hkArray<hkFloat32> m_scales;
+
+		int getNumKeys() const { return m_rotations.getSize(); }
+
+		void addKey(const hkQsTransform& transform);
+		bool isKeyEqual(int keyIndex, int otherKeyIndex) const;
+		void getKey(int keyIndex, hkMatrix4& keyOut) const;
+	};
+
+	~FbxToHkxKeyFrameStore();
+
+	// Start the track of a node with room for numKeys keys
+	Track& addTrack(hkxNode* node, int numKeys);
+
+	// Remove the last track that was added, e.g. once its node turns out to be static
+	void removeLastTrack();
+
+	// Returns HK_NULL for nodes without a track
+	const Track* findTrack(const hkxNode* node) const;
+
+	// Write the keys of each track to its node and clear the store
+	void writeKeyFrames();
+
+	void clear();
+
+private:
+
+	hkArray<Track*> m_tracks;
+	hkPointerMap<const hkxNode*, int> m_trackIndices;
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
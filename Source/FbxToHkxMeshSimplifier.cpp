@@ -0,0 +1,612 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+
+#include "FbxToHkxMeshSimplifier.h"
+
+#include <Common/Base/Math/hkMath.h>
+#include <Common/Base/Algorithm/Sort/hkSort.h>
+#include <Common/Base/Container/PointerMap/hkPointerMap.h>
+
+// Collapses are rejected if a remaining triangle's normal turns by more than ~75 degrees
+static const double MAX_FLIP_COSINE = 0.25;
+
+// Weight of the planes that keep borders and seams in place, relative to the area weighted triangle planes
+static const double BOUNDARY_WEIGHT = 10.0;
+
+namespace
+{
+	// Symmetric 4x4 error quadric: a2 ab ac ad b2 bc bd c2 cd d2, plus the accumulated plane weight
+	struct Quadric
+	{
+		double m[11];
+
+		void setZero()
+		{
+			for (int i = 0; i < 11; i++)
+			{
+				m[i] = 0.0;
+			}
+		}
+
+		void addPlane(double a, double b, double c, double d, double weight)
+		{
+			m[0] += weight * a * a; m[1] += weight * a * b; m[2] += weight * a * c; m[3] += weight * a * d;
+			m[4] += weight * b * b; m[5] += weight * b * c; m[6] += weight * b * d;
+			m[7] += weight * c * c; m[8] += weight * c * d;
+			m[9] += weight * d * d;
+			m[10] += weight;
+		}
+
+		void add(const Quadric& other)
+		{
+			for (int i = 0; i < 11; i++)
+			{
+				m[i] += other.m[i];
+			}
+		}
+
+		// Weighted mean squared distance of p to the accumulated planes
+		double evaluate(const double* p) const
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			const double error = m[0] * x * x + 2.0 * m[1] * x * y + 2.0 * m[2] * x * z + 2.0 * m[3] * x
+				+ m[4] * y * y + 2.0 * m[5] * y * z + 2.0 * m[6] * y
+				+ m[7] * z * z + 2.0 * m[8] * z
+				+ m[9];
+			return m[10] > 0.0 ? error / m[10] : 0.0;
+		}
+	};
+
+	// Triangle edge between two positions, m_a < m_b, with the vertices of the triangle at each end
+	struct Edge
+	{
+		int m_a;
+		int m_b;
+		int m_vertexA;
+		int m_vertexB;
+		int m_triangle;
+	};
+
+	struct EdgeLess
+	{
+		HK_FORCE_INLINE hkBool32 operator()(const Edge& a, const Edge& b) const
+		{
+			return a.m_a < b.m_a || (a.m_a == b.m_a && a.m_b < b.m_b);
+		}
+	};
+
+	struct Collapse
+	{
+		int m_from;
+		int m_to;
+		double m_error;
+	};
+
+	struct CollapseLess
+	{
+		HK_FORCE_INLINE hkBool32 operator()(const Collapse& a, const Collapse& b) const
+		{
+			return a.m_error < b.m_error;
+		}
+	};
+
+	enum PositionType
+	{
+		POSITION_MANIFOLD,	// Inside a surface without attribute seams, collapses along any edge
+		POSITION_BORDER,	// On an open border, collapses along the border
+		POSITION_SEAM,		// On an attribute seam, collapses along the seam with all of its vertices
+		POSITION_LOCKED		// Non-manifold, or where borders and seams meet, cross or end
+	};
+
+	enum EdgeType
+	{
+		EDGE_MANIFOLD,
+		EDGE_BORDER,
+		EDGE_SEAM,
+		EDGE_NON_MANIFOLD
+	};
+}
+
+static void getPosition(const hkVector4& position, double* positionOut)
+{
+	positionOut[0] = position(0);
+	positionOut[1] = position(1);
+	positionOut[2] = position(2);
+}
+
+static void getTriangleNormal(const double* p0, const double* p1, const double* p2, double* normalOut)
+{
+	const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+	const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+	normalOut[0] = e1[1] * e2[2] - e1[2] * e2[1];
+	normalOut[1] = e1[2] * e2[0] - e1[0] * e2[2];
+	normalOut[2] = e1[0] * e2[1] - e1[1] * e2[0];
+}
+
+static double dot3(const double* a, const double* b)
+{
+	return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// Vertices with bitwise equal positions share a position id
+static int computePositionIds(const hkArray<hkVector4>& positions, hkArray<int>& positionIdsOut)
+{
+	positionIdsOut.setSize(positions.getSize());
+
+	hkPointerMap<hkUlong, int> bucketHeads;
+	hkArray<int> nextInBucket;
+	hkArray<int> representatives;
+
+	for (int v = 0; v < positions.getSize(); v++)
+	{
+		const float xyz[3] = { positions[v](0), positions[v](1), positions[v](2) };
+		const hkUint8* bytes = reinterpret_cast<const hkUint8*>(xyz);
+		hkUint32 hash = 2166136261u;
+		for (int b = 0; b < (int) sizeof(xyz); b++)
+		{
+			hash = (hash ^ bytes[b]) * 16777619u;
+		}
+		const hkUlong key = hash & 0x7fffffff;
+
+		int id = -1;
+		for (int r = bucketHeads.getWithDefault(key, -1); r >= 0; r = nextInBucket[r])
+		{
+			if (positions[representatives[r]].allExactlyEqual<3>(positions[v]))
+			{
+				id = r;
+				break;
+			}
+		}
+
+		if (id < 0)
+		{
+			id = representatives.getSize();
+			representatives.pushBack(v);
+			nextInBucket.pushBack(bucketHeads.getWithDefault(key, -1));
+			bucketHeads.insert(key, id);
+		}
+
+		positionIdsOut[v] = id;
+	}
+
+	return representatives.getSize();
+}
+
+// Sort the triangle edges by the positions they connect and classify the runs of equal edges and the positions
+static void classifyEdges(
+	const hkArray<hkUint32>& indices,
+	const hkArray<int>& positionIds,
+	int numPositions,
+	hkArray<Edge>& edgesOut,
+	hkArray<int>& positionTypesOut)
+{
+	edgesOut.setSize(indices.getSize());
+	for (int i = 0; i < indices.getSize(); i++)
+	{
+		const int va = indices[i];
+		const int vb = indices[i - i % 3 + (i + 1) % 3];
+		const bool swap = positionIds[va] > positionIds[vb];
+		Edge& edge = edgesOut[i];
+		edge.m_vertexA = swap ? vb : va;
+		edge.m_vertexB = swap ? va : vb;
+		edge.m_a = positionIds[edge.m_vertexA];
+		edge.m_b = positionIds[edge.m_vertexB];
+		edge.m_triangle = i / 3;
+	}
+	hkSort(edgesOut.begin(), edgesOut.getSize(), EdgeLess());
+
+	hkArray<int> numBorderEdges(numPositions, 0);
+	hkArray<int> numSeamEdges(numPositions, 0);
+	hkArray<hkBool> nonManifold(numPositions, false);
+
+	for (int start = 0, end; start < edgesOut.getSize(); start = end)
+	{
+		for (end = start + 1; end < edgesOut.getSize() && edgesOut[end].m_a == edgesOut[start].m_a && edgesOut[end].m_b == edgesOut[start].m_b; end++) {}
+
+		const Edge& edge = edgesOut[start];
+		if (end - start == 1)
+		{
+			numBorderEdges[edge.m_a]++;
+			numBorderEdges[edge.m_b]++;
+		}
+		else if (end - start == 2)
+		{
+			// The triangles on either side of a seam use different vertices at one or both ends
+			const Edge& other = edgesOut[start + 1];
+			if (edge.m_vertexA != other.m_vertexA || edge.m_vertexB != other.m_vertexB)
+			{
+				numSeamEdges[edge.m_a]++;
+				numSeamEdges[edge.m_b]++;
+			}
+		}
+		else
+		{
+			nonManifold[edge.m_a] = true;
+			nonManifold[edge.m_b] = true;
+		}
+	}
+
+	positionTypesOut.setSize(numPositions);
+	for (int p = 0; p < numPositions; p++)
+	{
+		const int numBorder = numBorderEdges[p];
+		const int numSeam = numSeamEdges[p];
+		if (nonManifold[p] || (numBorder > 0 && numSeam > 0))
+		{
+			positionTypesOut[p] = POSITION_LOCKED;
+		}
+		else if (numBorder > 0)
+		{
+			positionTypesOut[p] = (numBorder == 2) ? POSITION_BORDER : POSITION_LOCKED;
+		}
+		else if (numSeam > 0)
+		{
+			positionTypesOut[p] = (numSeam == 2) ? POSITION_SEAM : POSITION_LOCKED;
+		}
+		else
+		{
+			positionTypesOut[p] = POSITION_MANIFOLD;
+		}
+	}
+}
+
+static int getEdgeType(const hkArray<Edge>& edges, int start, int end)
+{
+	if (end - start == 1)
+	{
+		return EDGE_BORDER;
+	}
+	else if (end - start == 2)
+	{
+		const bool seam = edges[start].m_vertexA != edges[start + 1].m_vertexA || edges[start].m_vertexB != edges[start + 1].m_vertexB;
+		return seam ? EDGE_SEAM : EDGE_MANIFOLD;
+	}
+	return EDGE_NON_MANIFOLD;
+}
+
+// Borders and seams only move along themselves, everything else along any manifold edge
+static bool canCollapseAlong(int positionType, int edgeType)
+{
+	switch (positionType)
+	{
+	case POSITION_MANIFOLD:	return edgeType != EDGE_NON_MANIFOLD;
+	case POSITION_BORDER:	return edgeType == EDGE_BORDER;
+	case POSITION_SEAM:		return edgeType == EDGE_SEAM;
+	default:				return false;
+	}
+}
+
+hkReal FbxToHkxMeshSimplifier::simplify(
+	hkArray<hkUint32>& indices,
+	const hkArray<hkVector4>& positions,
+	const hkArray<hkUint64>& collapseGroups,
+	int targetTriangleCount)
+{
+	const int numVertices = positions.getSize();
+	double maxError = 0.0;
+
+	// Collapses work on positions, all vertices of a position move together so seams stay intact
+	hkArray<int> positionIds;
+	const int numPositions = computePositionIds(positions, positionIds);
+
+	hkArray<double> positionCoords(numPositions * 3);
+	for (int v = 0; v < numVertices; v++)
+	{
+		getPosition(positions[v], &positionCoords[positionIds[v] * 3]);
+	}
+
+	hkArray<Edge> edges;
+	hkArray<int> positionTypes;
+	classifyEdges(indices, positionIds, numPositions, edges, positionTypes);
+
+	// Area weighted plane quadrics of the adjacent triangles
+	hkArray<Quadric> quadrics(numPositions);
+	for (int p = 0; p < numPositions; p++)
+	{
+		quadrics[p].setZero();
+	}
+	hkArray<double> triangleNormals(indices.getSize());
+	for (int t = 0; t < indices.getSize() / 3; t++)
+	{
+		const double* p0 = &positionCoords[positionIds[indices[t * 3 + 0]] * 3];
+		const double* p1 = &positionCoords[positionIds[indices[t * 3 + 1]] * 3];
+		const double* p2 = &positionCoords[positionIds[indices[t * 3 + 2]] * 3];
+
+		double* normal = &triangleNormals[t * 3];
+		getTriangleNormal(p0, p1, p2, normal);
+		const double doubleArea = hkMath::sqrt(dot3(normal, normal));
+		if (doubleArea <= 0.0)
+		{
+			continue;
+		}
+
+		normal[0] /= doubleArea;
+		normal[1] /= doubleArea;
+		normal[2] /= doubleArea;
+		const double d = -dot3(normal, p0);
+		for (int k = 0; k < 3; k++)
+		{
+			quadrics[positionIds[indices[t * 3 + k]]].addPlane(normal[0], normal[1], normal[2], d, doubleArea * 0.5);
+		}
+	}
+
+	// Planes through the border and seam edges, perpendicular to their triangles, keep them from moving sideways
+	for (int start = 0, end; start < edges.getSize(); start = end)
+	{
+		for (end = start + 1; end < edges.getSize() && edges[end].m_a == edges[start].m_a && edges[end].m_b == edges[start].m_b; end++) {}
+
+		const int edgeType = getEdgeType(edges, start, end);
+		if (edgeType != EDGE_BORDER && edgeType != EDGE_SEAM)
+		{
+			continue;
+		}
+
+		const double* pa = &positionCoords[edges[start].m_a * 3];
+		const double* pb = &positionCoords[edges[start].m_b * 3];
+		const double direction[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+		const double lengthSquared = dot3(direction, direction);
+
+		for (int e = start; e < end; e++)
+		{
+			const double* triangleNormal = &triangleNormals[edges[e].m_triangle * 3];
+			double normal[3] =
+			{
+				direction[1] * triangleNormal[2] - direction[2] * triangleNormal[1],
+				direction[2] * triangleNormal[0] - direction[0] * triangleNormal[2],
+				direction[0] * triangleNormal[1] - direction[1] * triangleNormal[0]
+			};
+			const double length = hkMath::sqrt(dot3(normal, normal));
+			if (length <= 0.0)
+			{
+				continue;
+			}
+
+			normal[0] /= length;
+			normal[1] /= length;
+			normal[2] /= length;
+			const double d = -dot3(normal, pa);
+			quadrics[edges[start].m_a].addPlane(normal[0], normal[1], normal[2], d, BOUNDARY_WEIGHT * lengthSquared);
+			quadrics[edges[start].m_b].addPlane(normal[0], normal[1], normal[2], d, BOUNDARY_WEIGHT * lengthSquared);
+		}
+	}
+
+	hkArray<int> remap(numVertices);
+	hkArray<int> counterparts(numVertices, -1);
+	hkArray<int> mappedVertices;
+	hkArray<hkBool> touched(numPositions);
+	hkArray<int> triangleOffsets(numPositions + 1);
+	hkArray<int> positionTriangles;
+	hkArray<Collapse> collapses;
+
+	for (bool firstPass = true; ; firstPass = false)
+	{
+		int numTriangles = indices.getSize() / 3;
+		if (numTriangles <= targetTriangleCount)
+		{
+			break;
+		}
+
+		if (!firstPass)
+		{
+			classifyEdges(indices, positionIds, numPositions, edges, positionTypes);
+		}
+
+		// Triangles around each position
+		for (int p = 0; p <= numPositions; p++)
+		{
+			triangleOffsets[p] = 0;
+		}
+		for (int i = 0; i < indices.getSize(); i++)
+		{
+			triangleOffsets[positionIds[indices[i]] + 1]++;
+		}
+		for (int p = 0; p < numPositions; p++)
+		{
+			triangleOffsets[p + 1] += triangleOffsets[p];
+		}
+		positionTriangles.setSize(indices.getSize());
+		{
+			hkArray<int> fill(numPositions);
+			for (int p = 0; p < numPositions; p++)
+			{
+				fill[p] = triangleOffsets[p];
+			}
+			for (int i = 0; i < indices.getSize(); i++)
+			{
+				positionTriangles[fill[positionIds[indices[i]]]++] = i / 3;
+			}
+		}
+
+		// Candidate half-edge collapses in both directions of every edge
+		collapses.clear();
+		for (int start = 0, end; start < edges.getSize(); start = end)
+		{
+			for (end = start + 1; end < edges.getSize() && edges[end].m_a == edges[start].m_a && edges[end].m_b == edges[start].m_b; end++) {}
+
+			const int edgeType = getEdgeType(edges, start, end);
+			for (int direction = 0; direction < 2; direction++)
+			{
+				const int from = direction ? edges[start].m_b : edges[start].m_a;
+				const int to = direction ? edges[start].m_a : edges[start].m_b;
+				if (!canCollapseAlong(positionTypes[from], edgeType))
+				{
+					continue;
+				}
+
+				Quadric combined = quadrics[from];
+				combined.add(quadrics[to]);
+
+				Collapse& collapse = collapses.expandOne();
+				collapse.m_from = from;
+				collapse.m_to = to;
+				collapse.m_error = hkMath::max2(combined.evaluate(&positionCoords[to * 3]), 0.0);
+			}
+		}
+
+		if (collapses.getSize() == 0)
+		{
+			break;
+		}
+		hkSort(collapses.begin(), collapses.getSize(), CollapseLess());
+
+		for (int v = 0; v < numVertices; v++)
+		{
+			remap[v] = v;
+		}
+		for (int p = 0; p < numPositions; p++)
+		{
+			touched[p] = false;
+		}
+
+		int numCollapses = 0;
+		for (int c = 0; c < collapses.getSize() && numTriangles > targetTriangleCount; c++)
+		{
+			const Collapse& collapse = collapses[c];
+			const int from = collapse.m_from;
+			const int to = collapse.m_to;
+			if (touched[from] || touched[to])
+			{
+				continue;
+			}
+
+			// Each vertex at the collapsed position moves onto the vertex it shares an edge with at the target
+			// position. Collapses where that vertex is missing or ambiguous would tear a seam apart.
+			bool valid = true;
+			int numRemovedTriangles = 0;
+			for (int n = triangleOffsets[from]; n < triangleOffsets[from + 1] && valid; n++)
+			{
+				const int t = positionTriangles[n];
+				int fromVertex = -1;
+				int toVertex = -1;
+				for (int k = 0; k < 3; k++)
+				{
+					const int v = indices[t * 3 + k];
+					fromVertex = (positionIds[v] == from) ? v : fromVertex;
+					toVertex = (positionIds[v] == to) ? v : toVertex;
+				}
+				if (toVertex < 0)
+				{
+					continue;
+				}
+
+				numRemovedTriangles++;
+				if (counterparts[fromVertex] < 0)
+				{
+					counterparts[fromVertex] = toVertex;
+					mappedVertices.pushBack(fromVertex);
+					valid = collapseGroups[fromVertex] == collapseGroups[toVertex];
+				}
+				else
+				{
+					valid = counterparts[fromVertex] == toVertex;
+				}
+			}
+
+			// Reject collapses that flip or fold a remaining triangle
+			for (int n = triangleOffsets[from]; n < triangleOffsets[from + 1] && valid; n++)
+			{
+				const int t = positionTriangles[n];
+				const int i0 = indices[t * 3 + 0];
+				const int i1 = indices[t * 3 + 1];
+				const int i2 = indices[t * 3 + 2];
+				const int p0 = positionIds[i0];
+				const int p1 = positionIds[i1];
+				const int p2 = positionIds[i2];
+				if (p0 == to || p1 == to || p2 == to)
+				{
+					continue;
+				}
+
+				const int fromVertex = (p0 == from) ? i0 : ((p1 == from) ? i1 : i2);
+				if (counterparts[fromVertex] < 0)
+				{
+					valid = false;
+					break;
+				}
+
+				double oldNormal[3]; getTriangleNormal(&positionCoords[p0 * 3], &positionCoords[p1 * 3], &positionCoords[p2 * 3], oldNormal);
+				double newNormal[3]; getTriangleNormal(
+					&positionCoords[(p0 == from ? to : p0) * 3],
+					&positionCoords[(p1 == from ? to : p1) * 3],
+					&positionCoords[(p2 == from ? to : p2) * 3],
+					newNormal);
+				const double lengths = hkMath::sqrt(dot3(oldNormal, oldNormal) * dot3(newNormal, newNormal));
+				valid = dot3(oldNormal, newNormal) > MAX_FLIP_COSINE * lengths;
+			}
+
+			if (valid)
+			{
+				for (int m = 0; m < mappedVertices.getSize(); m++)
+				{
+					remap[mappedVertices[m]] = counterparts[mappedVertices[m]];
+				}
+				quadrics[to].add(quadrics[from]);
+				maxError = hkMath::max2(maxError, collapse.m_error);
+				numTriangles -= numRemovedTriangles;
+				numCollapses++;
+
+				// Keep the adjacency of this pass valid by not touching the neighborhood again
+				for (int n = triangleOffsets[from]; n < triangleOffsets[from + 1]; n++)
+				{
+					const int t = positionTriangles[n];
+					for (int k = 0; k < 3; k++)
+					{
+						touched[positionIds[indices[t * 3 + k]]] = true;
+					}
+				}
+			}
+
+			for (int m = 0; m < mappedVertices.getSize(); m++)
+			{
+				counterparts[mappedVertices[m]] = -1;
+			}
+			mappedVertices.clear();
+		}
+
+		if (numCollapses == 0)
+		{
+			break;
+		}
+
+		// Apply the collapses and drop the triangles that became degenerate
+		int numKept = 0;
+		for (int t = 0; t < indices.getSize() / 3; t++)
+		{
+			const hkUint32 i0 = remap[indices[t * 3 + 0]];
+			const hkUint32 i1 = remap[indices[t * 3 + 1]];
+			const hkUint32 i2 = remap[indices[t * 3 + 2]];
+			if (positionIds[i0] == positionIds[i1] || positionIds[i1] == positionIds[i2] || positionIds[i2] == positionIds[i0])
+			{
+				continue;
+			}
+			indices[numKept * 3 + 0] = i0;
+			indices[numKept * 3 + 1] = i1;
+			indices[numKept * 3 + 2] = i2;
+			numKept++;
+		}
+		indices.setSize(numKept * 3);
+	}
+
+	return (hkReal) hkMath::sqrt(maxError);
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,49 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+
+#ifndef HK_FBXTOHKX_MESH_SIMPLIFIER
+#define HK_FBXTOHKX_MESH_SIMPLIFIER
+
+#include <Common/Base/hkBase.h>
+
+// Quadric error mesh simplification used to generate LODs. Works on welded triangle list indices, where vertices that
+// share a position but differ in other attributes form an attribute seam.
+class FbxToHkxMeshSimplifier
+{
+public:
+
+	// Reduce the triangle list towards targetTriangleCount with half-edge collapses of positions, cheapest quadric
+	// error first. All vertices of a position move together onto the vertices they share an edge with, so borders
+	// and attribute seams are simplified along themselves and kept in place by extra quadric planes. Positions where
+	// seams or borders end, meet or become non-manifold are locked. Collapses that flip a triangle or join vertices
+	// of different collapseGroups (e.g. different skin weights) are rejected. Returns the largest collapse error as a
+	// distance.
+	static hkReal simplify(
+		hkArray<hkUint32>& indices,
+		const hkArray<hkVector4>& positions,
+		const hkArray<hkUint64>& collapseGroups,
+		int targetTriangleCount);
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,193 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxSceneWriter.h"
+
+#include <Common/Base/Math/hkMath.h>
+#include <Common/Base/Thread/Thread/hkThread.h>
+#include <Common/Base/System/hkBaseSystem.h>
+#include <Common/Base/Memory/System/hkMemorySystem.h>
+
+// The semaphores count every finished job until it is waited for
+static const int MAX_SEMAPHORE_COUNT = 1 << 30;
+
+FbxToHkxSceneWriter::FbxToHkxSceneWriter(int numThreads, int maxPendingJobs) :
+	m_nextJob(0), m_numPrinted(0), m_maxPendingJobs(hkMath::max2(maxPendingJobs, 1)),
+	m_jobAdded(0, MAX_SEMAPHORE_COUNT), m_jobFinished(0, MAX_SEMAPHORE_COUNT)
+{
+	for (int i = 0; i < numThreads; i++)
+	{
+		hkThread* thread = new hkThread();
+		if (thread->startThread(writerMain, this, "FbxToHkxWriter") != HK_SUCCESS)
+		{
+			delete thread;
+			break;
+		}
+		m_threads.pushBack(thread);
+	}
+
+	// The scenes share materials, textures and meshes that are referenced from both the converter and the writers
+	if (m_threads.getSize() > 0)
+	{
+		hkReferencedObject::setLockMode(hkReferencedObject::LOCK_MODE_AUTO);
+	}
+}
+
+FbxToHkxSceneWriter::~FbxToHkxSceneWriter()
+{
+	finish();
+
+	// Wake each thread once without a job so it quits
+	m_jobAdded.release(m_threads.getSize());
+	for (int i = 0; i < m_threads.getSize(); i++)
+	{
+		m_threads[i]->joinThread();
+		delete m_threads[i];
+	}
+
+	if (m_threads.getSize() > 0)
+	{
+		hkReferencedObject::setLockMode(hkReferencedObject::LOCK_MODE_NONE);
+	}
+}
+
+void FbxToHkxSceneWriter::addJob(Job* job)
+{
+	Entry* entry = new Entry();
+	entry->m_job = job;
+	entry->m_finished = false;
+
+	if (m_threads.getSize() == 0)
+	{
+		job->run(entry->m_log);
+		entry->m_finished = true;
+		m_entries.pushBack(entry);
+		printFinishedJobs(false);
+		return;
+	}
+
+	while (m_entries.getSize() - m_numPrinted >= m_maxPendingJobs)
+	{
+		printFinishedJobs(true);
+	}
+
+	{
+		hkCriticalSectionLock lock(&m_lock);
+		m_entries.pushBack(entry);
+	}
+	m_jobAdded.release();
+
+	printFinishedJobs(false);
+}
+
+void FbxToHkxSceneWriter::finish()
+{
+	while (m_numPrinted < m_entries.getSize())
+	{
+		printFinishedJobs(true);
+	}
+}
+
+void FbxToHkxSceneWriter::printFinishedJobs(bool wait)
+{
+	for (;;)
+	{
+		Entry* entry = HK_NULL;
+		{
+			hkCriticalSectionLock lock(&m_lock);
+			if (m_numPrinted < m_entries.getSize() && m_entries[m_numPrinted]->m_finished)
+			{
+				entry = m_entries[m_numPrinted];
+			}
+		}
+
+		if (!entry)
+		{
+			if (!wait || m_numPrinted == m_entries.getSize())
+			{
+				return;
+			}
+
+			// Another job finishing doesn't mean that the next one has, so check again afterwards
+			m_jobFinished.acquire();
+			continue;
+		}
+
+		printf("%s", entry->m_log.cString());
+		delete entry->m_job;
+		delete entry;
+		{
+			hkCriticalSectionLock lock(&m_lock);
+			m_entries[m_numPrinted++] = HK_NULL;
+		}
+
+		// Only wait until a single job has been printed, so the caller can continue
+		wait = false;
+	}
+}
+
+void* HK_CALL FbxToHkxSceneWriter::writerMain(void* param)
+{
+	hkMemoryRouter memoryRouter;
+	hkMemorySystem::getInstance().threadInit(memoryRouter, "FbxToHkxWriter");
+	hkBaseSystem::initThread(&memoryRouter);
+
+	static_cast<FbxToHkxSceneWriter*>(param)->runJobs();
+
+	hkBaseSystem::quitThread();
+	hkMemorySystem::getInstance().threadQuit(memoryRouter);
+	return HK_NULL;
+}
+
+void FbxToHkxSceneWriter::runJobs()
+{
+	for (;;)
+	{
+		m_jobAdded.acquire();
+
+		Entry* entry = HK_NULL;
+		{
+			hkCriticalSectionLock lock(&m_lock);
+			if (m_nextJob < m_entries.getSize())
+			{
+				entry = m_entries[m_nextJob++];
+			}
+		}
+
+		// Woken up without a job by the destructor
+		if (!entry)
+		{
+			return;
+		}
+
+		hkStringBuf log;
+		entry->m_job->run(log);
+
+		{
+			hkCriticalSectionLock lock(&m_lock);
+			entry->m_log = log;
+			entry->m_finished = true;
+		}
+		m_jobFinished.release();
+	}
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,90 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_SCENE_WRITER
+#define HK_FBXTOHKX_SCENE_WRITER
+
+#include <Common/Base/hkBase.h>
+#include <Common/Base/Thread/CriticalSection/hkCriticalSection.h>
+#include <Common/Base/Thread/Semaphore/hkSemaphore.h>
+
+class hkThread;
+
+// Saves files on writer threads while the caller keeps converting. Jobs run in any order, but the messages
+// of each job are printed in the order the jobs were added, so the output doesn't depend on the thread timing.
+class FbxToHkxSceneWriter
+{
+public:
+
+	class Job
+	{
+	public:
+
+		HK_DECLARE_CLASS_ALLOCATOR(HK_MEMORY_CLASS_SCENE_DATA);
+
+		virtual ~Job() {}
+
+		// Runs on a writer thread. Messages are appended to logOut instead of being printed.
+		virtual void run(hkStringBuf& logOut) = 0;
+	};
+
+	// Without threads the jobs run on the calling thread as they are added. At most maxPendingJobs jobs wait or
+	// run at a time, addJob blocks until one of them has finished otherwise.
+	FbxToHkxSceneWriter(int numThreads, int maxPendingJobs);
+	~FbxToHkxSceneWriter();
+
+	// Takes ownership of the job
+	void addJob(Job* job);
+
+	// Wait for all jobs and print their messages
+	void finish();
+
+private:
+
+	struct Entry
+	{
+		HK_DECLARE_NONVIRTUAL_CLASS_ALLOCATOR(HK_MEMORY_CLASS_SCENE_DATA, Entry);
+
+		Job* m_job;
+		hkStringBuf m_log;
+		bool m_finished;
+	};
+
+	static void* HK_CALL writerMain(void* param);
+	void runJobs();
+
+	// Print the messages of the finished jobs that follow the last printed one. Waits for the next job if wait is set.
+	void printFinishedJobs(bool wait);
+
+	hkArray<Entry*> m_entries;
+	int m_nextJob;
+	int m_numPrinted;
+	int m_maxPendingJobs;
+
+	hkArray<hkThread*> m_threads;
+	hkCriticalSection m_lock;
+	hkSemaphore m_jobAdded;
+	hkSemaphore m_jobFinished;
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,772 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxTextureBaker.h"
+
+#include <Common/Base/System/Io/IStream/hkIStream.h>
+#include <Common/Base/System/Io/OStream/hkOStream.h>
+#include <Common/Base/Fwd/hkwindows.h>
+#include <wincodec.h>
+
+// Changing the encoders changes the baked files, so the version is part of the cache hash
+static const hkUint32 BAKER_VERSION = 1;
+
+// Size of the table used to convert linear values back to sRGB
+static const int LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+struct Image
+{
+	int m_width;
+	int m_height;
+	hkArray<hkUint8> m_rgba;
+};
+
+static bool readFile(const char* filename, hkArray<char>& dataOut)
+{
+	hkIstream stream(filename);
+	if (!stream.isOk())
+	{
+		return false;
+	}
+
+	const int chunkSize = 64 * 1024;
+	for (;;)
+	{
+		const int size = dataOut.getSize();
+		dataOut.setSize(size + chunkSize);
+		const int numRead = stream.read(dataOut.begin() + size, chunkSize);
+		dataOut.setSize(size + hkMath::max2(numRead, 0));
+		if (numRead < chunkSize)
+		{
+			break;
+		}
+	}
+	return dataOut.getSize() > 0;
+}
+
+static bool hasExtension(const char* filename, const char* extension)
+{
+	const int length = hkString::strLen(filename);
+	const int extensionLength = hkString::strLen(extension);
+	return length >= extensionLength && hkString::strCasecmp(filename + length - extensionLength, extension) == 0;
+}
+
+//
+// Image loading
+//
+
+// Uncompressed and RLE compressed true color and grayscale TGA files, which WIC does not read
+static bool decodeTga(const hkArray<char>& data, Image& imageOut)
+{
+	const hkUint8* bytes = reinterpret_cast<const hkUint8*>(data.begin());
+	const int size = data.getSize();
+	if (size < 18 || bytes[1] != 0)
+	{
+		return false;
+	}
+
+	const int imageType = bytes[2];
+	const bool rle = imageType == 10 || imageType == 11;
+	const bool grayscale = imageType == 3 || imageType == 11;
+	if (imageType != 2 && imageType != 3 && imageType != 10 && imageType != 11)
+	{
+		return false;
+	}
+
+	const int width = bytes[12] | (bytes[13] << 8);
+	const int height = bytes[14] | (bytes[15] << 8);
+	const int bytesPerPixel = bytes[16] / 8;
+	const bool topToBottom = (bytes[17] & 0x20) != 0;
+	if (width <= 0 || height <= 0 || (grayscale ? bytesPerPixel != 1 : (bytesPerPixel != 3 && bytesPerPixel != 4)))
+	{
+		return false;
+	}
+
+	imageOut.m_width = width;
+	imageOut.m_height = height;
+	imageOut.m_rgba.setSize(width * height * 4);
+
+	int offset = 18 + bytes[0];
+	int packetRemaining = 0;
+	bool packetRepeats = false;
+	for (int p = 0; p < width * height; p++)
+	{
+		if (rle && packetRemaining == 0)
+		{
+			if (offset >= size)
+			{
+				return false;
+			}
+			packetRepeats = (bytes[offset] & 0x80) != 0;
+			packetRemaining = (bytes[offset] & 0x7f) + 1;
+			offset++;
+		}
+
+		if (offset + bytesPerPixel > size)
+		{
+			return false;
+		}
+
+		const hkUint8* pixel = bytes + offset;
+		const int row = topToBottom ? p / width : height - 1 - p / width;
+		hkUint8* rgba = imageOut.m_rgba.begin() + (row * width + p % width) * 4;
+		if (grayscale)
+		{
+			rgba[0] = rgba[1] = rgba[2] = pixel[0];
+			rgba[3] = 255;
+		}
+		else
+		{
+			rgba[0] = pixel[2];
+			rgba[1] = pixel[1];
+			rgba[2] = pixel[0];
+			rgba[3] = bytesPerPixel == 4 ? pixel[3] : 255;
+		}
+
+		// Repeated packets share one pixel value
+		if (rle)
+		{
+			packetRemaining--;
+			if (!packetRepeats || packetRemaining == 0)
+			{
+				offset += bytesPerPixel;
+			}
+		}
+		else
+		{
+			offset += bytesPerPixel;
+		}
+	}
+
+	return true;
+}
+
+template<typename T> static void releaseComObject(T*& object)
+{
+	if (object)
+	{
+		object->Release();
+		object = HK_NULL;
+	}
+}
+
+// PNG, JPEG, BMP, TIFF and the other formats with a WIC codec
+static bool decodeWic(const hkArray<char>& data, Image& imageOut)
+{
+	IWICImagingFactory* factory = HK_NULL;
+	IWICStream* stream = HK_NULL;
+	IWICBitmapDecoder* decoder = HK_NULL;
+	IWICBitmapFrameDecode* frame = HK_NULL;
+	IWICFormatConverter* converter = HK_NULL;
+
+	UINT width = 0;
+	UINT height = 0;
+	bool ok =
+		SUCCEEDED(CoCreateInstance(CLSID_WICImagingFactory, NULL, CLSCTX_INPROC_SERVER, IID_IWICImagingFactory, (void**) &factory)) &&
+		SUCCEEDED(factory->CreateStream(&stream)) &&
+		SUCCEEDED(stream->InitializeFromMemory((BYTE*) data.begin(), (DWORD) data.getSize())) &&
+		SUCCEEDED(factory->CreateDecoderFromStream(stream, NULL, WICDecodeMetadataCacheOnDemand, &decoder)) &&
+		SUCCEEDED(decoder->GetFrame(0, &frame)) &&
+		SUCCEEDED(factory->CreateFormatConverter(&converter)) &&
+		SUCCEEDED(converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone, NULL, 0.0, WICBitmapPaletteTypeCustom)) &&
+		SUCCEEDED(converter->GetSize(&width, &height)) &&
+		width > 0 && height > 0;
+
+	if (ok)
+	{
+		imageOut.m_width = (int) width;
+		imageOut.m_height = (int) height;
+		imageOut.m_rgba.setSize(imageOut.m_width * imageOut.m_height * 4);
+		ok = SUCCEEDED(converter->CopyPixels(NULL, width * 4, (UINT) imageOut.m_rgba.getSize(), imageOut.m_rgba.begin()));
+	}
+
+	releaseComObject(converter);
+	releaseComObject(frame);
+	releaseComObject(decoder);
+	releaseComObject(stream);
+	releaseComObject(factory);
+	return ok;
+}
+
+//
+// Mipmaps
+//
+
+struct ColorTables
+{
+	hkReal m_srgbToLinear[256];
+	hkUint8 m_linearToSrgb[LINEAR_TO_SRGB_TABLE_SIZE];
+
+	ColorTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			const hkReal c = i / 255.0f;
+			m_srgbToLinear[i] = c <= 0.04045f ? c / 12.92f : hkMath::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; i++)
+		{
+			const hkReal l = i / (hkReal) (LINEAR_TO_SRGB_TABLE_SIZE - 1);
+			const hkReal c = l <= 0.0031308f ? l * 12.92f : 1.055f * hkMath::pow(l, 1.0f / 2.4f) - 0.055f;
+			m_linearToSrgb[i] = (hkUint8) hkMath::clamp((int) (c * 255.0f + 0.5f), 0, 255);
+		}
+	}
+};
+
+static hkUint8 unitToByte(hkReal value)
+{
+	return (hkUint8) hkMath::clamp((int) (value * 255.0f + 0.5f), 0, 255);
+}
+
+// 2x2 box filter, odd sizes repeat the last row or column
+static void generateMipLevel(const Image& src, FbxToHkxTextureBaker::Usage usage, const ColorTables& tables, Image& dstOut)
+{
+	dstOut.m_width = hkMath::max2(src.m_width / 2, 1);
+	dstOut.m_height = hkMath::max2(src.m_height / 2, 1);
+	dstOut.m_rgba.setSize(dstOut.m_width * dstOut.m_height * 4);
+
+	for (int y = 0; y < dstOut.m_height; y++)
+	{
+		for (int x = 0; x < dstOut.m_width; x++)
+		{
+			const hkUint8* texels[4];
+			for (int t = 0; t < 4; t++)
+			{
+				const int sx = hkMath::min2(x * 2 + (t & 1), src.m_width - 1);
+				const int sy = hkMath::min2(y * 2 + (t >> 1), src.m_height - 1);
+				texels[t] = src.m_rgba.begin() + (sy * src.m_width + sx) * 4;
+			}
+
+			hkReal sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			for (int t = 0; t < 4; t++)
+			{
+				for (int c = 0; c < 4; c++)
+				{
+					sum[c] += (usage == FbxToHkxTextureBaker::USAGE_COLOR && c < 3) ? tables.m_srgbToLinear[texels[t][c]] : texels[t][c] / 255.0f;
+				}
+			}
+
+			hkUint8* dst = dstOut.m_rgba.begin() + (y * dstOut.m_width + x) * 4;
+			if (usage == FbxToHkxTextureBaker::USAGE_NORMAL)
+			{
+				hkVector4 normal;
+				normal.set(sum[0] * 0.5f - 1.0f, sum[1] * 0.5f - 1.0f, sum[2] * 0.5f - 1.0f, 0.0f);
+				if (!normal.normalizeIfNotZero<3>())
+				{
+					normal.set(0.0f, 0.0f, 1.0f, 0.0f);
+				}
+				for (int c = 0; c < 3; c++)
+				{
+					dst[c] = unitToByte(normal(c) * 0.5f + 0.5f);
+				}
+			}
+			else if (usage == FbxToHkxTextureBaker::USAGE_COLOR)
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					dst[c] = tables.m_linearToSrgb[hkMath::clamp((int) (sum[c] * 0.25f * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f), 0, LINEAR_TO_SRGB_TABLE_SIZE - 1)];
+				}
+			}
+			else
+			{
+				for (int c = 0; c < 3; c++)
+				{
+					dst[c] = unitToByte(sum[c] * 0.25f);
+				}
+			}
+			dst[3] = unitToByte(sum[3] * 0.25f);
+		}
+	}
+}
+
+//
+// Block compression
+//
+
+static hkUint16 packRgb565(const hkReal* rgb)
+{
+	const int r = hkMath::clamp((int) (rgb[0] * 31.0f / 255.0f + 0.5f), 0, 31);
+	const int g = hkMath::clamp((int) (rgb[1] * 63.0f / 255.0f + 0.5f), 0, 63);
+	const int b = hkMath::clamp((int) (rgb[2] * 31.0f / 255.0f + 0.5f), 0, 31);
+	return (hkUint16) ((r << 11) | (g << 5) | b);
+}
+
+static void unpackRgb565(hkUint16 color, hkReal* rgbOut)
+{
+	const int r = (color >> 11) & 31;
+	const int g = (color >> 5) & 63;
+	const int b = color & 31;
+	rgbOut[0] = (hkReal) ((r << 3) | (r >> 2));
+	rgbOut[1] = (hkReal) ((g << 2) | (g >> 4));
+	rgbOut[2] = (hkReal) ((b << 3) | (b >> 2));
+}
+
+// Choose the indices of the 4 color palette of the endpoints, returns the squared error
+static hkReal selectBC1Indices(const hkUint8* pixels, hkUint16 color0, hkUint16 color1, hkUint32& indicesOut)
+{
+	hkReal palette[4][3];
+	unpackRgb565(color0, palette[0]);
+	unpackRgb565(color1, palette[1]);
+	for (int c = 0; c < 3; c++)
+	{
+		palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+		palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+	}
+
+	hkReal totalError = 0.0f;
+	indicesOut = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		int bestIndex = 0;
+		hkReal bestError = HK_REAL_MAX;
+		for (int i = 0; i < 4; i++)
+		{
+			hkReal error = 0.0f;
+			for (int c = 0; c < 3; c++)
+			{
+				const hkReal d = pixels[p * 4 + c] - palette[i][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				bestIndex = i;
+			}
+		}
+		indicesOut |= (hkUint32) bestIndex << (p * 2);
+		totalError += bestError;
+	}
+	return totalError;
+}
+
+// Order the endpoints for the 4 color mode, swapping the indices along with them
+static void orderBC1Endpoints(hkUint16& color0, hkUint16& color1, hkUint32& indices)
+{
+	if (color0 < color1)
+	{
+		hkMath::swap(color0, color1);
+
+		// Swapping the endpoints maps index 0 <-> 1 and 2 <-> 3
+		indices ^= 0x55555555;
+	}
+}
+
+// Endpoints along the principal axis of the block colors, refined once by least squares
+static void encodeBC1Block(const hkUint8* pixels, hkUint8* blockOut)
+{
+	hkReal mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; p++)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			mean[c] += pixels[p * 4 + c] / 16.0f;
+		}
+	}
+
+	hkReal covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int p = 0; p < 16; p++)
+	{
+		const hkReal r = pixels[p * 4 + 0] - mean[0];
+		const hkReal g = pixels[p * 4 + 1] - mean[1];
+		const hkReal b = pixels[p * 4 + 2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// Power iteration for the principal axis
+	hkReal axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; iteration++)
+	{
+		const hkReal x = covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2];
+		const hkReal y = covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2];
+		const hkReal z = covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2];
+		const hkReal length = hkMath::max2(hkMath::max2(hkMath::fabs(x), hkMath::fabs(y)), hkMath::fabs(z));
+		if (length < 1e-6f)
+		{
+			break;
+		}
+		axis[0] = x / length;
+		axis[1] = y / length;
+		axis[2] = z / length;
+	}
+
+	hkReal minProjection = HK_REAL_MAX;
+	hkReal maxProjection = -HK_REAL_MAX;
+	int minPixel = 0;
+	int maxPixel = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		const hkReal projection = pixels[p * 4 + 0] * axis[0] + pixels[p * 4 + 1] * axis[1] + pixels[p * 4 + 2] * axis[2];
+		if (projection < minProjection)
+		{
+			minProjection = projection;
+			minPixel = p;
+		}
+		if (projection > maxProjection)
+		{
+			maxProjection = projection;
+			maxPixel = p;
+		}
+	}
+
+	hkReal endpoint0[3];
+	hkReal endpoint1[3];
+	for (int c = 0; c < 3; c++)
+	{
+		endpoint0[c] = pixels[maxPixel * 4 + c];
+		endpoint1[c] = pixels[minPixel * 4 + c];
+	}
+
+	hkUint16 color0 = packRgb565(endpoint0);
+	hkUint16 color1 = packRgb565(endpoint1);
+	hkUint32 indices;
+	hkReal error = selectBC1Indices(pixels, color0, color1, indices);
+
+	// Least squares fit of the endpoints to the chosen palette weights
+	if (color0 != color1)
+	{
+		static const hkReal weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+		hkReal aa = 0.0f, ab = 0.0f, bb = 0.0f;
+		hkReal ax[3] = { 0.0f, 0.0f, 0.0f };
+		hkReal bx[3] = { 0.0f, 0.0f, 0.0f };
+		for (int p = 0; p < 16; p++)
+		{
+			const hkReal a = weights[(indices >> (p * 2)) & 3];
+			const hkReal b = 1.0f - a;
+			aa += a * a;
+			ab += a * b;
+			bb += b * b;
+			for (int c = 0; c < 3; c++)
+			{
+				ax[c] += a * pixels[p * 4 + c];
+				bx[c] += b * pixels[p * 4 + c];
+			}
+		}
+
+		const hkReal determinant = aa * bb - ab * ab;
+		if (hkMath::fabs(determinant) > 1e-6f)
+		{
+			hkReal refined0[3];
+			hkReal refined1[3];
+			for (int c = 0; c < 3; c++)
+			{
+				refined0[c] = hkMath::clamp((ax[c] * bb - bx[c] * ab) / determinant, 0.0f, 255.0f);
+				refined1[c] = hkMath::clamp((bx[c] * aa - ax[c] * ab) / determinant, 0.0f, 255.0f);
+			}
+
+			const hkUint16 refinedColor0 = packRgb565(refined0);
+			const hkUint16 refinedColor1 = packRgb565(refined1);
+			hkUint32 refinedIndices;
+			const hkReal refinedError = selectBC1Indices(pixels, refinedColor0, refinedColor1, refinedIndices);
+			if (refinedError < error)
+			{
+				color0 = refinedColor0;
+				color1 = refinedColor1;
+				indices = refinedIndices;
+				error = refinedError;
+			}
+		}
+	}
+
+	if (color0 == color1)
+	{
+		indices = 0;
+	}
+	orderBC1Endpoints(color0, color1, indices);
+
+	blockOut[0] = (hkUint8) (color0 & 0xff);
+	blockOut[1] = (hkUint8) (color0 >> 8);
+	blockOut[2] = (hkUint8) (color1 & 0xff);
+	blockOut[3] = (hkUint8) (color1 >> 8);
+	for (int i = 0; i < 4; i++)
+	{
+		blockOut[4 + i] = (hkUint8) (indices >> (i * 8));
+	}
+}
+
+// Single channel block with the 8 value palette between the block minimum and maximum, used for BC3 alpha and BC5
+static void encodeBC4Block(const hkUint8* pixels, int channel, hkUint8* blockOut)
+{
+	int minValue = 255;
+	int maxValue = 0;
+	for (int p = 0; p < 16; p++)
+	{
+		minValue = hkMath::min2(minValue, (int) pixels[p * 4 + channel]);
+		maxValue = hkMath::max2(maxValue, (int) pixels[p * 4 + channel]);
+	}
+
+	blockOut[0] = (hkUint8) maxValue;
+	blockOut[1] = (hkUint8) minValue;
+
+	int palette[8];
+	palette[0] = maxValue;
+	palette[1] = minValue;
+	for (int i = 2; i < 8; i++)
+	{
+		palette[i] = ((8 - i) * maxValue + (i - 1) * minValue + 3) / 7;
+	}
+
+	hkUint64 indices = 0;
+	if (maxValue > minValue)
+	{
+		for (int p = 0; p < 16; p++)
+		{
+			const int value = pixels[p * 4 + channel];
+			int bestIndex = 0;
+			for (int i = 1; i < 8; i++)
+			{
+				if (hkMath::abs(palette[i] - value) < hkMath::abs(palette[bestIndex] - value))
+				{
+					bestIndex = i;
+				}
+			}
+			indices |= (hkUint64) bestIndex << (p * 3);
+		}
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		blockOut[2 + i] = (hkUint8) (indices >> (i * 8));
+	}
+}
+
+enum BlockFormat
+{
+	BLOCK_FORMAT_BC1,
+	BLOCK_FORMAT_BC3,
+	BLOCK_FORMAT_BC5
+};
+
+static int getBlockSize(BlockFormat format)
+{
+	return format == BLOCK_FORMAT_BC1 ? 8 : 16;
+}
+
+static void compressImage(const Image& image, BlockFormat format, hkArray<hkUint8>& dataOut)
+{
+	const int blocksX = (image.m_width + 3) / 4;
+	const int blocksY = (image.m_height + 3) / 4;
+	const int blockSize = getBlockSize(format);
+
+	const int offset = dataOut.getSize();
+	dataOut.setSize(offset + blocksX * blocksY * blockSize);
+	hkUint8* block = dataOut.begin() + offset;
+
+	hkUint8 pixels[16 * 4];
+	for (int by = 0; by < blocksY; by++)
+	{
+		for (int bx = 0; bx < blocksX; bx++)
+		{
+			// Blocks on the right and bottom edges repeat the last texel
+			for (int p = 0; p < 16; p++)
+			{
+				const int x = hkMath::min2(bx * 4 + (p & 3), image.m_width - 1);
+				const int y = hkMath::min2(by * 4 + (p >> 2), image.m_height - 1);
+				hkString::memCpy(pixels + p * 4, image.m_rgba.begin() + (y * image.m_width + x) * 4, 4);
+			}
+
+			switch (format)
+			{
+			case BLOCK_FORMAT_BC1:
+				encodeBC1Block(pixels, block);
+				break;
+			case BLOCK_FORMAT_BC3:
+				encodeBC4Block(pixels, 3, block);
+				encodeBC1Block(pixels, block + 8);
+				break;
+			case BLOCK_FORMAT_BC5:
+				encodeBC4Block(pixels, 0, block);
+				encodeBC4Block(pixels, 1, block + 8);
+				break;
+			}
+			block += blockSize;
+		}
+	}
+}
+
+//
+// DDS output
+//
+
+static hkUint32 makeFourCC(char a, char b, char c, char d)
+{
+	return (hkUint32) (hkUint8) a | ((hkUint32) (hkUint8) b << 8) | ((hkUint32) (hkUint8) c << 16) | ((hkUint32) (hkUint8) d << 24);
+}
+
+static bool writeDds(const char* filename, BlockFormat format, int width, int height, int numMips, const hkArray<hkUint8>& data)
+{
+	// Magic followed by the 124 byte DDS_HEADER with its DDS_PIXELFORMAT
+	hkUint32 header[32];
+	hkString::memSet4(header, 0, 32);
+	header[0] = makeFourCC('D', 'D', 'S', ' ');
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// CAPS | HEIGHT | WIDTH | PIXELFORMAT | MIPMAPCOUNT | LINEARSIZE
+	header[3] = height;
+	header[4] = width;
+	header[5] = ((width + 3) / 4) * ((height + 3) / 4) * getBlockSize(format);
+	header[7] = numMips;
+	header[19] = 32;
+	header[20] = 0x4;	// DDPF_FOURCC
+	header[21] = format == BLOCK_FORMAT_BC1 ? makeFourCC('D', 'X', 'T', '1') : (format == BLOCK_FORMAT_BC3 ? makeFourCC('D', 'X', 'T', '5') : makeFourCC('A', 'T', 'I', '2'));
+	header[27] = 0x1000 | 0x8 | 0x400000;	// TEXTURE | COMPLEX | MIPMAP
+
+	// Write to a temporary file first so an interrupted bake never leaves a truncated file in the cache
+	hkStringBuf tempFilename(filename);
+	tempFilename += ".tmp";
+	{
+		hkOstream stream(tempFilename.cString());
+		if (!stream.isOk())
+		{
+			return false;
+		}
+		stream.write(reinterpret_cast<const char*>(header), sizeof(header));
+		stream.write(reinterpret_cast<const char*>(data.begin()), data.getSize());
+		if (!stream.isOk())
+		{
+			return false;
+		}
+	}
+
+	return MoveFileExA(tempFilename.cString(), filename, MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+//
+// Baking
+//
+
+FbxToHkxTextureBaker::Result FbxToHkxTextureBaker::bakeTexture(
+	const char* sourceFilename,
+	const char* outputDirectory,
+	Usage usage,
+	hkStringBuf& bakedFilenameOut,
+	hkStringBuf& descriptionOut)
+{
+	if (hasExtension(sourceFilename, ".dds"))
+	{
+		descriptionOut = "already a DDS file";
+		return RESULT_SKIPPED;
+	}
+
+	hkArray<char> fileData;
+	if (!readFile(sourceFilename, fileData))
+	{
+		descriptionOut = "could not read the file";
+		return RESULT_FAILED;
+	}
+
+	// FNV-1a over the file contents and everything that changes the encoding
+	hkUint64 hash = 14695981039346656037ull;
+	for (int i = 0; i < fileData.getSize(); i++)
+	{
+		hash = (hash ^ (hkUint8) fileData[i]) * 1099511628211ull;
+	}
+	hash = (hash ^ (hkUint64) usage) * 1099511628211ull;
+	hash = (hash ^ (hkUint64) BAKER_VERSION) * 1099511628211ull;
+
+	// The baked file keeps the name of the source image
+	const char* baseName = sourceFilename;
+	for (const char* c = sourceFilename; *c; c++)
+	{
+		if (*c == '/' || *c == '\\')
+		{
+			baseName = c + 1;
+		}
+	}
+	hkStringBuf name(baseName);
+	const int extension = name.lastIndexOf('.');
+	if (extension > 0)
+	{
+		name.slice(0, extension);
+	}
+	bakedFilenameOut.printf("%s/%s_%08x%08x.dds", outputDirectory, name.cString(), (hkUint32) (hash >> 32), (hkUint32) hash);
+
+	if (hkIstream(bakedFilenameOut.cString()).isOk())
+	{
+		descriptionOut = "unchanged";
+		return RESULT_CACHED;
+	}
+
+	// WIC needs COM on this thread. The main thread may already be initialized in another mode, which is fine.
+	const HRESULT comResult = CoInitializeEx(NULL, COINIT_MULTITHREADED);
+
+	Image image;
+	const bool decoded = hasExtension(sourceFilename, ".tga") ? decodeTga(fileData, image) : decodeWic(fileData, image);
+
+	if (SUCCEEDED(comResult))
+	{
+		CoUninitialize();
+	}
+
+	if (!decoded)
+	{
+		descriptionOut = "unsupported image format";
+		return RESULT_FAILED;
+	}
+	fileData.clearAndDeallocate();
+
+	BlockFormat format = BLOCK_FORMAT_BC5;
+	if (usage != USAGE_NORMAL)
+	{
+		format = BLOCK_FORMAT_BC1;
+		for (int p = 3; p < image.m_rgba.getSize(); p += 4)
+		{
+			if (image.m_rgba[p] != 255)
+			{
+				format = BLOCK_FORMAT_BC3;
+				break;
+			}
+		}
+	}
+
+	const ColorTables tables;
+	const int width = image.m_width;
+	const int height = image.m_height;
+	hkArray<hkUint8> compressed;
+	int numMips = 1;
+	compressImage(image, format, compressed);
+	while (image.m_width > 1 || image.m_height > 1)
+	{
+		Image mip;
+		generateMipLevel(image, usage, tables, mip);
+		compressImage(mip, format, compressed);
+		image.m_rgba.swap(mip.m_rgba);
+		image.m_width = mip.m_width;
+		image.m_height = mip.m_height;
+		numMips++;
+	}
+
+	static const char* formatNames[] = { "BC1", "BC3", "BC5" };
+	CreateDirectoryA(outputDirectory, NULL);
+	if (!writeDds(bakedFilenameOut.cString(), format, width, height, numMips, compressed))
+	{
+		descriptionOut.printf("could not write %s", bakedFilenameOut.cString());
+		return RESULT_FAILED;
+	}
+
+	descriptionOut.printf("%dx%d %s, %d mips", width, height, formatNames[format], numMips);
+	return RESULT_BAKED;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
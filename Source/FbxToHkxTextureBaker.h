@@ -0,0 +1,61 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_TEXTURE_BAKER
+#define HK_FBXTOHKX_TEXTURE_BAKER
+
+#include <Common/Base/hkBase.h>
+
+// Bakes image files into DDS files with a full mip chain and BC1, BC3 or BC5 compression. The baked files are named
+// after a hash of the source file contents and the encoding, so a texture that is unchanged since it was last baked
+// is found in the output directory and not encoded again. Only touches the file system, so it can run on worker threads.
+class FbxToHkxTextureBaker
+{
+public:
+
+	enum Usage
+	{
+		USAGE_COLOR,	// sRGB color, mips are filtered in linear space. BC1, or BC3 if the image has alpha
+		USAGE_LINEAR,	// Non-color data (bump, opacity, ...). BC1, or BC3 if the image has alpha
+		USAGE_NORMAL	// Tangent space normal map, mips are renormalized. BC5 with X and Y
+	};
+
+	enum Result
+	{
+		RESULT_BAKED,
+		RESULT_CACHED,
+		RESULT_SKIPPED,	// Already a DDS file
+		RESULT_FAILED
+	};
+
+	// Bake the image into outputDirectory. bakedFilenameOut receives the path of the DDS file and descriptionOut
+	// the size and format, or the reason the texture could not be baked.
+	static Result bakeTexture(
+		const char* sourceFilename,
+		const char* outputDirectory,
+		Usage usage,
+		hkStringBuf& bakedFilenameOut,
+		hkStringBuf& descriptionOut);
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
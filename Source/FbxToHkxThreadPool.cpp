@@ -0,0 +1,122 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#include "FbxToHkxThreadPool.h"
+
+#include <Common/Base/Thread/Thread/hkThread.h>
+#include <Common/Base/Thread/CriticalSection/hkCriticalSection.h>
+#include <Common/Base/System/Hardware/hkHardwareInfo.h>
+#include <Common/Base/System/hkBaseSystem.h>
+#include <Common/Base/Memory/System/hkMemorySystem.h>
+
+struct JobQueue
+{
+	FbxToHkxThreadPool::JobFunction m_function;
+	void* m_context;
+	int m_numJobs;
+	int m_nextJob;
+	hkCriticalSection m_lock;
+
+	// Returns -1 once all jobs have been taken
+	int takeJob()
+	{
+		hkCriticalSectionLock lock(&m_lock);
+		return m_nextJob < m_numJobs ? m_nextJob++ : -1;
+	}
+
+	void run()
+	{
+		for (int jobIndex = takeJob(); jobIndex >= 0; jobIndex = takeJob())
+		{
+			m_function(m_context, jobIndex);
+		}
+	}
+};
+
+static void* HK_CALL workerMain(void* param)
+{
+	hkMemoryRouter memoryRouter;
+	hkMemorySystem::getInstance().threadInit(memoryRouter, "FbxToHkxWorker");
+	hkBaseSystem::initThread(&memoryRouter);
+
+	static_cast<JobQueue*>(param)->run();
+
+	hkBaseSystem::quitThread();
+	hkMemorySystem::getInstance().threadQuit(memoryRouter);
+	return HK_NULL;
+}
+
+int FbxToHkxThreadPool::getDefaultNumThreads()
+{
+	return hkMath::max2(hkHardwareInfo::getNumHardwareThreads(), 1);
+}
+
+void FbxToHkxThreadPool::processJobs(JobFunction function, void* context, int numJobs, int numThreads)
+{
+	if (numJobs <= 0)
+	{
+		return;
+	}
+
+	if (numThreads <= 0)
+	{
+		numThreads = getDefaultNumThreads();
+	}
+	numThreads = hkMath::min2(numThreads, numJobs);
+
+	JobQueue queue;
+	queue.m_function = function;
+	queue.m_context = context;
+	queue.m_numJobs = numJobs;
+	queue.m_nextJob = 0;
+
+	// Jobs can add references to shared objects, like the material of a section that the LODs of other sections
+	// reference as well, so the reference counts have to be updated atomically while workers run
+	const hkReferencedObject::LockMode previousLockMode = hkReferencedObject::getLockMode();
+	if (numThreads > 1)
+	{
+		hkReferencedObject::setLockMode(hkReferencedObject::LOCK_MODE_AUTO);
+	}
+
+	hkArray<hkThread*> workers;
+	for (int i = 1; i < numThreads; i++)
+	{
+		hkThread* worker = new hkThread();
+		if (worker->startThread(workerMain, &queue, "FbxToHkxWorker") != HK_SUCCESS)
+		{
+			delete worker;
+			break;
+		}
+		workers.pushBack(worker);
+	}
+
+	queue.run();
+
+	for (int i = 0; i < workers.getSize(); i++)
+	{
+		workers[i]->joinThread();
+		delete workers[i];
+	}
+
+	hkReferencedObject::setLockMode(previousLockMode);
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
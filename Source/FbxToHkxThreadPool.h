@@ -0,0 +1,45 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+
+#ifndef HK_FBXTOHKX_THREAD_POOL
+#define HK_FBXTOHKX_THREAD_POOL
+
+#include <Common/Base/hkBase.h>
+
+// Runs independent jobs on worker threads. Jobs must only touch Havok data, the FBX SDK is not thread safe
+// and has to be accessed from the main thread while gathering the job inputs.
+class FbxToHkxThreadPool
+{
+public:
+
+	typedef void (HK_CALL *JobFunction)(void* context, int jobIndex);
+
+	// Number of threads used when 0 is requested
+	static int getDefaultNumThreads();
+
+	// Call function(context, jobIndex) for every job index in [0, numJobs) and return once all jobs have finished.
+	// The calling thread takes part in the processing, so at most numThreads - 1 workers are started.
+	static void processJobs(JobFunction function, void* context, int numJobs, int numThreads);
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,176 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+#include "FbxToHkxTrace.h"
+
+#include <Common/Base/Thread/CriticalSection/hkCriticalSection.h>
+#include <Common/Base/Thread/Thread/hkThread.h>
+#include <Common/Base/System/Io/OStream/hkOStream.h>
+
+struct TraceSpan
+{
+	const char* m_category;
+	hkStringPtr m_name;
+	hkUint64 m_startTicks;
+	hkUint64 m_endTicks;
+	int m_threadIndex;
+};
+
+// Allocated by begin, once the Havok memory system is up
+struct TraceData
+{
+	HK_DECLARE_NONVIRTUAL_CLASS_ALLOCATOR(HK_MEMORY_CLASS_BASE, TraceData);
+
+	hkCriticalSection m_lock;
+	hkUint64 m_startTicks;
+	hkArray<TraceSpan> m_spans;
+
+	// Thread ids in the order they recorded their first span, the index is written as the tid
+	hkArray<hkUint64> m_threadIds;
+};
+
+bool FbxToHkxTrace::s_enabled = false;
+static TraceData* s_traceData = HK_NULL;
+
+static void appendJsonString(hkStringBuf& buf, const char* str)
+{
+	buf.append("\"");
+	for (const char* c = str; c && *c; c++)
+	{
+		if (*c == '"' || *c == '\\')
+		{
+			const char escaped[3] = { '\\', *c, 0 };
+			buf.append(escaped);
+		}
+		else if ((unsigned char) *c < 0x20)
+		{
+			buf.appendPrintf("\\u%04x", (int) (unsigned char) *c);
+		}
+		else
+		{
+			buf.append(c, 1);
+		}
+	}
+	buf.append("\"");
+}
+
+void FbxToHkxTrace::begin()
+{
+	HK_ASSERT(0x0, !s_traceData);
+
+	s_traceData = new TraceData();
+	s_traceData->m_startTicks = hkStopwatch::getTickCounter();
+	s_traceData->m_threadIds.pushBack(hkThread::getMyThreadId());
+	s_enabled = true;
+}
+
+void FbxToHkxTrace::addSpan(const char* category, const char* name, hkUint64 startTicks, hkUint64 endTicks)
+{
+	// Spans that started before end was called are dropped
+	TraceData* data = s_traceData;
+	if (!data)
+	{
+		return;
+	}
+
+	const hkUint64 threadId = hkThread::getMyThreadId();
+
+	hkCriticalSectionLock lock(&data->m_lock);
+
+	int threadIndex = data->m_threadIds.indexOf(threadId);
+	if (threadIndex < 0)
+	{
+		threadIndex = data->m_threadIds.getSize();
+		data->m_threadIds.pushBack(threadId);
+	}
+
+	TraceSpan& span = data->m_spans.expandOne();
+	span.m_category = category;
+	span.m_name = name;
+	span.m_startTicks = startTicks;
+	span.m_endTicks = endTicks;
+	span.m_threadIndex = threadIndex;
+}
+
+// All threads that record spans have to be done by now
+bool FbxToHkxTrace::end(const char* filename)
+{
+	TraceData* data = s_traceData;
+	if (!data)
+	{
+		return false;
+	}
+
+	s_enabled = false;
+	s_traceData = HK_NULL;
+
+	hkOstream stream(filename);
+	if (stream.isOk())
+	{
+		const double microsecondsPerTick = 1e6 / (double) hkStopwatch::getTicksPerSecond();
+
+		stream << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+
+		// The metadata events name the threads
+		hkStringBuf line;
+		for (int t = 0; t < data->m_threadIds.getSize(); t++)
+		{
+			hkStringBuf threadName;
+			threadName.printf(t == 0 ? "Main" : "Worker %d", t);
+
+			line.printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":", (t > 0) ? ",\n" : "", t);
+			appendJsonString(line, threadName);
+			line.append("}}");
+			stream << line.cString();
+		}
+
+		for (int i = 0; i < data->m_spans.getSize(); i++)
+		{
+			const TraceSpan& span = data->m_spans[i];
+			const double start = (double) (span.m_startTicks - data->m_startTicks) * microsecondsPerTick;
+			const double duration = (double) (span.m_endTicks - span.m_startTicks) * microsecondsPerTick;
+
+			line = ",\n{\"name\":";
+			appendJsonString(line, span.m_name);
+			line.append(",\"cat\":");
+			appendJsonString(line, span.m_category);
+			line.appendPrintf(",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d}",
+				start, duration, span.m_threadIndex);
+			stream << line.cString();
+		}
+
+		stream << "\n]}\n";
+	}
+
+	const bool written = stream.isOk();
+	if (written)
+	{
+		printf("Trace: %d spans on %d threads written to %s\n", data->m_spans.getSize(), data->m_threadIds.getSize(), filename);
+	}
+	else
+	{
+		printf("Cannot save trace: %s\n", filename);
+	}
+
+	delete data;
+	return written;
+}
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -0,0 +1,78 @@
+/*
+ *
+ * Confidential Information of Telekinesys Research Limited (t/a Havok). Not for disclosure or distribution without Havok's
+ * prior written consent. This software contains code, techniques and know-how which is confidential and proprietary to Havok.
+ * Product and Trade Secret source code contains trade secrets of Havok. Havok Software (C) Copyright 1999-2013 Telekinesys Research Limited t/a Havok. All Rights Reserved. Use of this software is subject to the terms of an end user license agreement.
+ *
+ */
+#ifndef HK_FBXTOHKX_TRACE
+#define HK_FBXTOHKX_TRACE
+
+#include <Common/Base/hkBase.h>
+#include <Common/Base/System/Stopwatch/hkStopwatch.h>
+
+// Timeline of the conversion in the Chrome trace event format, which chrome://tracing and Perfetto can open.
+// Tracing is off until begin is called. While it is on, each FbxToHkxTraceScope records a span with the thread
+// that it ran on.
+class FbxToHkxTrace
+{
+public:
+
+	// The calling thread is shown as the main thread
+	static void begin();
+
+	// Write the spans recorded since begin to a JSON file and stop tracing
+	static bool end(const char* filename);
+
+	static bool isEnabled() { return s_enabled; }
+
+	// Thread safe, the name is copied
+	static void addSpan(const char* category, const char* name, hkUint64 startTicks, hkUint64 endTicks);
+
+private:
+
+	static bool s_enabled;
+};
+
+// Records a span from its construction to its destruction. Without tracing it only tests a flag, so scopes can
+// be placed in loops. The name has to stay valid until the scope ends.
+class FbxToHkxTraceScope
+{
+public:
+
+	FbxToHkxTraceScope(const char* category, const char* name) :
+		m_category(category), m_name(name), m_startTicks(FbxToHkxTrace::isEnabled() ? hkStopwatch::getTickCounter() : 0)
+	{
+	}
+
+	~FbxToHkxTraceScope()
+	{
+		if (m_startTicks)
+		{
+			FbxToHkxTrace::addSpan(m_category, m_name, m_startTicks, hkStopwatch::getTickCounter());
+		}
+	}
+
+private:
+
+	const char* m_category;
+	const char* m_name;
+	hkUint64 m_startTicks;
+};
+
+#endif
+
+/*
+ * Havok SDK
+ *
+ * Confidential Information of Havok.  (C) Copyright 1999-2013
+ * Telekinesys Research Limited t/a Havok. All Rights Reserved. The Havok
+ * Logo, and the Havok buzzsaw logo are trademarks of Havok.  Title, ownership
+ * rights, and intellectual property rights in the Havok software remain in
+ * Havok and/or its suppliers.
+ *
+ * Use of this software for evaluation purposes is subject to and indicates
+ * acceptance of the End User licence Agreement for this product. A copy of
+ * the license is included with this software and is also available from salesteam@havok.com.
+ *
+ */
@@ -6,6 +6,8 @@
  *
  */
 
+// The animation classes are registered for the files saved with -createAnimations
+#define HK_FEATURE_PRODUCT_ANIMATION
 #define HK_CLASSES_FILE <Common/Serialize/Classlist/hkClasses.h>
 
 #include <Common/Base/Config/hkProductFeaturesNoPatchesOrCompat.h>
@@ -25,9 +27,12 @@
 #include <Common/Base/Memory/System/Util/hkMemoryInitUtil.h>
 #include <Common/Base/Memory/Allocator/Malloc/hkMallocAllocator.h>
 #include <Common/Base/System/Error/hkError.h>
+#include <Common/Base/System/Io/IStream/hkIStream.h>
+#include <Common/Base/System/Stopwatch/hkStopwatch.h>
 #include <Common/SceneData/Mesh/hkxMesh.h>
 
 #include "FbxToHkxConverter.h"
+#include "FbxToHkxTrace.h"
 
 static void HK_CALL havokErrorReport(const char* msg, void*)
 {
@@ -35,6 +40,367 @@ static void HK_CALL havokErrorReport(const char* msg, void*)
 	printf("%s\n", msg);
 }
 
+static void printUsage()
+{
+	printf("Usage: FBXImport [options] <input_filename>\n");
+	printf("Options:\n");
+	printf("  -optimizeIndices    Reorder index buffers for the vertex cache and overdraw\n");
+	printf("  -tangents           Export tangents and binormals, generating missing normals\n");
+	printf("  -blendShapes        Export blend shapes as sparse vertex animations\n");
+	printf("  -quantizeBlendShapes\n");
+	printf("                      Store blend shape deltas as 16 bit values\n");
+	printf("  -blendShapeTolerance <value>\n");
+	printf("                      Skip vertices that move less than the tolerance (default: 1e-5)\n");
+	printf("  -threads <count>    Number of threads for the mesh processing (default: all)\n");
+	printf("  -writerThreads <count>\n");
+	printf("                      Number of threads saving the scenes during the conversion (default: 1)\n");
+	printf("  -compressTagFiles <level>\n");
+	printf("                      Save gzip compressed .hkt.gz tag files with the zlib level (1-9)\n");
+	printf("  -lod <ratio,...>    Generate a LOD for each triangle ratio, e.g. 0.5,0.25\n");
+	printf("  -bakeTextures <dir> Bake referenced images to DDS files with mipmaps and BC1/BC3/BC5\n");
+	printf("  -clips <file>       Split the animation stacks into the clips defined in the file\n");
+	printf("                      (default: <input_filename>.clips if it exists)\n");
+	printf("  -stacks <name,...>  Only export the given animation stacks\n");
+	printf("  -sampleRate <fps[,stack=fps,...]>\n");
+	printf("                      Sample the animation stacks at this rate instead of every frame\n");
+	printf("  -createAnimations   Save the skeleton and compressed animations to __out_rig.hkx and\n");
+	printf("                      __out_anim_<name>.hkx without the filter manager\n");
+	printf("  -skeletonOnlyAnimations\n");
+	printf("                      Leave meshes, cameras, lights and splines out of the animation scenes\n");
+	printf("  -optimizeHierarchy  Collapse transform-only nodes and remove unused leaf bones and helpers\n");
+	printf("  -keepNodes <pattern,...>\n");
+	printf("                      Nodes that -optimizeHierarchy always keeps, e.g. *_Attach,Camera?\n");
+	printf("  -noAnimations       Only export the rig scene, without importing the animation stacks\n");
+	printf("  -noMaterials        Don't import or export materials and textures\n");
+	printf("  -trace <file>       Write a timeline of the import, conversion and saving as a Chrome trace\n");
+	printf("  -visibleOnly        Skip hidden nodes and nodes on hidden display layers\n");
+	printf("  -selectedOnly       Skip nodes that are not selected\n");
+	printf("  -includeNodes, -includeTypes, -includeLayers <pattern,...>\n");
+	printf("                      Only convert the nodes with matching names, attribute types or layers\n");
+	printf("  -excludeNodes, -excludeTypes, -excludeLayers <pattern,...>\n");
+	printf("                      Skip the nodes with matching names, attribute types or layers\n");
+	printf("  -normalFormat <float|oct16|10_10_10_2>\n");
+	printf("                      Storage format of normals, tangents and binormals\n");
+	printf("  -uvFormat <float|half|unorm16>\n");
+	printf("                      Storage format of texture coordinates\n");
+	printf("  -positionFormat <float|unorm16>\n");
+	printf("                      Storage format of positions\n");
+	printf("  -axisSystem <max|mayaYUp|mayaZUp|motionBuilder|openGL|directX|lightwave>\n");
+	printf("                      Axis system the scene is converted to (default: max)\n");
+	printf("  -unit <mm|cm|dm|m|km|inch|foot|yard|mile|centimeters>\n");
+	printf("                      Unit the scene is converted to (default: the unit of the file)\n");
+	printf("  -maxPositionError <value>, -maxNormalError <degrees>, -maxUvError <value>\n");
+	printf("                      Warn when the quantization error of a section exceeds the tolerance\n");
+}
+
+// Split a comma separated list of names
+static void parseNameList(const char* value, hkArray<hkStringPtr>& namesOut)
+{
+	namesOut.clear();
+	for (const char* name = value; name; )
+	{
+		const char* separator = hkString::strStr(name, ",");
+		namesOut.expandOne().set(name, separator ? int(separator - name) : -1);
+		name = separator ? separator + 1 : HK_NULL;
+	}
+}
+
+// Only let the FBX SDK import the parts of the file that the converter will use with these options
+static void setImportSettings(const FbxToHkxConverter::Options& options, FbxIOSettings* fbxIoSettings)
+{
+	fbxIoSettings->SetBoolProp(IMP_FBX_MODEL, true);
+	fbxIoSettings->SetBoolProp(IMP_FBX_GLOBAL_SETTINGS, true);
+	// Skins are needed for the skeleton even without meshes
+	fbxIoSettings->SetBoolProp(IMP_FBX_LINK, true);
+
+	fbxIoSettings->SetBoolProp(IMP_FBX_ANIMATION, options.m_exportAnimations);
+	fbxIoSettings->SetBoolProp(IMP_FBX_MATERIAL, options.m_exportMeshes && options.m_exportMaterials);
+	fbxIoSettings->SetBoolProp(IMP_FBX_TEXTURE, options.m_exportMeshes && options.m_exportMaterials);
+	fbxIoSettings->SetBoolProp(IMP_FBX_EXTRACT_EMBEDDED_DATA, options.m_exportMeshes && options.m_exportMaterials);
+	fbxIoSettings->SetBoolProp(IMP_FBX_SHAPE, options.m_exportMeshes && options.m_exportVertexAnimations);
+	fbxIoSettings->SetBoolProp(IMP_FBX_GOBO, options.m_exportLights);
+
+	// Never converted
+	fbxIoSettings->SetBoolProp(IMP_FBX_CHARACTER, false);
+	fbxIoSettings->SetBoolProp(IMP_FBX_CONSTRAINT, false);
+}
+
+// Parse the options preceding the input filename into the converter options
+static bool parseOptions(int argc, char* argv[], FbxToHkxConverter::Options& options, const char*& traceFileOut)
+{
+	for (int argIndex = 1; argIndex < argc - 1; argIndex++)
+	{
+		const char* arg = argv[argIndex];
+
+		// All options after the flags take a value
+		const char* value = (argIndex + 1 < argc - 1) ? argv[argIndex + 1] : HK_NULL;
+
+		if (hkString::strCasecmp(arg, "-optimizeIndices") == 0)
+		{
+			options.m_optimizeIndexBuffers = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-tangents") == 0)
+		{
+			options.m_exportVertexTangents = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-blendShapes") == 0)
+		{
+			options.m_exportVertexAnimations = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-quantizeBlendShapes") == 0)
+		{
+			options.m_quantizeBlendShapes = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-createAnimations") == 0)
+		{
+			options.m_createAnimations = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-noAnimations") == 0)
+		{
+			options.m_exportAnimations = false;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-noMaterials") == 0)
+		{
+			options.m_exportMaterials = false;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-visibleOnly") == 0)
+		{
+			options.m_visibleOnly = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-selectedOnly") == 0)
+		{
+			options.m_selectedOnly = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-skeletonOnlyAnimations") == 0)
+		{
+			options.m_skeletonOnlyAnimations = true;
+			continue;
+		}
+		else if (hkString::strCasecmp(arg, "-optimizeHierarchy") == 0)
+		{
+			options.m_optimizeHierarchy = true;
+			continue;
+		}
+		else if (!value)
+		{
+			printf("Unknown option or missing value: %s\n", arg);
+			return false;
+		}
+		else if (hkString::strCasecmp(arg, "-blendShapeTolerance") == 0)
+		{
+			options.m_blendShapeTolerance = hkString::atof(value);
+		}
+		else if (hkString::strCasecmp(arg, "-threads") == 0)
+		{
+			options.m_numThreads = hkString::atoi(value);
+		}
+		else if (hkString::strCasecmp(arg, "-compressTagFiles") == 0)
+		{
+			options.m_tagFileCompressionLevel = hkString::atoi(value);
+			if (options.m_tagFileCompressionLevel < 1 || options.m_tagFileCompressionLevel > 9)
+			{
+				printf("Invalid compression level: %s\n", value);
+				return false;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-writerThreads") == 0)
+		{
+			options.m_numWriterThreads = hkString::atoi(value);
+		}
+		else if (hkString::strCasecmp(arg, "-bakeTextures") == 0)
+		{
+			options.m_textureBakePath = value;
+		}
+		else if (hkString::strCasecmp(arg, "-trace") == 0)
+		{
+			traceFileOut = value;
+		}
+		else if (hkString::strCasecmp(arg, "-clips") == 0)
+		{
+			options.m_clipFile = value;
+		}
+		else if (hkString::strCasecmp(arg, "-stacks") == 0)
+		{
+			parseNameList(value, options.m_animStackNames);
+		}
+		else if (hkString::strCasecmp(arg, "-keepNodes") == 0)
+		{
+			parseNameList(value, options.m_protectedNodeNames);
+		}
+		else if (hkString::strCasecmp(arg, "-includeNodes") == 0)
+		{
+			parseNameList(value, options.m_includeFilter.m_nodeNames);
+		}
+		else if (hkString::strCasecmp(arg, "-excludeNodes") == 0)
+		{
+			parseNameList(value, options.m_excludeFilter.m_nodeNames);
+		}
+		else if (hkString::strCasecmp(arg, "-includeTypes") == 0)
+		{
+			parseNameList(value, options.m_includeFilter.m_attributeTypes);
+		}
+		else if (hkString::strCasecmp(arg, "-excludeTypes") == 0)
+		{
+			parseNameList(value, options.m_excludeFilter.m_attributeTypes);
+		}
+		else if (hkString::strCasecmp(arg, "-includeLayers") == 0)
+		{
+			parseNameList(value, options.m_includeFilter.m_layerNames);
+		}
+		else if (hkString::strCasecmp(arg, "-excludeLayers") == 0)
+		{
+			parseNameList(value, options.m_excludeFilter.m_layerNames);
+		}
+		else if (hkString::strCasecmp(arg, "-sampleRate") == 0)
+		{
+			options.m_sampleRate = 0.0f;
+			options.m_animStackSampleRates.clear();
+			for (const char* rate = value; rate; )
+			{
+				const char* separator = hkString::strStr(rate, ",");
+				const char* assignment = hkString::strStr(rate, "=");
+				hkReal sampleRate;
+
+				// Entries of the form stack=fps override the rate of a single stack
+				if (assignment && (!separator || assignment < separator))
+				{
+					FbxToHkxConverter::Options::AnimStackSampleRate& stackRate = options.m_animStackSampleRates.expandOne();
+					stackRate.m_animStackName.set(rate, int(assignment - rate));
+					stackRate.m_sampleRate = sampleRate = hkString::atof(assignment + 1);
+				}
+				else
+				{
+					options.m_sampleRate = sampleRate = hkString::atof(rate);
+				}
+
+				if (sampleRate <= 0.0f)
+				{
+					printf("Sample rates must be greater than 0: %s\n", value);
+					return false;
+				}
+				rate = separator ? separator + 1 : HK_NULL;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-lod") == 0)
+		{
+			options.m_lodTargetRatios.clear();
+			for (const char* ratio = value; ratio; ratio = hkString::strStr(ratio, ","))
+			{
+				if (*ratio == ',')
+				{
+					ratio++;
+				}
+
+				const hkReal targetRatio = hkString::atof(ratio);
+				if (targetRatio <= 0.0f || targetRatio >= 1.0f)
+				{
+					printf("LOD ratios must be between 0 and 1: %s\n", value);
+					return false;
+				}
+				options.m_lodTargetRatios.pushBack(targetRatio);
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-normalFormat") == 0)
+		{
+			if (hkString::strCasecmp(value, "float") == 0)			options.m_normalFormat = FbxToHkxConverter::NORMAL_FORMAT_FLOAT32;
+			else if (hkString::strCasecmp(value, "oct16") == 0)		options.m_normalFormat = FbxToHkxConverter::NORMAL_FORMAT_OCTAHEDRAL16;
+			else if (hkString::strCasecmp(value, "10_10_10_2") == 0)	options.m_normalFormat = FbxToHkxConverter::NORMAL_FORMAT_PACKED_10_10_10_2;
+			else
+			{
+				printf("Unknown normal format: %s\n", value);
+				return false;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-uvFormat") == 0)
+		{
+			if (hkString::strCasecmp(value, "float") == 0)			options.m_texCoordFormat = FbxToHkxConverter::TEXCOORD_FORMAT_FLOAT32;
+			else if (hkString::strCasecmp(value, "half") == 0)		options.m_texCoordFormat = FbxToHkxConverter::TEXCOORD_FORMAT_HALF16;
+			else if (hkString::strCasecmp(value, "unorm16") == 0)	options.m_texCoordFormat = FbxToHkxConverter::TEXCOORD_FORMAT_UNORM16;
+			else
+			{
+				printf("Unknown uv format: %s\n", value);
+				return false;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-positionFormat") == 0)
+		{
+			if (hkString::strCasecmp(value, "float") == 0)			options.m_positionFormat = FbxToHkxConverter::POSITION_FORMAT_FLOAT32;
+			else if (hkString::strCasecmp(value, "unorm16") == 0)	options.m_positionFormat = FbxToHkxConverter::POSITION_FORMAT_UNORM16;
+			else
+			{
+				printf("Unknown position format: %s\n", value);
+				return false;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-axisSystem") == 0)
+		{
+			if (hkString::strCasecmp(value, "max") == 0)				options.m_targetAxisSystem = FbxAxisSystem::Max;
+			else if (hkString::strCasecmp(value, "mayaYUp") == 0)		options.m_targetAxisSystem = FbxAxisSystem::MayaYUp;
+			else if (hkString::strCasecmp(value, "mayaZUp") == 0)		options.m_targetAxisSystem = FbxAxisSystem::MayaZUp;
+			else if (hkString::strCasecmp(value, "motionBuilder") == 0)	options.m_targetAxisSystem = FbxAxisSystem::Motionbuilder;
+			else if (hkString::strCasecmp(value, "openGL") == 0)		options.m_targetAxisSystem = FbxAxisSystem::OpenGL;
+			else if (hkString::strCasecmp(value, "directX") == 0)		options.m_targetAxisSystem = FbxAxisSystem::DirectX;
+			else if (hkString::strCasecmp(value, "lightwave") == 0)		options.m_targetAxisSystem = FbxAxisSystem::Lightwave;
+			else
+			{
+				printf("Unknown axis system: %s\n", value);
+				return false;
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-unit") == 0)
+		{
+			if (hkString::strCasecmp(value, "mm") == 0)				options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::mm.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "cm") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::cm.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "dm") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::dm.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "m") == 0)			options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::m.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "km") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::km.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "inch") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::Inch.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "foot") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::Foot.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "yard") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::Yard.GetScaleFactor();
+			else if (hkString::strCasecmp(value, "mile") == 0)		options.m_targetUnitInCentimeters = (hkReal) FbxSystemUnit::Mile.GetScaleFactor();
+			else
+			{
+				options.m_targetUnitInCentimeters = hkString::atof(value);
+				if (options.m_targetUnitInCentimeters <= 0.0f)
+				{
+					printf("Unknown unit: %s\n", value);
+					return false;
+				}
+			}
+		}
+		else if (hkString::strCasecmp(arg, "-maxPositionError") == 0)
+		{
+			options.m_maxPositionError = hkString::atof(value);
+		}
+		else if (hkString::strCasecmp(arg, "-maxNormalError") == 0)
+		{
+			options.m_maxNormalErrorDegrees = hkString::atof(value);
+		}
+		else if (hkString::strCasecmp(arg, "-maxUvError") == 0)
+		{
+			options.m_maxTexCoordError = hkString::atof(value);
+		}
+		else
+		{
+			printf("Unknown option: %s\n", arg);
+			return false;
+		}
+
+		argIndex++;
+	}
+
+	return true;
+}
+
 int main(int argc, char* argv[])
 {
 	// initialize Havok internals
@@ -54,16 +420,16 @@ int main(int argc, char* argv[])
 		errorhandler.enableAll();
 	}
 
-	if (argc != 2)
+	if (argc < 2)
 	{
 		printf("Invalid number of input arguments\n");
-		printf("Usage: FBXImport <input_filename>\n");
+		printUsage();
 		return -1;
 	}
 
 	// Load FBX and save as HKX
 	{
-		const char* filename = argv[1];
+		const char* filename = argv[argc - 1];
 
 		FbxManager* fbxSdkManager = FbxManager::Create();
 		if( !fbxSdkManager )
@@ -72,11 +438,47 @@ int main(int argc, char* argv[])
 			return -1;
 		}
 
+		FbxToHkxConverter::Options options(fbxSdkManager);
+		const char* traceFile = HK_NULL;
+		if (!parseOptions(argc, argv, options, traceFile))
+		{
+			printUsage();
+			fbxSdkManager->Destroy();
+			return -1;
+		}
+
+		if (traceFile)
+		{
+			FbxToHkxTrace::begin();
+		}
+
+		// Pick up the clip definitions next to the input file
+		hkStringBuf clipFile = filename;
+		if (!options.m_clipFile)
+		{
+			const int extensionIndex = hkString::lastIndexOf(filename, '.');
+			if (extensionIndex > 0)
+			{
+				clipFile.set(filename, extensionIndex);
+			}
+			clipFile += ".clips";
+
+			if (hkIstream(clipFile.cString()).isOk())
+			{
+				options.m_clipFile = clipFile.cString();
+			}
+		}
+
 		FbxIOSettings* fbxIoSettings = FbxIOSettings::Create(fbxSdkManager, IOSROOT);
+		setImportSettings(options, fbxIoSettings);
 		fbxSdkManager->SetIOSettings(fbxIoSettings);
 
 		FbxImporter* fbxImporter = FbxImporter::Create(fbxSdkManager,"");
 
+		hkStopwatch importTimer;
+		importTimer.start();
+		const hkUint64 importStartTicks = hkStopwatch::getTickCounter();
+
 		if (!fbxImporter->Initialize(filename, -1, fbxSdkManager->GetIOSettings()))
 		{
 			HK_WARN(0x5216afed, "Failed to initialize the importer! Please ensure file " << filename << " exists\n");
@@ -96,24 +498,31 @@ int main(int argc, char* argv[])
 		fbxImporter->Import(fbxScene);
 		fbxImporter->Destroy();
 
-		// Currently assume that the file is loaded from 3dsmax
-		FbxAxisSystem::Max.ConvertScene(fbxScene);
+		importTimer.stop();
+		FbxToHkxTrace::addSpan("import", filename, importStartTicks, hkStopwatch::getTickCounter());
+		{
+			const double megabytes = (double) FbxFileUtils::Size(filename) / (1024.0 * 1024.0);
+			const double seconds = hkMath::max2((double) importTimer.getElapsedSeconds(), 1e-6);
+			printf("Import throughput: %.1f MB/s (%.1f MB in %.2f s)\n", megabytes / seconds, megabytes, seconds);
+		}
 
-		FbxToHkxConverter::Options options(fbxSdkManager);
 		FbxToHkxConverter converter(options);
 
-		if(converter.createScenes(fbxScene))
-		{
-			int lastSlashIndex = hkString::lastIndexOf(filename,'\\') + 1;
-			int extensionIndex = hkString::lastIndexOf(filename,'.');
+		int lastSlashIndex = hkString::lastIndexOf(filename,'\\') + 1;
+		int extensionIndex = hkString::lastIndexOf(filename,'.');
+
+		hkStringBuf path;
+		path.set(filename, lastSlashIndex);
 
-			hkStringBuf path;
-			path.set(filename, lastSlashIndex);
+		hkStringBuf name;
+		name.set(filename + lastSlashIndex, extensionIndex - lastSlashIndex);
 
-			hkStringBuf name;
-			name.set(filename + lastSlashIndex, extensionIndex - lastSlashIndex);
+		// Each scene is saved on the writer threads as soon as it has been converted
+		converter.startSaving(path, name);
 
-			converter.saveScenes(path, name);
+		if(converter.createScenes(fbxScene))
+		{
+			converter.finishSaving();
 		}
 		else
 		{
@@ -122,6 +531,12 @@ int main(int argc, char* argv[])
 			return -1;
 		}
 
+		// The writer threads are done once finishSaving returns
+		if (traceFile)
+		{
+			FbxToHkxTrace::end(traceFile);
+		}
+
 		fbxSdkManager->Destroy();
 	}
 